@@ -4,9 +4,34 @@
 #include <cstdlib>
 #include <iostream>
 #include <optional>
+#include <vector>
 
 using namespace std;
 
+//! Receive a batch of datagrams on `from` and relay their payloads to the peer of `to` with one sendmmsg()
+static void bounce(
+    UDPSocket &from, optional<Address> &from_peer, const char *from_name, UDPSocket &to, optional<Address> &to_peer) {
+    static vector<UDPSocket::received_buffer> batch;
+    static vector<BufferViewList> payloads;
+
+    from.recv_batch(batch);
+    payloads.clear();
+    for (const auto &rec : batch) {
+        if (not from_peer.has_value() or from_peer.value() != rec.source_address) {
+            from_peer = rec.source_address;
+            cerr << "Learned new address for " << from_name << " ( " << from.local_address().to_string() << " at "
+                 << from_peer.value().to_string() << "\n";
+        }
+        if (to_peer.has_value() and rec.payload.size() > 0) {
+            payloads.emplace_back(rec.payload.str());
+        }
+    }
+
+    if (not payloads.empty()) {
+        to.send_batch(to_peer.value(), payloads);
+    }
+}
+
 void program_body() {
     EventLoop loop;
     vector<UDPSocket> sockets;
@@ -27,29 +52,8 @@ void program_body() {
         x.bind(Address{"0", lower_port});
         y.bind(Address{"0", uint16_t(lower_port + 1)});
 
-        loop.add_rule(x, Direction::In, [&] {
-            auto rec = x.recv();
-            if (not x_peer.has_value() or x_peer.value() != rec.source_address) {
-                x_peer = rec.source_address;
-                cerr << "Learned new address for X ( " << x.local_address().to_string() << " at "
-                     << x_peer.value().to_string() << "\n";
-            }
-            if (y_peer.has_value() and not rec.payload.empty()) {
-                y.sendto(y_peer.value(), rec.payload);
-            }
-        });
-
-        loop.add_rule(y, Direction::In, [&] {
-            auto rec = y.recv();
-            if (not y_peer.has_value() or y_peer.value() != rec.source_address) {
-                y_peer = rec.source_address;
-                cerr << "Learned new address for Y ( " << y.local_address().to_string() << " at "
-                     << y_peer.value().to_string() << "\n";
-            }
-            if (x_peer.has_value() and not rec.payload.empty()) {
-                x.sendto(x_peer.value(), rec.payload);
-            }
-        });
+        loop.add_rule(x, Direction::In, [&] { bounce(x, x_peer, "X", y, y_peer); });
+        loop.add_rule(y, Direction::In, [&] { bounce(y, y_peer, "Y", x, x_peer); });
     }
 
     cerr << "Starting event loop...\n";
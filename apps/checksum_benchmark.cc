@@ -0,0 +1,124 @@
+#include "util.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr size_t total_bytes = 1024 * 1024 * 1024;
+
+//! The original byte-at-a-time InternetChecksum::add, kept for comparison
+class ByteAtATimeChecksum {
+  private:
+    uint32_t _sum{0};
+    bool _parity{};
+
+  public:
+    void add(string_view data) {
+        for (size_t i = 0; i < data.size(); i++) {
+            uint16_t val = uint8_t(data[i]);
+            if (not _parity) {
+                val <<= 8;
+            }
+            _sum += val;
+            _parity = !_parity;
+        }
+    }
+
+    uint16_t value() const {
+        uint32_t ret = _sum;
+        while (ret > 0xffff) {
+            ret = (ret >> 16) + (ret & 0xffff);
+        }
+        return ~ret;
+    }
+};
+
+//! Checksum `total_bytes` worth of `chunk_size`-byte packets, starting at an odd address
+//! \returns throughput in GB/s
+template <typename Checksum>
+double measure(const string &bytes, const size_t chunk_size, uint16_t &result) {
+    const string_view packet{bytes.data() + 1, chunk_size};
+    const size_t iterations = total_bytes / chunk_size;
+
+    const auto first_time = high_resolution_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        Checksum check;
+        check.add(packet);
+        result ^= check.value();
+    }
+    const auto final_time = high_resolution_clock::now();
+
+    const auto duration = duration_cast<nanoseconds>(final_time - first_time).count();
+    return double(iterations * chunk_size) / double(duration);
+}
+
+//! Checksum and copy `total_bytes` worth of `chunk_size`-byte packets, either in two passes or fused into one
+//! \returns throughput in GB/s
+double measure_copy(const string &bytes, const size_t chunk_size, const bool fused, uint16_t &result) {
+    const string_view packet{bytes.data() + 1, chunk_size};
+    string dest(chunk_size, 0);
+    const size_t iterations = total_bytes / chunk_size;
+
+    const auto first_time = high_resolution_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        InternetChecksum check;
+        if (fused) {
+            check.copy_and_add(dest.data(), packet);
+        } else {
+            check.add(packet);
+            memcpy(dest.data(), packet.data(), packet.size());
+        }
+        result ^= check.value() ^ uint8_t(dest[i % chunk_size]);
+    }
+    const auto final_time = high_resolution_clock::now();
+
+    const auto duration = duration_cast<nanoseconds>(final_time - first_time).count();
+    return double(iterations * chunk_size) / double(duration);
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        string bytes(65536 + 1, 0);
+        for (auto &ch : bytes) {
+            ch = rd();
+        }
+
+        cout << "InternetChecksum implementation: " << InternetChecksum::implementation() << "\n";
+        cout << fixed << setprecision(2);
+        for (const size_t chunk_size : {20, 64, 576, 1500, 9000, 65536}) {
+            uint16_t before_result = 0, after_result = 0;
+            const double before = measure<ByteAtATimeChecksum>(bytes, chunk_size, before_result);
+            const double after = measure<InternetChecksum>(bytes, chunk_size, after_result);
+            if (before_result != after_result) {
+                throw runtime_error("checksums disagree for " + to_string(chunk_size) + "-byte packets");
+            }
+            cout << setw(6) << chunk_size << "-byte packets: " << setw(7) << before << " GB/s before, " << setw(7)
+                 << after << " GB/s after\n";
+        }
+
+        cout << "Checksum and copy:\n";
+        for (const size_t chunk_size : {576, 1500, 65536}) {
+            uint16_t separate_result = 0, fused_result = 0;
+            const double separate = measure_copy(bytes, chunk_size, false, separate_result);
+            const double fused = measure_copy(bytes, chunk_size, true, fused_result);
+            if (separate_result != fused_result) {
+                throw runtime_error("copies disagree for " + to_string(chunk_size) + "-byte packets");
+            }
+            cout << setw(6) << chunk_size << "-byte packets: " << setw(7) << separate << " GB/s in two passes, "
+                 << setw(7) << fused << " GB/s fused\n";
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
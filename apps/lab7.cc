@@ -76,12 +76,7 @@ class NetworkInterfaceAdapter : public TCPOverIPv4Adapter {
     Address _next_hop;
     pair<FileDescriptor, FileDescriptor> _data_socket_pair = socket_pair_helper(SOCK_DGRAM);
 
-    void send_pending() {
-        while (not _interface.frames_out().empty()) {
-            _data_socket_pair.first.write(_interface.frames_out().front().serialize());
-            _interface.frames_out().pop();
-        }
-    }
+    void send_pending() { _interface.drain_to(_data_socket_pair.first); }
 
   public:
     NetworkInterfaceAdapter(const Address &ip_address, const Address &next_hop)
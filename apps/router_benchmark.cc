@@ -0,0 +1,150 @@
+#include "prefix_trie.hh"
+#include "threaded_router.hh"
+#include "util.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr size_t route_count = 500000;
+constexpr size_t lookup_count = 10000000;
+constexpr size_t linear_lookup_count = 200;
+constexpr size_t idle_worker_count = 4;
+
+struct Route {
+    uint32_t prefix;
+    uint8_t length;
+};
+
+//! A rough imitation of a full Internet routing table: mostly /24s, with /16 to /23 and a few longer
+vector<Route> make_routes(mt19937 &rd) {
+    vector<Route> routes;
+    routes.reserve(route_count);
+    for (size_t i = 0; i < route_count; i++) {
+        const unsigned pick = rd() % 100;
+        const uint8_t length = pick < 60 ? 24 : pick < 95 ? 16 + rd() % 8 : 25 + rd() % 8;
+        routes.push_back({uint32_t(rd()) & (~0u << (32 - length)), length});
+    }
+    return routes;
+}
+
+//! Longest-prefix match by scanning every route (how Router used to look up each datagram)
+size_t linear_lookup(const vector<Route> &routes, const uint32_t address) {
+    size_t best = routes.size();
+    for (size_t i = 0; i < routes.size(); i++) {
+        if ((routes[i].prefix ^ address) >> (32 - routes[i].length) == 0 and
+            (best == routes.size() or routes[best].length < routes[i].length)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+//! \returns operations per second
+double rate(const size_t operations, const high_resolution_clock::time_point first_time) {
+    const auto duration = duration_cast<nanoseconds>(high_resolution_clock::now() - first_time).count();
+    return 1e9 * double(operations) / double(duration);
+}
+
+//! CPU time used so far by all the threads of the process
+nanoseconds process_cpu_time() {
+    timespec ts{};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return seconds(ts.tv_sec) + nanoseconds(ts.tv_nsec);
+}
+
+//! How much CPU idle ThreadedRouter workers use (spinning workers would use one core each), and how long
+//! stop() takes to wake them
+void idle_workers() {
+    ThreadedRouter router;
+    for (size_t i = 0; i < idle_worker_count; i++) {
+        router.add_interface({EthernetAddress{0x02, 0, 0, 0, 1, uint8_t(i)}, Address("172.16.0.1", 0)});
+    }
+    router.start();
+
+    const auto cpu_before = process_cpu_time();
+    const auto first_time = steady_clock::now();
+    this_thread::sleep_for(milliseconds(500));
+    const auto cpu_used = process_cpu_time() - cpu_before;
+    const auto elapsed = steady_clock::now() - first_time;
+    const double share = 100.0 * double(cpu_used.count()) / double(elapsed.count());
+    cout << idle_worker_count << " idle router workers: " << setprecision(1) << share << "% of one core\n";
+
+    const auto stop_began = steady_clock::now();
+    router.stop();
+    cout << "Stopping them: " << duration_cast<microseconds>(steady_clock::now() - stop_began).count() << " us\n";
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+        const vector<Route> routes = make_routes(rd);
+        vector<uint32_t> addresses(lookup_count);
+        for (auto &address : addresses) {
+            // half the lookups fall inside a loaded prefix, the rest anywhere
+            const Route &route = routes[rd() % routes.size()];
+            address = rd() % 2 ? uint32_t(rd()) : route.prefix | (uint32_t(rd()) >> route.length);
+        }
+
+        cout << fixed << setprecision(0);
+
+        PrefixTrie trie;
+        auto first_time = high_resolution_clock::now();
+        for (size_t i = 0; i < routes.size(); i++) {
+            trie.insert(routes[i].prefix, routes[i].length, i);
+        }
+        cout << "Loaded " << trie.size() << " distinct prefixes: " << rate(routes.size(), first_time)
+             << " inserts/s\n";
+
+        size_t checksum = 0;
+        first_time = high_resolution_clock::now();
+        for (const uint32_t address : addresses) {
+            checksum += trie.lookup(address).value_or(0);
+        }
+        cout << "Trie lookups:   " << setw(12) << rate(addresses.size(), first_time) << " lookups/s\n";
+
+        first_time = high_resolution_clock::now();
+        for (size_t i = 0; i < linear_lookup_count; i++) {
+            const size_t match = linear_lookup(routes, addresses[i]);
+            const optional<size_t> trie_match = trie.lookup(addresses[i]);
+            // the trie keeps the last of any duplicate prefixes, so compare prefix lengths, not indices
+            const int linear_length = match == routes.size() ? -1 : routes[match].length;
+            const int trie_length = trie_match.has_value() ? routes[trie_match.value()].length : -1;
+            if (linear_length != trie_length) {
+                throw runtime_error("trie and linear scan disagree for address " + to_string(addresses[i]));
+            }
+        }
+        cout << "Linear lookups: " << setw(12) << rate(linear_lookup_count, first_time) << " lookups/s\n";
+
+        first_time = high_resolution_clock::now();
+        for (size_t i = 0; i < routes.size(); i += 2) {
+            trie.erase(routes[i].prefix, routes[i].length);
+        }
+        cout << "Erased half the routes: " << rate(routes.size() / 2, first_time) << " erases/s, "
+             << trie.size() << " prefixes left\n";
+
+        first_time = high_resolution_clock::now();
+        for (const uint32_t address : addresses) {
+            checksum += trie.lookup(address).value_or(0);
+        }
+        cout << "Trie lookups:   " << setw(12) << rate(addresses.size(), first_time) << " lookups/s (checksum "
+             << checksum % 1000 << ")\n";
+
+        idle_workers();
+    } catch (const exception &e) {
+        cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -1,10 +1,12 @@
 #include "tcp_connection.hh"
+#include "tcp_sponge_socket.hh"
 
 #include <chrono>
 #include <cstdlib>
 #include <iomanip>
 #include <iostream>
 #include <string>
+#include <thread>
 
 using namespace std;
 using namespace std::chrono;
@@ -103,10 +105,62 @@ void main_loop(const bool reorder) {
     }
 }
 
+//! Send `len` bytes between two TCPSpongeSockets in this process, through the loopback adapter pair
+void loopback_sockets() {
+    auto [client_adapter, server_adapter] = TCPOverIPv4OverLoopbackAdapter::make_pair();
+    TCPOverIPv4OverLoopbackSpongeSocket client{move(client_adapter)}, server{move(server_adapter)};
+
+    FdAdapterConfig client_config, server_config;
+    client_config.source = server_config.destination = {"10.0.0.1", "1234"};
+    client_config.destination = server_config.source = {"10.0.0.2", "5678"};
+
+    TCPConfig config;
+    config.rt_timeout = 100;  // keeps the lingering after the close (ten timeouts) short
+    thread accepter([&] { server.listen_and_accept(config, server_config); });
+    client.connect(config, client_config);
+    accepter.join();
+
+    string string_to_send(len, 'x');
+    for (auto &ch : string_to_send) {
+        ch = rand();
+    }
+
+    string string_received;
+    string_received.reserve(len);
+
+    const auto first_time = high_resolution_clock::now();
+
+    thread writer([&] {
+        client.write(string_to_send);
+        client.shutdown(SHUT_WR);
+    });
+    while (not server.eof()) {
+        string_received.append(server.read());
+    }
+    writer.join();
+
+    const auto final_time = high_resolution_clock::now();
+
+    if (string_received != string_to_send) {
+        throw runtime_error("strings sent vs. received don't match");
+    }
+
+    const auto duration = duration_cast<nanoseconds>(final_time - first_time).count();
+
+    const auto gigabits_per_second = len * 8.0 / double(duration);
+
+    cout << fixed << setprecision(2);
+    cout << "Full-stack throughput (loopback adapters): " << gigabits_per_second << " Gbit/s\n";
+
+    server.wait_until_closed();
+    client.wait_until_closed();
+}
+
 int main() {
     try {
         main_loop(false);
         main_loop(true);
+        loopback_sockets();
     } catch (const exception &e) {
         cerr << e.what() << "\n";
         return EXIT_FAILURE;
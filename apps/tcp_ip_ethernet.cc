@@ -31,7 +31,10 @@ static void show_usage(const char *argv0, const char *msg) {
 
          << "   -t <tmout>      Set rt_timeout to tmout                         " << TCPConfig::TIMEOUT_DFLT << "\n\n"
 
-         << "   -d <tapdev>     Connect to tap <tapdev>                         " << TAP_DFLT << "\n\n"
+         << "   -d <tapdev>     Connect to tap <tapdev>                         " << TAP_DFLT << "\n"
+         << "   -r <ifname>     Use packet rings on interface <ifname>, not tap (none)\n"
+         << "   -x <ifname>     Use AF_XDP on queue 0 of <ifname>, not tap     (none)\n"
+         << "   -X <ifname>     Same as -x, in generic (SKB) XDP mode           (none)\n\n"
 
          << "   -h              Show this message.\n\n";
 
@@ -48,10 +51,14 @@ static void check_argc(int argc, char **argv, int curr, const char *err) {
     }
 }
 
-static tuple<TCPConfig, FdAdapterConfig, Address, string> get_config(int argc, char **argv) {
+//! Which kind of device the stack runs on
+enum class Device { Tap, PacketRing, XDP, GenericXDP };
+
+static tuple<TCPConfig, FdAdapterConfig, Address, Device, string> get_config(int argc, char **argv) {
     TCPConfig c_fsm{};
     FdAdapterConfig c_filt{};
-    string tapdev = TAP_DFLT;
+    Device device = Device::Tap;
+    string devname = TAP_DFLT;
 
     int curr = 1;
 
@@ -87,7 +94,20 @@ static tuple<TCPConfig, FdAdapterConfig, Address, string> get_config(int argc, c
 
         } else if (strncmp("-d", argv[curr], 3) == 0) {
             check_argc(argc, argv, curr, "ERROR: -t requires one argument.");
-            tapdev = argv[curr + 1];
+            device = Device::Tap;
+            devname = argv[curr + 1];
+            curr += 2;
+
+        } else if (strncmp("-r", argv[curr], 3) == 0) {
+            check_argc(argc, argv, curr, "ERROR: -r requires one argument.");
+            device = Device::PacketRing;
+            devname = argv[curr + 1];
+            curr += 2;
+
+        } else if (strncmp("-x", argv[curr], 3) == 0 or strncmp("-X", argv[curr], 3) == 0) {
+            check_argc(argc, argv, curr, "ERROR: -x and -X require one argument.");
+            device = argv[curr][1] == 'x' ? Device::XDP : Device::GenericXDP;
+            devname = argv[curr + 1];
             curr += 2;
 
         } else if (strncmp("-h", argv[curr], 3) == 0) {
@@ -106,7 +126,7 @@ static tuple<TCPConfig, FdAdapterConfig, Address, string> get_config(int argc, c
 
     Address next_hop{next_hop_address, "0"};
 
-    return make_tuple(c_fsm, c_filt, next_hop, tapdev);
+    return make_tuple(c_fsm, c_filt, next_hop, device, devname);
 }
 
 int main(int argc, char **argv) {
@@ -124,15 +144,30 @@ int main(int argc, char **argv) {
         local_ethernet_address.at(0) |= 0x02;  // "10" in last two binary digits marks a private Ethernet address
         local_ethernet_address.at(0) &= 0xfe;
 
-        auto [c_fsm, c_filt, next_hop, tap_dev_name] = get_config(argc, argv);
-
-        TCPOverIPv4OverEthernetSpongeSocket tcp_socket(TCPOverIPv4OverEthernetAdapter(
-            TCPOverIPv4OverEthernetAdapter(TapFD(tap_dev_name), local_ethernet_address, c_filt.source, next_hop)));
-
-        tcp_socket.connect(c_fsm, c_filt);
-
-        bidirectional_stream_copy(tcp_socket);
-        tcp_socket.wait_until_closed();
+        auto [c_fsm, c_filt, next_hop, device, devname] = get_config(argc, argv);
+
+        auto run = [&, &c_fsm = c_fsm, &c_filt = c_filt](auto &tcp_socket) {
+            tcp_socket.connect(c_fsm, c_filt);
+            bidirectional_stream_copy(tcp_socket);
+            tcp_socket.wait_until_closed();
+        };
+
+        if (device == Device::Tap) {
+            TCPOverIPv4OverEthernetSpongeSocket tcp_socket(TCPOverIPv4OverEthernetAdapter(
+                TapFD(devname, true), local_ethernet_address, c_filt.source, next_hop));
+            run(tcp_socket);
+        } else if (device == Device::PacketRing) {
+            TCPOverIPv4OverPacketRingSpongeSocket tcp_socket(TCPOverIPv4OverPacketRingAdapter(
+                PacketRingFD(devname), local_ethernet_address, c_filt.source, next_hop));
+            run(tcp_socket);
+        } else {
+            TCPOverIPv4OverXDPSpongeSocket tcp_socket(
+                TCPOverIPv4OverXDPAdapter(XDPSocketFD(devname, 0, device == Device::GenericXDP),
+                                          local_ethernet_address,
+                                          c_filt.source,
+                                          next_hop));
+            run(tcp_socket);
+        }
     } catch (const exception &e) {
         cerr << "Exception: " << e.what() << endl;
         return EXIT_FAILURE;
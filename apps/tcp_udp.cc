@@ -23,6 +23,8 @@ static void show_usage(const char *argv0, const char *msg) {
          << "   -l              Server (listen) mode.                           (client mode)\n"
          << "                   In server mode, <host>:<port> is the address to bind.\n\n"
 
+         << "   -g              Use UDP segmentation offload (GSO/GRO).         (off)\n\n"
+
          << "   -w <winsz>      Use a window of <winsz> bytes                   " << TCPConfig::MAX_PAYLOAD_SIZE
          << "\n\n"
 
@@ -58,6 +60,10 @@ static tuple<TCPConfig, FdAdapterConfig, bool> get_config(int argc, char **argv)
             listen = true;
             curr += 1;
 
+        } else if (strncmp("-g", argv[curr], 3) == 0) {
+            c_filt.udp_segmentation_offload = true;
+            curr += 1;
+
         } else if (strncmp("-w", argv[curr], 3) == 0) {
             check_argc(argc, argv, curr, "ERROR: -w requires one argument.");
             c_fsm.recv_capacity = strtol(argv[curr + 1], nullptr, 0);
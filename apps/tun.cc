@@ -14,7 +14,7 @@ using namespace std;
 
 int main() {
     try {
-        TunFD tun("tun144");
+        TunFD tun("tun144", true);
         while (true) {
             auto buffer = tun.read();
             cout << "\n\n***\n*** Got packet:\n***\n";
@@ -0,0 +1,24 @@
+const uint16_t portnum = ((std::random_device()()) % 50000) + 1025;
+
+// create a UDP socket and bind it to a local address
+UDPSocket receiver;
+receiver.bind(Address("127.0.0.1", portnum));
+
+// send three datagrams with a single sendmmsg()
+UDPSocket sender;
+const std::vector<BufferViewList> payloads{"one", "two", "three"};
+sender.send_batch(Address("127.0.0.1", portnum), payloads);
+
+// receive them (possibly over several calls, each of which returns at least one datagram)
+std::vector<UDPSocket::received_buffer> batch;
+std::vector<std::string> received;
+while (received.size() < payloads.size()) {
+    receiver.recv_batch(batch);
+    for (const auto &datagram : batch) {
+        received.push_back(datagram.payload.copy());
+    }
+}
+
+if (received != std::vector<std::string>{"one", "two", "three"}) {
+    throw std::runtime_error("wrong data received");
+}
@@ -37,6 +37,18 @@ add_test(NAME t_byte_stream_two_writes   COMMAND byte_stream_two_writes)
 add_test(NAME t_byte_stream_capacity     COMMAND byte_stream_capacity)
 add_test(NAME t_byte_stream_many_writes  COMMAND byte_stream_many_writes)
 
+add_test(NAME t_buffer_pool              COMMAND buffer_pool)
+add_test(NAME t_checksum                 COMMAND checksum)
+add_test(NAME t_io_uring                 COMMAND io_uring)
+add_test(NAME t_packet_ring              COMMAND packet_ring)
+add_test(NAME t_prefix_trie              COMMAND prefix_trie)
+add_test(NAME t_tun_dispatch             COMMAND tun_dispatch)
+add_test(NAME t_tcp_super_segment        COMMAND tcp_super_segment)
+add_test(NAME t_ip_address_map           COMMAND ip_address_map)
+add_test(NAME t_router                   COMMAND router)
+add_test(NAME t_threaded_router          COMMAND threaded_router)
+add_test(NAME t_loopback_adapter         COMMAND loopback_adapter)
+
 add_test(NAME t_webget               COMMAND "${PROJECT_SOURCE_DIR}/tests/webget_t.sh")
 
 add_test(NAME arp_network_interface    COMMAND net_interface)
@@ -1,5 +1,8 @@
 #include "byte_stream.hh"
 
+#include <algorithm>
+#include <stdexcept>
+
 // Dummy implementation of a flow-controlled in-memory byte stream.
 
 // For Lab 0, please replace with a real implementation that passes the
@@ -13,33 +16,70 @@ void DUMMY_CODE(Targs &&... /* unused */) {}
 using namespace std;
 
 ByteStream::ByteStream(const size_t capacity)
-    : _queue(), _capacity_size(capacity), _write_size(0), _read_size(0), _end_input(false), _error(false) {}
-
-size_t ByteStream::write(const string &data) {
+    : _buffer(capacity)
+    , _head(0)
+    , _buffered(0)
+    , _capacity_size(capacity)
+    , _write_size(0)
+    , _read_size(0)
+    , _end_input(false)
+    , _error(false) {}
+
+size_t ByteStream::write(string_view data) {
     if (_end_input) {
         return 0;
     }
-    size_t write_size = min(data.size(), _capacity_size - _queue.size());
-    _write_size += write_size;
-    for (size_t i = 0; i < write_size; i++) {
-        _queue.push_back(data[i]);
+    size_t write_size = min(data.size(), remaining_capacity());
+    size_t copied = 0;
+    for (const iovec &piece : free_space()) {
+        const size_t n = min(piece.iov_len, write_size - copied);
+        data.copy(static_cast<char *>(piece.iov_base), n, copied);
+        copied += n;
     }
+    commit_write(write_size);
     return write_size;
 }
 
+array<iovec, 2> ByteStream::free_space() {
+    // 空闲空间从最后一个字节之后开始，到达存储末尾后回到开头
+    const size_t free_size = remaining_capacity();
+    if (free_size == 0) {
+        return {};
+    }
+    const size_t tail = (_head + _buffered) % _capacity_size;
+    const size_t first_size = min(free_size, _capacity_size - tail);
+    return {iovec{_buffer.data() + tail, first_size}, iovec{_buffer.data(), free_size - first_size}};
+}
+
+//! \param[in] len bytes, already copied into free_space(), join the stream
+void ByteStream::commit_write(const size_t len) {
+    // 和 write() 一样，输入结束后不再接受任何字节
+    if (_end_input) {
+        return;
+    }
+    if (len > remaining_capacity()) {
+        throw runtime_error("ByteStream::commit_write: more bytes than free space");
+    }
+    _buffered += len;
+    _write_size += len;
+}
+
 //! \param[in] len bytes will be copied from the output side of the buffer
 string ByteStream::peek_output(const size_t len) const {
-    size_t pop_size = min(len, _queue.size());
-    return string(_queue.begin(), _queue.begin() + pop_size);
+    const size_t peek_size = min(len, _buffered);
+    const size_t first_size = min(peek_size, _capacity_size - _head);
+    string data(_buffer.data() + _head, first_size);
+    data.append(_buffer.data(), peek_size - first_size);
+    return data;
 }
 
 //! \param[in] len bytes will be removed from the output side of the buffer
 void ByteStream::pop_output(const size_t len) {
-    size_t pop_size = min(len, _queue.size());
+    size_t pop_size = min(len, _buffered);
     _read_size += len;
-    for (size_t i = 0; i < pop_size; ++i) {
-        _queue.pop_front();
-    }
+    _buffered -= pop_size;
+    // 缓冲区变空时回到存储开头，使之后的空闲空间尽量连续
+    _head = _buffered == 0 ? 0 : (_head + pop_size) % _capacity_size;
 }
 
 //! Read (i.e., copy and then pop) the next "len" bytes of the stream
@@ -51,18 +91,29 @@ std::string ByteStream::read(const size_t len) {
     return data;
 }
 
+//! \param[out] dest receives the bytes (e.g. the payload of a Buffer from Buffer::allocate)
+//! \param[in] len bytes will be popped and copied
+size_t ByteStream::read(char *dest, const size_t len) {
+    const size_t read_size = min(len, _buffered);
+    const size_t first_size = min(read_size, _capacity_size - _head);
+    copy_n(_buffer.data() + _head, first_size, dest);
+    copy_n(_buffer.data(), read_size - first_size, dest + first_size);
+    pop_output(read_size);
+    return read_size;
+}
+
 void ByteStream::end_input() { _end_input = true; }
 
 bool ByteStream::input_ended() const { return _end_input; }
 
-size_t ByteStream::buffer_size() const { return _queue.size(); }
+size_t ByteStream::buffer_size() const { return _buffered; }
 
-bool ByteStream::buffer_empty() const { return _queue.empty(); }
+bool ByteStream::buffer_empty() const { return _buffered == 0; }
 
-bool ByteStream::eof() const { return _end_input && _queue.empty(); }
+bool ByteStream::eof() const { return _end_input && _buffered == 0; }
 
 size_t ByteStream::bytes_written() const { return _write_size; }
 
 size_t ByteStream::bytes_read() const { return _read_size; }
 
-size_t ByteStream::remaining_capacity() const { return _capacity_size - _queue.size(); }
+size_t ByteStream::remaining_capacity() const { return _capacity_size - _buffered; }
@@ -1,8 +1,11 @@
 #ifndef SPONGE_LIBSPONGE_BYTE_STREAM_HH
 #define SPONGE_LIBSPONGE_BYTE_STREAM_HH
 
-#include <deque>
+#include <array>
 #include <string>
+#include <string_view>
+#include <sys/uio.h>
+#include <vector>
 
 //! \brief An in-order byte stream.
 
@@ -18,7 +21,9 @@ class ByteStream {
     // that's a sign that you probably want to keep exploring
     // different approaches.
 
-    std::deque<char> _queue;
+    std::vector<char> _buffer;  //!< ring storage for the buffered bytes
+    size_t _head;               //!< index in `_buffer` of the next byte to read
+    size_t _buffered;           //!< number of bytes buffered
     size_t _capacity_size;
     size_t _write_size;
     size_t _read_size;
@@ -35,7 +40,17 @@ class ByteStream {
     //! Write a string of bytes into the stream. Write as many
     //! as will fit, and return how many were written.
     //! \returns the number of bytes accepted into the stream
-    size_t write(const std::string &data);
+    size_t write(std::string_view data);
+
+    //! \brief The free space at the input side, for the writer to fill in place
+    //! \returns up to two pieces, remaining_capacity() bytes in all (the second piece is empty unless
+    //! the free space wraps around the end of the storage)
+    //! \note The bytes become part of the stream only once they are committed with commit_write().
+    std::array<iovec, 2> free_space();
+
+    //! \brief Add the first `len` bytes of free_space() to the stream, as if they had been written by write()
+    //! \note Like write(), this adds nothing once the input has ended.
+    void commit_write(const size_t len);
 
     //! \returns the number of additional bytes that the stream has space for
     size_t remaining_capacity() const;
@@ -61,6 +76,10 @@ class ByteStream {
     //! \returns a string
     std::string read(const size_t len);
 
+    //! Read (i.e., copy and then pop) the next "len" bytes of the stream into `dest`
+    //! \returns the number of bytes copied
+    size_t read(char *dest, const size_t len);
+
     //! \returns `true` if the stream input has ended
     bool input_ended() const;
 
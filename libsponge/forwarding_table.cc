@@ -0,0 +1,49 @@
+#include "forwarding_table.hh"
+
+#include <stdexcept>
+
+using namespace std;
+
+//! \param[in] route the route; its prefix length must be at most 32
+void ForwardingTable::add_route(const Route &route) {
+    if (route.prefix_length > 32) {
+        throw runtime_error("ForwardingTable: prefix length must be at most 32");
+    }
+
+    const optional<size_t> existing = _trie.find(route.route_prefix, route.prefix_length);
+    if (existing.has_value()) {
+        _routes[existing.value()] = route;
+    } else {
+        _routes.push_back(route);
+        _trie.insert(route.route_prefix, route.prefix_length, _routes.size() - 1);
+    }
+}
+
+//! \details The last route moves into the freed position, so the table stays dense.
+bool ForwardingTable::remove_route(const uint32_t route_prefix, const uint8_t prefix_length) {
+    const optional<size_t> index = _trie.find(route_prefix, prefix_length);
+    if (not index.has_value()) {
+        return false;
+    }
+    _trie.erase(route_prefix, prefix_length);
+
+    if (index.value() != _routes.size() - 1) {
+        _routes[index.value()] = _routes.back();
+        const Route &moved = _routes[index.value()];
+        _trie.insert(moved.route_prefix, moved.prefix_length, index.value());
+    }
+    _routes.pop_back();
+    return true;
+}
+
+optional<size_t> FlowCache::lookup(const ForwardingTable &table, const uint32_t dst) {
+    Entry &entry = _entries[_slot(dst)];
+    if (entry.generation == _generation and entry.dst == dst) {
+        _hits++;
+        return entry.route;
+    }
+
+    _misses++;
+    entry = {dst, _generation, table.lookup(dst)};
+    return entry.route;
+}
@@ -0,0 +1,90 @@
+#ifndef SPONGE_LIBSPONGE_FORWARDING_TABLE_HH
+#define SPONGE_LIBSPONGE_FORWARDING_TABLE_HH
+
+#include "address.hh"
+#include "prefix_trie.hh"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+//! \brief A router's table of routes, with longest-prefix-match lookup
+class ForwardingTable {
+  public:
+    //! Route entry in the table
+    struct Route {
+        uint32_t route_prefix;
+        uint8_t prefix_length;
+        std::optional<Address> next_hop;
+        size_t interface_idx;
+    };
+
+  private:
+    //! The routes, in no particular order
+    std::vector<Route> _routes{};
+
+    //! Longest-prefix-match index from route prefix to position in `_routes`
+    PrefixTrie _trie{};
+
+  public:
+    //! Add a route, replacing any route for the same prefix
+    void add_route(const Route &route);
+
+    //! \brief Remove the route for a prefix
+    //! \returns `true` if there was such a route
+    bool remove_route(const uint32_t route_prefix, const uint8_t prefix_length);
+
+    //! \returns the position of the route with the longest prefix matching `dst`, if any route matches
+    std::optional<size_t> lookup(const uint32_t dst) const { return _trie.lookup(dst); }
+
+    //! The route at a position returned by lookup()
+    const Route &route(const size_t index) const { return _routes[index]; }
+
+    //! Number of routes
+    size_t size() const { return _routes.size(); }
+};
+
+//! \brief Direct-mapped cache of ForwardingTable lookups, indexed by a hash of the destination address
+//! \details Destinations with no route are cached too. Entries remember the generation they were filled
+//! under, so invalidate() empties the whole cache at once; call it whenever the table changes.
+class FlowCache {
+  private:
+    //! The route found for one destination address
+    struct Entry {
+        uint32_t dst{};                 //!< destination address
+        uint64_t generation{};          //!< `_generation` when the entry was filled
+        std::optional<size_t> route{};  //!< position in the table of the matching route, if any
+    };
+
+    //! The cache has 2^BITS entries
+    static constexpr unsigned BITS = 10;
+
+    std::array<Entry, size_t{1} << BITS> _entries{};
+    uint64_t _generation{1};
+    uint64_t _hits{0};
+    uint64_t _misses{0};
+
+    //! Fibonacci hash of the destination address
+    static size_t _slot(const uint32_t dst) { return (dst * 0x9e3779b9u) >> (32 - BITS); }
+
+  public:
+    //! Forget every cached lookup
+    void invalidate() { _generation++; }
+
+    //! Start loading the entry for a destination address, ahead of a lookup()
+    void prefetch(const uint32_t dst) const { __builtin_prefetch(&_entries[_slot(dst)]); }
+
+    //! \brief Find the route for a destination address, in the cache or else in the table
+    //! \returns the position in `table` of the longest-prefix match, if any route matches
+    std::optional<size_t> lookup(const ForwardingTable &table, const uint32_t dst);
+
+    //! \name Statistics
+    //!@{
+    uint64_t hits() const { return _hits; }
+    uint64_t misses() const { return _misses; }
+    //!@}
+};
+
+#endif  // SPONGE_LIBSPONGE_FORWARDING_TABLE_HH
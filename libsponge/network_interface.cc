@@ -4,6 +4,8 @@
 #include "ethernet_frame.hh"
 
 #include <iostream>
+#include <stdexcept>
+#include <utility>
 
 // Dummy implementation of a network interface
 // Translates from {IP datagram, next hop address} to link-layer frame, and from link-layer frame to IP datagram
@@ -18,10 +20,20 @@ void DUMMY_CODE(Targs &&... /* unused */) {}
 
 using namespace std;
 
+//! 将 ARP 报文直接写入缓冲池分配的内存（预留 headroom，之后以太网首部可以原地写在它前面），不经过临时字符串
+static Buffer serialize_arp(const ARPMessage &arp_msg) {
+    Buffer ret = Buffer::allocate(ARPMessage::LENGTH, Buffer::DEFAULT_HEADROOM);
+    arp_msg.serialize_into(ret.mutable_data(), ARPMessage::LENGTH);
+    return ret;
+}
+
 //! \param[in] ethernet_address Ethernet (what ARP calls "hardware") address of the interface
 //! \param[in] ip_address IP (what ARP calls "protocol") address of the interface
-NetworkInterface::NetworkInterface(const EthernetAddress &ethernet_address, const Address &ip_address)
-    : _ethernet_address(ethernet_address), _ip_address(ip_address) {
+//! \param[in] arp_queue_limits limits on the datagrams held while waiting for ARP replies
+NetworkInterface::NetworkInterface(const EthernetAddress &ethernet_address,
+                                   const Address &ip_address,
+                                   const ARPQueueLimits &arp_queue_limits)
+    : _arp_queue_limits(arp_queue_limits), _ethernet_address(ethernet_address), _ip_address(ip_address) {
     cerr << "DEBUG: Network interface has Ethernet address " << to_string(_ethernet_address) << " and IP address "
          << ip_address.ip() << "\n";
 }
@@ -30,61 +42,209 @@ NetworkInterface::NetworkInterface(const EthernetAddress &ethernet_address, cons
 //! \param[in] next_hop the IP address of the interface to send it to (typically a router or default gateway, but may also be another host if directly connected to the same network as the destination)
 //! (Note: the Address type can be converted to a uint32_t (raw 32-bit IP address) with the Address::ipv4_numeric() method.)
 void NetworkInterface::send_datagram(const InternetDatagram &dgram, const Address &next_hop) {
-    // convert IP address of next hop to raw 32-bit representation (used in ARP header)
-    const uint32_t next_hop_ip = next_hop.ipv4_numeric();
-
-    // 在 ARP 表中搜索下一跳 IP 地址对应的 MAC 地址
-    const auto &arp_iter = _arp_table.find(next_hop_ip);
-    if (arp_iter == _arp_table.end()) {
-        // 如果没有找到 MAC 地址，且对该 IP 地址的 MAC 地址的 ARP 请求报文之前没有发送
-        // 发送对应的 ARP 请求报文
-        if (_waiting_arp_response_ip_addr.find(next_hop_ip) == _waiting_arp_response_ip_addr.end()) {
-            // 创建对应的 ARP 请求报文
-            ARPMessage arp_request;
-            arp_request.opcode = ARPMessage::OPCODE_REQUEST;
-            arp_request.sender_ip_address = _ip_address.ipv4_numeric();
-            arp_request.target_ip_address = next_hop_ip;
-            arp_request.sender_ethernet_address = _ethernet_address;
-            arp_request.target_ethernet_address = {};
-
-            // 封装到以太网帧中发送
-            EthernetFrame eth_frame;
-            eth_frame.header().src = _ethernet_address;
-            eth_frame.header().dst = ETHERNET_BROADCAST;
-            eth_frame.header().type = EthernetHeader::TYPE_ARP;
-            eth_frame.payload() = arp_request.serialize();
-            _frames_out.push(eth_frame);
+    send_outbound_datagram(dgram.serialize(), next_hop.ipv4_numeric());
+}
+
+//! \param[in] dgram the IPv4 datagram to be sent
+//! \param[in] next_hop the IP address of the interface to send it to
+void NetworkInterface::send_datagram(InternetDatagram &&dgram, const Address &next_hop) {
+    // 序列化推迟到发送时，但长度错误仍在此时报告（与立即序列化时一致）
+    if (dgram.payload().size() != dgram.header().payload_length()) {
+        throw runtime_error("NetworkInterface::send_datagram: payload is wrong size");
+    }
+    send_outbound_datagram(move(dgram), next_hop.ipv4_numeric());
+}
+
+//! \param[in] dgram the IPv4 datagram to be forwarded
+//! \param[in] next_hop the IP address of the interface to send it to
+void NetworkInterface::send_datagram(const IPv4DatagramView &dgram, const Address &next_hop) {
+    send_outbound_datagram(dgram.serialize(), next_hop.ipv4_numeric());
+}
+
+//! \param[in] batch the IPv4 datagrams to be forwarded, each with the raw 32-bit IP address of its next hop
+void NetworkInterface::send_datagrams(const vector<pair<IPv4DatagramView, uint32_t>> &batch) {
+    // 同一批中连续发往同一下一跳的数据报，只查找一次 ARP 表
+    ARP_Entry *arp_entry = nullptr;
+    optional<uint32_t> last_next_hop_ip;
+    for (const auto &[dgram, next_hop_ip] : batch) {
+        if (last_next_hop_ip != next_hop_ip) {
+            arp_entry = _arp_table.find(next_hop_ip);
+            last_next_hop_ip = next_hop_ip;
+        }
+        // 找到 MAC 地址则直接发送，否则按单个数据报的流程发送 ARP 请求并等待（不会修改 ARP 表）
+        if (arp_entry != nullptr) {
+            arp_entry->used = true;
+            send_frame(dgram.serialize(), arp_entry->eth_address);
+        } else {
+            send_outbound_datagram(dgram.serialize(), next_hop_ip);
+        }
+    }
+}
+
+//! \param[in] dgram the serialized IPv4 datagram
+//! \param[in] dst the Ethernet address of the next hop
+void NetworkInterface::send_frame(BufferList &&dgram, const EthernetAddress &dst) {
+    EthernetFrame eth_frame;
+    eth_frame.header().src = _ethernet_address;
+    eth_frame.header().dst = dst;
+    eth_frame.header().type = EthernetHeader::TYPE_IPv4;
+    eth_frame.payload() = move(dgram);
+    _frames_out.push(eth_frame);
+}
+
+//! \param[in] target_ip the raw 32-bit IP address whose Ethernet address is wanted
+//! \param[in] dst the Ethernet address to send the request to
+void NetworkInterface::send_arp_request(const uint32_t target_ip, const EthernetAddress &dst) {
+    // 创建对应的 ARP 请求报文
+    ARPMessage arp_request;
+    arp_request.opcode = ARPMessage::OPCODE_REQUEST;
+    arp_request.sender_ip_address = _ip_address.ipv4_numeric();
+    arp_request.target_ip_address = target_ip;
+    arp_request.sender_ethernet_address = _ethernet_address;
+    arp_request.target_ethernet_address = {};
+
+    // 封装到以太网帧中发送（通常为广播；刷新已知条目时单播给该 MAC 地址，见 RFC 1122 2.3.2.1）
+    EthernetFrame eth_frame;
+    eth_frame.header().src = _ethernet_address;
+    eth_frame.header().dst = dst;
+    eth_frame.header().type = EthernetHeader::TYPE_ARP;
+    eth_frame.payload() = serialize_arp(arp_request);
+    _frames_out.push(eth_frame);
+}
+
+//! \param[in] dgram the IPv4 datagram, serialized or not
+BufferList NetworkInterface::serialize_datagram(Outbound_Datagram &&dgram) {
+    if (holds_alternative<BufferList>(dgram)) {
+        return move(get<BufferList>(dgram));
+    }
+    return get<InternetDatagram>(dgram).serialize();
+}
+
+//! \param[in] dgram the IPv4 datagram, serialized or not
+//! \param[in] next_hop_ip the raw 32-bit IP address of the interface to send it to (also used in the ARP header)
+void NetworkInterface::send_outbound_datagram(Outbound_Datagram &&dgram, const uint32_t next_hop_ip) {
+    // 在 ARP 表中搜索下一跳 IP 地址对应的 MAC 地址（哈希表，通常只需探测一个槽位）
+    ARP_Entry *arp_entry = _arp_table.find(next_hop_ip);
+    if (arp_entry != nullptr) {
+        // 如果找到了 MAC 地址，则直接封装以太网帧并发送，并记录该条目正在使用，过期前需要刷新
+        arp_entry->used = true;
+        send_frame(serialize_datagram(move(dgram)), arp_entry->eth_address);
+        return;
+    }
+
+    // 如果没有找到 MAC 地址，且对该 IP 地址的 MAC 地址的 ARP 请求报文之前没有发送
+    // 发送对应的 ARP 请求报文，并记录超时时间，防止重复发送 ARP 请求
+    ARP_Request *request = _pending_arp.find(next_hop_ip);
+    if (request == nullptr) {
+        send_arp_request(next_hop_ip);
+        request = &_pending_arp[next_hop_ip];
+        request->ttl = _arp_response_ttl;
+    }
+    // 将缺乏 MAC 地址无法发送的 IP 数据报保存在该下一跳的等待队列中（尚未序列化的数据报，到发送时才序列化）
+    queue_waiting_datagram(*request, move(dgram), next_hop_ip);
+}
+
+//! \param[in] request the ARP request for the datagram's next hop
+//! \param[in] dgram the IPv4 datagram, serialized or not
+//! \param[in] next_hop_ip the raw 32-bit IP address of the datagram's next hop
+void NetworkInterface::queue_waiting_datagram(ARP_Request &request,
+                                              Outbound_Datagram &&dgram,
+                                              const uint32_t next_hop_ip) {
+    const ARPQueueLimits &limits = _arp_queue_limits;
+    const InternetDatagram *unserialized = get_if<InternetDatagram>(&dgram);
+    const size_t size = unserialized != nullptr ? unserialized->header().len : get<BufferList>(dgram).size();
+    const bool drop_newest = limits.policy == ARPQueueLimits::DropPolicy::DropNewest;
+
+    // 该下一跳的等待队列已满：丢弃最新的数据报（即当前数据报），或丢弃该队列中最旧的数据报直到放得下
+    // 单个数据报就超过限制时，无论哪种策略都只能丢弃它本身
+    bool fits = size <= limits.max_bytes_per_hop and size <= limits.max_bytes and limits.max_datagrams_per_hop > 0 and
+                limits.max_datagrams > 0;
+    while (fits and (request.datagrams.size() >= limits.max_datagrams_per_hop or
+                     request.bytes + size > limits.max_bytes_per_hop)) {
+        if (drop_newest) {
+            fits = false;
+        } else {
+            drop_waiting_datagram(request);
+        }
+    }
 
-            // 存放该请求和超时时间，防止重复发送 ARP 请求
-            _waiting_arp_response_ip_addr[next_hop_ip] = _arp_response_ttl;
+    // 所有下一跳的等待数据报总量超过限制：同理，丢弃当前数据报或全局最旧的数据报
+    // 全局最旧的数据报也一定是它所属下一跳队列中最旧的
+    while (fits and (_waiting_datagrams.size() >= limits.max_datagrams or _waiting_bytes + size > limits.max_bytes)) {
+        if (drop_newest) {
+            fits = false;
+        } else {
+            drop_waiting_datagram(*_pending_arp.find(_waiting_datagrams.front().next_hop_ip));
         }
-        // 将缺乏 MAC 地址无法发送的 IP 数据报和下一跳地址保存
-        _waiting_arp_internet_datagrams.push_back({next_hop, dgram});
-    } else {
-        // 如果找到了 MAC 地址，则直接封装以太网帧并发送
-        EthernetFrame eth_frame;
-        eth_frame.header().src = _ethernet_address;
-        eth_frame.header().dst = arp_iter->second.eth_address;
-        eth_frame.header().type = EthernetHeader::TYPE_IPv4;
-        eth_frame.payload() = dgram.serialize();
-        _frames_out.push(eth_frame);
     }
+
+    if (not fits) {
+        _arp_queue_drops++;
+        _arp_queue_dropped_bytes += size;
+        return;
+    }
+    _waiting_datagrams.push_back({next_hop_ip, move(dgram), size});
+    _waiting_bytes += size;
+    request.datagrams.push_back(prev(_waiting_datagrams.end()));
+    request.bytes += size;
+}
+
+//! \param[in] request an ARP request with at least one datagram waiting for it
+void NetworkInterface::drop_waiting_datagram(ARP_Request &request) {
+    const auto waiting = request.datagrams.front();
+    const size_t size = waiting->size;
+    request.datagrams.pop_front();
+    request.bytes -= size;
+    _waiting_datagrams.erase(waiting);
+    _waiting_bytes -= size;
+    _arp_queue_drops++;
+    _arp_queue_dropped_bytes += size;
+}
+
+//! \param[in] fd the descriptor to write the frames to (e.g. a TAP device or a datagram socket)
+size_t NetworkInterface::drain_to(FileDescriptor &fd) {
+    size_t written = 0;
+    _drain_frames.reserve(DRAIN_BATCH_SIZE);
+    while (not _frames_out.empty()) {
+        // 每次取出至多 DRAIN_BATCH_SIZE 个帧，序列化后一次写出
+        for (; _drain_frames.size() < DRAIN_BATCH_SIZE and not _frames_out.empty(); _frames_out.pop()) {
+            _drain_frames.push_back(_frames_out.front().serialize());
+            _drain_views.emplace_back(_drain_frames.back());
+        }
+        fd.write_packets(_drain_views);
+        written += _drain_frames.size();
+
+        // 清空批次（保留容量），尽快释放已写出帧的缓冲区
+        _drain_views.clear();
+        _drain_frames.clear();
+    }
+    return written;
 }
 
 //! \param[in] frame the incoming Ethernet frame
 optional<InternetDatagram> NetworkInterface::recv_frame(const EthernetFrame &frame) {
+    // 如果以太网帧封装的内容是 IP 数据报，则如果能从 payload 中成功解析则返回解析出的 IP 数据报，否则返回空
+    const optional<Buffer> payload = recv_frame_payload(frame);
+    if (not payload.has_value()) {
+        return nullopt;
+    }
+    InternetDatagram dgram;
+    if (dgram.parse(payload.value()) != ParseResult::NoError) {
+        return nullopt;
+    }
+    return dgram;
+}
+
+//! \param[in] frame the incoming Ethernet frame
+optional<Buffer> NetworkInterface::recv_frame_payload(const EthernetFrame &frame) {
     // 如果收到的以太网帧既不是广播帧，目的 MAC 地址也不是端口地址，则直接返回
     if (frame.header().dst != _ethernet_address && frame.header().dst != ETHERNET_BROADCAST) {
         return nullopt;
     }
 
-    // 如果以太网帧封装的内容是 IP 数据报，则如果能从 payload 中成功解析则返回解析出的 IP 数据报，否则返回空
+    // 如果以太网帧封装的内容是 IP 数据报，则原样返回 payload，由调用者决定如何解析
     if (frame.header().type == EthernetHeader::TYPE_IPv4) {
-        InternetDatagram dgram;
-        if (dgram.parse(frame.payload()) != ParseResult::NoError) {
-            return nullopt;
-        }
-        return dgram;
+        return Buffer{frame.payload()};
     }
 
     // 如果以太网帧封装的内容是 ARP 报文
@@ -117,24 +277,23 @@ optional<InternetDatagram> NetworkInterface::recv_frame(const EthernetFrame &fra
             eth_frame.header().src = _ethernet_address;
             eth_frame.header().dst = src_eth_addr;
             eth_frame.header().type = EthernetHeader::TYPE_ARP;
-            eth_frame.payload() = arp_reply.serialize();
+            eth_frame.payload() = serialize_arp(arp_reply);
             _frames_out.push(eth_frame);
         }
 
         // 如果 ARP 报文有效，根据其源 MAC 地址和源 IP 地址更新 ARP 表
-        // 从等待目的 MAC 地址的数据报中找到目的 IP 地址和 ARP 报文的源 IP 地址一致的，重新发送
-        // 此时因为更新了 ARP 表，所以可以成功发送，并将其从等待列表中删除
+        // 等待该 IP 地址的数据报都在它自己的队列中，按到达顺序全部发送，并结束对应的 ARP 请求
         if (valid_request || valid_response) {
-            _arp_table[src_ip_addr] = {src_eth_addr, _arp_entry_ttl};
-            for (auto iter = _waiting_arp_internet_datagrams.begin(); iter != _waiting_arp_internet_datagrams.end();) {
-                if (iter->first.ipv4_numeric() == src_ip_addr) {
-                    send_datagram(iter->second, iter->first);
-                    iter = _waiting_arp_internet_datagrams.erase(iter);
-                } else {
-                    iter++;
+            _arp_table[src_ip_addr] = {src_eth_addr, _arp_entry_ttl, false, false};
+            ARP_Request *request = _pending_arp.find(src_ip_addr);
+            if (request != nullptr) {
+                for (const auto &waiting : request->datagrams) {
+                    _waiting_bytes -= waiting->size;
+                    send_frame(serialize_datagram(move(waiting->dgram)), src_eth_addr);
+                    _waiting_datagrams.erase(waiting);
                 }
+                _pending_arp.erase(src_ip_addr);
             }
-            _waiting_arp_response_ip_addr.erase(src_ip_addr);
         }
     }
     return nullopt;
@@ -143,37 +302,27 @@ optional<InternetDatagram> NetworkInterface::recv_frame(const EthernetFrame &fra
 //! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
 void NetworkInterface::tick(const size_t ms_since_last_tick) {
     // 更新 ARP 表中的条目的持续时间，删除过期条目
-    for (auto iter = _arp_table.begin(); iter != _arp_table.end();) {
-        if (iter->second.ttl <= ms_since_last_tick) {
-            iter = _arp_table.erase(iter);
-        } else {
-            iter->second.ttl -= ms_since_last_tick;
-            iter++;
+    _arp_table.erase_if([&](uint32_t, const ARP_Entry &entry) { return entry.ttl <= ms_since_last_tick; });
+    _arp_table.for_each([&](const uint32_t ip_addr, ARP_Entry &entry) {
+        entry.ttl -= ms_since_last_tick;
+
+        // 正在使用的条目在过期前主动刷新：单播 ARP 请求给已知的 MAC 地址
+        // 刷新期间条目的有效期延长一个 ARP 响应超时时间，即使已经过时也继续使用，避免数据报排队等待 ARP 响应
+        // 如果超时仍未收到响应，条目被删除，之后的数据报重新广播 ARP 请求
+        if (entry.used and not entry.refreshing and entry.ttl <= _arp_refresh_time) {
+            send_arp_request(ip_addr, entry.eth_address);
+            entry.ttl += _arp_response_ttl;
+            entry.refreshing = true;
         }
-    }
+    });
 
     // 更新等待 ARP 响应报文的 IP 地址的持续时间，如果超时，则重新发送一次 ARP 请求报文
-    for (auto iter = _waiting_arp_response_ip_addr.begin(); iter != _waiting_arp_response_ip_addr.end();) {
-        if (iter->second <= ms_since_last_tick) {
-            ARPMessage arp_request;
-            arp_request.opcode = ARPMessage::OPCODE_REQUEST;
-            arp_request.sender_ip_address = _ip_address.ipv4_numeric();
-            arp_request.target_ip_address = iter->first;
-            arp_request.sender_ethernet_address = _ethernet_address;
-            arp_request.target_ethernet_address = {};
-
-            EthernetFrame eth_frame;
-            eth_frame.header().src = _ethernet_address;
-            eth_frame.header().dst = ETHERNET_BROADCAST;
-            eth_frame.header().type = EthernetHeader::TYPE_ARP;
-            eth_frame.payload() = arp_request.serialize();
-            _frames_out.push(eth_frame);
-
-            iter->second = _arp_response_ttl;
-            iter++;
+    _pending_arp.for_each([&](const uint32_t target_ip, ARP_Request &request) {
+        if (request.ttl <= ms_since_last_tick) {
+            send_arp_request(target_ip);
+            request.ttl = _arp_response_ttl;
         } else {
-            iter->second -= ms_since_last_tick;
-            iter++;
+            request.ttl -= ms_since_last_tick;
         }
-    }
+    });
 }
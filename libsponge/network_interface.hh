@@ -2,13 +2,32 @@
 #define SPONGE_LIBSPONGE_NETWORK_INTERFACE_HH
 
 #include "ethernet_frame.hh"
+#include "ip_address_map.hh"
 #include "tcp_over_ip.hh"
 #include "tun.hh"
 
+#include <cstdint>
+#include <deque>
 #include <list>
-#include <map>
 #include <optional>
 #include <queue>
+#include <utility>
+#include <variant>
+#include <vector>
+
+//! \brief Limits on the datagrams a NetworkInterface holds while it waits for ARP replies
+//! \details A datagram that would take a queue past a limit makes room by dropping the oldest queued datagram
+//! (of the same next hop, for the per-next-hop limits), or is dropped itself, according to `policy`.
+//! The defaults follow Linux's neighbor table (`unres_qlen_bytes`).
+struct ARPQueueLimits {
+    enum class DropPolicy { DropOldest, DropNewest };
+
+    size_t max_datagrams_per_hop = 64;   //!< datagrams waiting for any one next hop
+    size_t max_bytes_per_hop = 212992;   //!< bytes of datagrams waiting for any one next hop
+    size_t max_datagrams = 1024;         //!< datagrams waiting, over all next hops
+    size_t max_bytes = 4 * 1024 * 1024;  //!< bytes of datagrams waiting, over all next hops
+    DropPolicy policy = DropPolicy::DropOldest;
+};
 
 //! \brief A "network interface" that connects IP (the internet layer, or network layer)
 //! with Ethernet (the network access layer, or link layer).
@@ -35,24 +54,56 @@ class NetworkInterface {
   private:
     //! ARP Entry in ART table
     struct ARP_Entry {
-        EthernetAddress eth_address;
-        size_t ttl;
+        EthernetAddress eth_address{};
+        size_t ttl{};
+        bool used{false};        //!< a datagram has been sent using the entry since it was learned
+        bool refreshing{false};  //!< a refresh request has been sent, and the entry may be used while stale
     };
 
     //! ARP table
-    std::map<uint32_t, ARP_Entry> _arp_table{};
+    IPAddressMap<ARP_Entry> _arp_table{};
 
     //! ARP out of date time
     const size_t _arp_entry_ttl = 30 * 1000;
 
-    //! ARP Message waiting for response
-    std::map<uint32_t, size_t> _waiting_arp_response_ip_addr{};
+    //! An entry in use is refreshed once it has this long left before it is out of date
+    const size_t _arp_refresh_time = 3 * 1000;
+
+    //! IP Datagram to send: already serialized, or (if the interface was given it to keep) not yet
+    using Outbound_Datagram = std::variant<BufferList, InternetDatagram>;
+
+    //! IP Datagram waiting for ARP Message, its size and the IP address of its next hop
+    struct Waiting_Datagram {
+        uint32_t next_hop_ip;
+        Outbound_Datagram dgram;
+        size_t size;
+    };
+
+    //! Every datagram waiting for ARP Message, oldest first
+    std::list<Waiting_Datagram> _waiting_datagrams{};
+
+    //! Total size of `_waiting_datagrams`
+    size_t _waiting_bytes{0};
+
+    //! ARP request awaiting a reply, and the datagrams waiting for it, oldest first
+    struct ARP_Request {
+        size_t ttl{};
+        std::deque<std::list<Waiting_Datagram>::iterator> datagrams{};
+        size_t bytes{};  //!< total size of `datagrams`
+    };
+
+    //! Outstanding ARP requests, by the IP address they ask about
+    IPAddressMap<ARP_Request> _pending_arp{};
 
     //! ARP Request out of date time
     const size_t _arp_response_ttl = 5 * 1000;
 
-    //! IP Datagram waiting for ARP Message
-    std::list<std::pair<Address, InternetDatagram>> _waiting_arp_internet_datagrams{};
+    //! Limits on `_waiting_datagrams`
+    ARPQueueLimits _arp_queue_limits;
+
+    //! Datagrams dropped, and their total size, because `_waiting_datagrams` reached a limit
+    uint64_t _arp_queue_drops{0};
+    uint64_t _arp_queue_dropped_bytes{0};
 
     //! Ethernet (known as hardware, network-access-layer, or link-layer) address of the interface
     EthernetAddress _ethernet_address;
@@ -63,19 +114,69 @@ class NetworkInterface {
     //! outbound queue of Ethernet frames that the NetworkInterface wants sent
     std::queue<EthernetFrame> _frames_out{};
 
+    //! Most frames drain_to() writes with one batched write
+    static constexpr size_t DRAIN_BATCH_SIZE = 64;
+
+    //! Serialized frames of the batch drain_to() is writing, and views of them (kept for their capacity)
+    std::vector<BufferList> _drain_frames{};
+    std::vector<BufferViewList> _drain_views{};
+
+    //! Send an IPv4 datagram (or queue it until the next hop's Ethernet address is known)
+    void send_outbound_datagram(Outbound_Datagram &&dgram, const uint32_t next_hop_ip);
+
+    //! The datagram's bytes, serializing it now if it was not serialized yet
+    static BufferList serialize_datagram(Outbound_Datagram &&dgram);
+
+    //! Put a serialized IPv4 datagram in an Ethernet frame addressed to `dst` and queue it for sending
+    void send_frame(BufferList &&dgram, const EthernetAddress &dst);
+
+    //! Send an ARP request for the Ethernet address of `target_ip` (broadcast, unless refreshing a known one)
+    void send_arp_request(const uint32_t target_ip, const EthernetAddress &dst = ETHERNET_BROADCAST);
+
+    //! Queue a datagram until `request` is answered, dropping datagrams to stay within the limits
+    void queue_waiting_datagram(ARP_Request &request, Outbound_Datagram &&dgram, const uint32_t next_hop_ip);
+
+    //! Drop the oldest datagram waiting for `request`
+    void drop_waiting_datagram(ARP_Request &request);
+
+  protected:
+    //! \brief Receives an Ethernet frame like recv_frame(), but leaves an IPv4 payload unparsed
+    //! \returns the payload if the frame carries an IPv4 datagram for this interface
+    std::optional<Buffer> recv_frame_payload(const EthernetFrame &frame);
+
   public:
     //! \brief Construct a network interface with given Ethernet (network-access-layer) and IP (internet-layer) addresses
-    NetworkInterface(const EthernetAddress &ethernet_address, const Address &ip_address);
+    NetworkInterface(const EthernetAddress &ethernet_address,
+                     const Address &ip_address,
+                     const ARPQueueLimits &arp_queue_limits = {});
 
     //! \brief Access queue of Ethernet frames awaiting transmission
     std::queue<EthernetFrame> &frames_out() { return _frames_out; }
 
+    //! \brief Write every frame awaiting transmission to `fd`, in batches of up to DRAIN_BATCH_SIZE frames
+    //! \details Each batch is one system call, on a socket or (with io_uring) a TAP device; see
+    //! FileDescriptor::write_packets
+    //! \returns the number of frames written
+    size_t drain_to(FileDescriptor &fd);
+
     //! \brief Sends an IPv4 datagram, encapsulated in an Ethernet frame (if it knows the Ethernet destination address).
 
     //! Will need to use [ARP](\ref rfc::rfc826) to look up the Ethernet destination address for the next hop
     //! ("Sending" is accomplished by pushing the frame onto the frames_out queue.)
     void send_datagram(const InternetDatagram &dgram, const Address &next_hop);
 
+    //! \brief Sends an IPv4 datagram that the caller no longer needs
+    //! \details The datagram is only serialized once it can be sent: while it waits for ARP it is kept as it is,
+    //! and it is never serialized at all if it is dropped.
+    void send_datagram(InternetDatagram &&dgram, const Address &next_hop);
+
+    //! \brief Sends an IPv4 datagram that is being forwarded, reusing its received bytes
+    void send_datagram(const IPv4DatagramView &dgram, const Address &next_hop);
+
+    //! \brief Sends a batch of datagrams that are being forwarded, each paired with its next hop's raw IP address
+    //! \details Runs of datagrams to the same next hop share one ARP table lookup.
+    void send_datagrams(const std::vector<std::pair<IPv4DatagramView, uint32_t>> &batch);
+
     //! \brief Receives an Ethernet frame and responds appropriately.
 
     //! If type is IPv4, returns the datagram.
@@ -85,6 +186,12 @@ class NetworkInterface {
 
     //! \brief Called periodically when time elapses
     void tick(const size_t ms_since_last_tick);
+
+    //! \name Datagrams dropped, and their total size, because too many were waiting for ARP replies
+    //!@{
+    uint64_t arp_queue_drops() const { return _arp_queue_drops; }
+    uint64_t arp_queue_dropped_bytes() const { return _arp_queue_dropped_bytes; }
+    //!@}
 };
 
 #endif  // SPONGE_LIBSPONGE_NETWORK_INTERFACE_HH
@@ -1,6 +1,8 @@
 #include "router.hh"
 
+#include <array>
 #include <iostream>
+#include <utility>
 
 using namespace std;
 
@@ -29,45 +31,77 @@ void Router::add_route(const uint32_t route_prefix,
     cerr << "DEBUG: adding route " << Address::from_ipv4_numeric(route_prefix).ip() << "/" << int(prefix_length)
          << " => " << (next_hop.has_value() ? next_hop->ip() : "(direct)") << " on interface " << interface_num << "\n";
 
-    // 直接向路由表中添加条目
-    _route_table.push_back({route_prefix, prefix_length, next_hop, interface_num});
+    // 路由表发生变化，流缓存中的查找结果全部失效；相同前缀的条目会被替换
+    _route_table.add_route({route_prefix, prefix_length, next_hop, interface_num});
+    _flow_cache.invalidate();
 }
 
-//! \param[in] dgram The datagram to be routed
-void Router::route_one_datagram(InternetDatagram &dgram) {
-    // 读取数据报中的目标 IP 地址
-    const uint32_t dst_ip_addr = dgram.header().dst;
-    auto match_entry = _route_table.end();
-
-    // 进行最长前缀匹配，选出其中前缀长度最长的转发表条目
-    for (auto iter = _route_table.begin(); iter != _route_table.end(); iter++) {
-        if (iter->prefix_length == 0 || (iter->route_prefix ^ dst_ip_addr) >> (32 - iter->prefix_length) == 0) {
-            if (match_entry == _route_table.end() || match_entry->prefix_length < iter->prefix_length) {
-                match_entry = iter;
-            }
+//! \param[in] route_prefix The prefix of the route to remove
+//! \param[in] prefix_length The length of that prefix
+bool Router::remove_route(const uint32_t route_prefix, const uint8_t prefix_length) {
+    if (not _route_table.remove_route(route_prefix, prefix_length)) {
+        return false;
+    }
+    _flow_cache.invalidate();
+    return true;
+}
+
+//! \param[in] queue The received datagrams (not yet parsed) of one interface
+//! \details The batch is handled in stages, so that each stage's memory accesses overlap across datagrams
+//! instead of being paid one datagram at a time: parse every datagram, prefetch every flow cache entry,
+//! look up every route, then give each outbound interface all of its datagrams at once.
+void Router::route_batch(queue<Buffer> &queue) {
+    array<IPv4DatagramView, ROUTE_BATCH_SIZE> dgrams;
+    array<uint32_t, ROUTE_BATCH_SIZE> dst_ip_addrs;
+
+    // 取出一批数据报，直接从收到的字节中读取目标 IP 地址，无需解析整个首部
+    size_t count = 0;
+    for (; count < ROUTE_BATCH_SIZE and not queue.empty(); queue.pop()) {
+        if (dgrams[count].parse(queue.front()) == ParseResult::NoError) {
+            dst_ip_addrs[count] = dgrams[count].dst();
+            count++;
+        }
+    }
+
+    // 预取这一批数据报对应的流缓存槽位，使各次访存相互重叠
+    for (size_t i = 0; i < count; i++) {
+        _flow_cache.prefetch(dst_ip_addrs[i]);
+    }
+
+    // 如果匹配了某一转发表条目，并且数据报的 ttl > 1（确保可以继续转发），按输出端口分组
+    // 注意到转发表条目中下一跳地址可能为空，需要根据目标 IP 地址构建
+    // ttl 递减时只复制首部并增量更新首部校验和（RFC 1624），payload 原样转发，无需重新序列化
+    _egress_batches.resize(_interfaces.size());
+    for (size_t i = 0; i < count; i++) {
+        // 先查流缓存，未命中时再在前缀树中进行最长前缀匹配
+        const optional<size_t> match = _flow_cache.lookup(_route_table, dst_ip_addrs[i]);
+        if (not match.has_value() or dgrams[i].ttl() <= 1) {
+            continue;
         }
+        dgrams[i].decrement_ttl();
+        const ForwardingTable::Route &match_entry = _route_table.route(match.value());
+        const uint32_t next_hop_ip =
+            match_entry.next_hop.has_value() ? match_entry.next_hop->ipv4_numeric() : dst_ip_addrs[i];
+        _egress_batches[match_entry.interface_idx].emplace_back(move(dgrams[i]), next_hop_ip);
     }
 
-    // 如果匹配了某一转发表条目，并且数据报的 ttl > 1（确保可以继续转发）
-    // 使用对应的输出端口进行转发，注意到转发表条目中下一跳地址可能为空，需要根据目标 IP 地址构建
-    if (match_entry != _route_table.end() && dgram.header().ttl-- > 1) {
-        const optional<Address> next_hop = match_entry->next_hop;
-        AsyncNetworkInterface &interface = _interfaces[match_entry->interface_idx];
-        if (next_hop.has_value()) {
-            interface.send_datagram(dgram, next_hop.value());
-        } else {
-            interface.send_datagram(dgram, Address::from_ipv4_numeric(dst_ip_addr));
+    // 每个输出端口一次性发送属于它的数据报
+    for (size_t interface_idx = 0; interface_idx < _egress_batches.size(); interface_idx++) {
+        auto &batch = _egress_batches[interface_idx];
+        if (not batch.empty()) {
+            _interfaces[interface_idx].send_datagrams(batch);
+            batch.clear();
         }
     }
 }
 
 void Router::route() {
     // Go through all the interfaces, and route every incoming datagram to its proper outgoing interface.
+    // Datagrams are only checked and decoded as far as forwarding needs (see IPv4DatagramView).
     for (auto &interface : _interfaces) {
-        auto &queue = interface.datagrams_out();
+        auto &queue = interface.unparsed_datagrams_out();
         while (not queue.empty()) {
-            route_one_datagram(queue.front());
-            queue.pop();
+            route_batch(queue);
         }
     }
 }
@@ -1,6 +1,7 @@
 #ifndef SPONGE_LIBSPONGE_ROUTER_HH
 #define SPONGE_LIBSPONGE_ROUTER_HH
 
+#include "forwarding_table.hh"
 #include "network_interface.hh"
 
 #include <optional>
@@ -13,6 +14,7 @@
 //! later retrieval. Otherwise, behaves identically to the underlying
 //! implementation of NetworkInterface.
 class AsyncNetworkInterface : public NetworkInterface {
+    std::queue<Buffer> _unparsed_datagrams_out{};
     std::queue<InternetDatagram> _datagrams_out{};
 
   public:
@@ -29,14 +31,26 @@ class AsyncNetworkInterface : public NetworkInterface {
     //!
     //! \param[in] frame the incoming Ethernet frame
     void recv_frame(const EthernetFrame &frame) {
-        auto optional_dgram = NetworkInterface::recv_frame(frame);
-        if (optional_dgram.has_value()) {
-            _datagrams_out.push(std::move(optional_dgram.value()));
+        auto optional_payload = NetworkInterface::recv_frame_payload(frame);
+        if (optional_payload.has_value()) {
+            _unparsed_datagrams_out.push(std::move(optional_payload.value()));
         }
     };
 
     //! Access queue of Internet datagrams that have been received
-    std::queue<InternetDatagram> &datagrams_out() { return _datagrams_out; }
+    //! \note Parses any datagrams still in unparsed_datagrams_out(), dropping those that fail to parse
+    std::queue<InternetDatagram> &datagrams_out() {
+        for (; not _unparsed_datagrams_out.empty(); _unparsed_datagrams_out.pop()) {
+            InternetDatagram dgram;
+            if (dgram.parse(_unparsed_datagrams_out.front()) == ParseResult::NoError) {
+                _datagrams_out.push(std::move(dgram));
+            }
+        }
+        return _datagrams_out;
+    }
+
+    //! Access queue of received Internet datagrams that have not been parsed yet (e.g. for IPv4DatagramView)
+    std::queue<Buffer> &unparsed_datagrams_out() { return _unparsed_datagrams_out; }
 };
 
 //! \brief A router that has multiple network interfaces and
@@ -45,21 +59,22 @@ class Router {
     //! The router's collection of network interfaces
     std::vector<AsyncNetworkInterface> _interfaces{};
 
-    //! Send a single datagram from the appropriate outbound interface to the next hop,
-    //! as specified by the route with the longest prefix_length that matches the
-    //! datagram's destination address.
-    void route_one_datagram(InternetDatagram &dgram);
-
-    //! Route entry in Route table
-    struct RouteEntry {
-        const uint32_t route_prefix;
-        const uint8_t prefix_length;
-        const std::optional<Address> next_hop;
-        const size_t interface_idx;
-    };
+    //! Number of datagrams taken from an interface and routed together
+    static constexpr size_t ROUTE_BATCH_SIZE = 32;
+
+    //! Take up to ROUTE_BATCH_SIZE datagrams from the queue and send each from the appropriate outbound
+    //! interface to the next hop, as specified by the route with the longest prefix_length that matches
+    //! the datagram's destination address.
+    void route_batch(std::queue<Buffer> &queue);
+
+    //! The datagrams of the current batch, grouped by outbound interface (kept between batches for their capacity)
+    std::vector<std::vector<std::pair<IPv4DatagramView, uint32_t>>> _egress_batches{};
 
     //! Route table
-    std::vector<RouteEntry> _route_table{};
+    ForwardingTable _route_table{};
+
+    //! Cache of recent route lookups, by destination address
+    FlowCache _flow_cache{};
 
   public:
     //! Add an interface to the router
@@ -73,14 +88,24 @@ class Router {
     //! Access an interface by index
     AsyncNetworkInterface &interface(const size_t N) { return _interfaces.at(N); }
 
-    //! Add a route (a forwarding rule)
+    //! Add a route (a forwarding rule), replacing any route for the same prefix
     void add_route(const uint32_t route_prefix,
                    const uint8_t prefix_length,
                    const std::optional<Address> next_hop,
                    const size_t interface_num);
 
+    //! \brief Remove the route for a prefix
+    //! \returns `true` if there was such a route
+    bool remove_route(const uint32_t route_prefix, const uint8_t prefix_length);
+
     //! Route packets between the interfaces
     void route();
+
+    //! \name Flow cache statistics
+    //!@{
+    uint64_t flow_cache_hits() const { return _flow_cache.hits(); }
+    uint64_t flow_cache_misses() const { return _flow_cache.misses(); }
+    //!@}
 };
 
 #endif  // SPONGE_LIBSPONGE_ROUTER_HH
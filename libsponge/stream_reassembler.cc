@@ -23,7 +23,7 @@ StreamReassembler::StreamReassembler(const size_t capacity)
 //! \details This function accepts a substring (aka a segment) of bytes,
 //! possibly out-of-order, from the logical stream, and assembles any newly
 //! contiguous substrings and writes them into the output stream in order.
-void StreamReassembler::push_substring(const string &data, const size_t index, const bool eof) {
+void StreamReassembler::push_substring(string_view data, const size_t index, const bool eof) {
     // 此时的 map 是若干个不重叠的序列，key是序列中第一个字节在字节流中的序号，每个序列的 key 都 >= _next_assembled_idx
 
     /**
@@ -107,22 +107,58 @@ void StreamReassembler::push_substring(const string &data, const size_t index, c
      *  2. 如果无法发送，存储在 map 中
      */
     if (data_size > 0) {
-        const string new_data = data.substr(data_start_pos, data_size);
+        const string_view new_data = data.substr(data_start_pos, data_size);
         if (new_idx == _next_assembled_idx) {
             const size_t write_bytes = _output.write(new_data);
             _next_assembled_idx += write_bytes;
             if (write_bytes < new_data.size()) {
-                const string store_data = new_data.substr(write_bytes, new_data.size() - write_bytes);
+                string store_data(new_data.substr(write_bytes));
                 _unassemble_bytes_num += store_data.size();
                 _unassemble_strs.insert(make_pair(_next_assembled_idx, std::move(store_data)));
             }
         } else {
-            const string store_data = new_data.substr(0, new_data.size());
+            string store_data(new_data);
             _unassemble_bytes_num += store_data.size();
             _unassemble_strs.insert(make_pair(new_idx, std::move(store_data)));
         }
     }
 
+    // 如果有 eof 标志，更新 eof 对应的字节序号
+    if (eof) {
+        _eof_idx = index + data.size();
+    }
+
+    _assemble();
+}
+
+//! \details The bytes are already in the stream's storage, so committing them only has to drop
+//! (or trim) stored substrings that they cover, before writing out whatever has become contiguous.
+void StreamReassembler::push_written(const size_t len, const bool eof) {
+    const size_t new_next_idx = _next_assembled_idx + len;
+    _output.commit_write(len);
+
+    // map 中与新写入的字节重叠的序列：被完全覆盖的删除，部分覆盖的只保留未覆盖的后半部分
+    for (auto iter = _unassemble_strs.begin(); iter != _unassemble_strs.end() && iter->first < new_next_idx;) {
+        const size_t end_idx = iter->first + iter->second.size();
+        if (new_next_idx < end_idx) {
+            string rest = iter->second.substr(new_next_idx - iter->first);
+            _unassemble_bytes_num -= iter->second.size() - rest.size();
+            _unassemble_strs.insert(make_pair(new_next_idx, std::move(rest)));
+        } else {
+            _unassemble_bytes_num -= iter->second.size();
+        }
+        iter = _unassemble_strs.erase(iter);
+    }
+    _next_assembled_idx = new_next_idx;
+
+    if (eof) {
+        _eof_idx = new_next_idx;
+    }
+
+    _assemble();
+}
+
+void StreamReassembler::_assemble() {
     /**
      *  完成上述工作后发送对 map 中可以被发送的序列
      *  可能因为1. 发送了新序列导致 _next_assemble_idx 变大，2. bystream 中有空间发送新的序列
@@ -150,11 +186,6 @@ void StreamReassembler::push_substring(const string &data, const size_t index, c
         }
     }
 
-    // 如果有 eof 标志，更新 eof 对应的字节序号
-    if (eof) {
-        _eof_idx = index + data.size();
-    }
-
     // 如果 eof 的字节序号 <= _next_assembled_idx，不再需要发送新的字节，关闭 bytestream 的输入
     if (_eof_idx <= _next_assembled_idx) {
         _output.end_input();
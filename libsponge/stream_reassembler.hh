@@ -6,6 +6,7 @@
 #include <cstdint>
 #include <map>
 #include <string>
+#include <string_view>
 
 //! \brief A class that assembles a series of excerpts from a byte stream (possibly out of order,
 //! possibly overlapping) into an in-order byte stream.
@@ -19,6 +20,9 @@ class StreamReassembler {
     ByteStream _output;            //!< The reassembled in-order byte stream
     size_t _capacity;              //!< The maximum number of bytes
 
+    //! Write the stored substrings that have become contiguous, and end the stream once eof is reached
+    void _assemble();
+
   public:
     //! \brief Construct a `StreamReassembler` that will store up to `capacity` bytes.
     //! \note This capacity limits both the bytes that have been reassembled,
@@ -33,7 +37,14 @@ class StreamReassembler {
     //! \param data the substring
     //! \param index indicates the index (place in sequence) of the first byte in `data`
     //! \param eof the last byte of `data` will be the last byte in the entire stream
-    void push_substring(const std::string &data, const uint64_t index, const bool eof);
+    void push_substring(std::string_view data, const uint64_t index, const bool eof);
+
+    //! \brief Receive a substring that the caller has already copied into the stream's free space
+    //! (ByteStream::free_space()), starting at the next index the stream expects
+    //! \details Equivalent to push_substring() of those `len` bytes at that index, without copying them again.
+    //! \param len the number of bytes copied; at most the stream's remaining capacity
+    //! \param eof the last of those bytes will be the last byte in the entire stream
+    void push_written(const size_t len, const bool eof);
 
     //! \name Access the reassembled byte stream
     //!@{
@@ -1,6 +1,7 @@
 #include "arp_message.hh"
 
 #include <arpa/inet.h>
+#include <cstring>
 #include <iomanip>
 #include <sstream>
 
@@ -44,31 +45,38 @@ bool ARPMessage::supported() const {
            ((opcode == OPCODE_REQUEST) or (opcode == OPCODE_REPLY));
 }
 
-string ARPMessage::serialize() const {
+//! \param[out] dest receives the message
+//! \param[in] size is the room available at `dest`, checked once before anything is written
+//! \returns the number of bytes written (always `LENGTH`)
+size_t ARPMessage::serialize_into(char *dest, const size_t size) const {
     if (not supported()) {
         throw runtime_error(
             "ARPMessage::serialize(): unsupported field combination (must be Ethernet/IP, and request or reply)");
     }
+    if (size < LENGTH) {
+        throw runtime_error("ARPMessage::serialize(): no room for message");
+    }
 
-    string ret;
-    NetUnparser::u16(ret, hardware_type);
-    NetUnparser::u16(ret, protocol_type);
-    NetUnparser::u8(ret, hardware_address_size);
-    NetUnparser::u8(ret, protocol_address_size);
-    NetUnparser::u16(ret, opcode);
+    NetUnparser::u16(dest, 0, hardware_type);
+    NetUnparser::u16(dest, 2, protocol_type);
+    NetUnparser::u8(dest, 4, hardware_address_size);
+    NetUnparser::u8(dest, 5, protocol_address_size);
+    NetUnparser::u16(dest, 6, opcode);
 
     /* write sender addresses */
-    for (auto &byte : sender_ethernet_address) {
-        NetUnparser::u8(ret, byte);
-    }
-    NetUnparser::u32(ret, sender_ip_address);
+    memcpy(dest + 8, sender_ethernet_address.data(), sender_ethernet_address.size());
+    NetUnparser::u32(dest, 14, sender_ip_address);
 
     /* write target addresses */
-    for (auto &byte : target_ethernet_address) {
-        NetUnparser::u8(ret, byte);
-    }
-    NetUnparser::u32(ret, target_ip_address);
+    memcpy(dest + 18, target_ethernet_address.data(), target_ethernet_address.size());
+    NetUnparser::u32(dest, 24, target_ip_address);
+
+    return LENGTH;
+}
 
+string ARPMessage::serialize() const {
+    string ret(LENGTH, 0);
+    serialize_into(ret.data(), ret.size());
     return ret;
 }
 
@@ -34,6 +34,9 @@ struct ARPMessage {
     //! Serialize the ARP message to a string
     std::string serialize() const;
 
+    //! Serialize the ARP message into `size` bytes of preallocated memory at `dest`
+    size_t serialize_into(char *dest, const size_t size) const;
+
     //! Return a string containing the ARP message in human-readable format
     std::string to_string() const;
 
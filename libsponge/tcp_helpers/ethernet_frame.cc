@@ -17,8 +17,8 @@ ParseResult EthernetFrame::parse(const Buffer buffer) {
 }
 
 BufferList EthernetFrame::serialize() const {
-    BufferList ret;
-    ret.append(_header.serialize());
-    ret.append(_payload);
+    // write the header in front of the payload (in place, if the payload has headroom)
+    BufferList ret{_payload};
+    _header.serialize_into(ret.prepend(EthernetHeader::LENGTH), EthernetHeader::LENGTH);
     return ret;
 }
@@ -2,49 +2,55 @@
 
 #include "util.hh"
 
+#include <cstring>
 #include <iomanip>
 #include <sstream>
 
 using namespace std;
 
 ParseResult EthernetHeader::parse(NetParser &p) {
-    if (p.buffer().size() < EthernetHeader::LENGTH) {
+    // check the length once, then decode the whole header in one step
+    const string_view fixed = p.peek(EthernetHeader::LENGTH);
+    if (fixed.empty()) {
         return ParseResult::PacketTooShort;
     }
 
     /* read destination address */
-    for (auto &byte : dst) {
-        byte = p.u8();
-    }
+    memcpy(dst.data(), fixed.data(), dst.size());
 
     /* read source address */
-    for (auto &byte : src) {
-        byte = p.u8();
-    }
+    memcpy(src.data(), fixed.data() + dst.size(), src.size());
 
     /* read the frame's type (e.g. IPv4, ARP, or something else) */
-    type = p.u16();
+    type = NetParser::u16(fixed, dst.size() + src.size());
+    p.remove_prefix(EthernetHeader::LENGTH);
 
     return p.get_error();
 }
 
-string EthernetHeader::serialize() const {
-    string ret;
-    ret.reserve(LENGTH);
+//! \param[out] dest receives the header
+//! \param[in] size is the room available at `dest`, checked once before anything is written
+//! \returns the number of bytes written (always `LENGTH`)
+size_t EthernetHeader::serialize_into(char *dest, const size_t size) const {
+    if (size < LENGTH) {
+        throw runtime_error("no room to serialize Ethernet header");
+    }
 
     /* write destination address */
-    for (auto &byte : dst) {
-        NetUnparser::u8(ret, byte);
-    }
+    memcpy(dest, dst.data(), dst.size());
 
     /* write source address */
-    for (auto &byte : src) {
-        NetUnparser::u8(ret, byte);
-    }
+    memcpy(dest + dst.size(), src.data(), src.size());
 
     /* write the frame's type (e.g. IPv4, ARP or something else) */
-    NetUnparser::u16(ret, type);
+    NetUnparser::u16(dest, dst.size() + src.size(), type);
+
+    return LENGTH;
+}
 
+string EthernetHeader::serialize() const {
+    string ret(LENGTH, 0);
+    serialize_into(ret.data(), ret.size());
     return ret;
 }
 
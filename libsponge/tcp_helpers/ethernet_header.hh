@@ -33,6 +33,9 @@ struct EthernetHeader {
     //! Serialize the Ethernet fields to a string
     std::string serialize() const;
 
+    //! Serialize the Ethernet fields into `size` bytes of preallocated memory at `dest`
+    size_t serialize_into(char *dest, const size_t size) const;
+
     //! Return a string containing a header in human-readable format
     std::string to_string() const;
 };
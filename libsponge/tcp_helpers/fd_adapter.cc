@@ -7,7 +7,11 @@
 using namespace std;
 
 //! \details This function first attempts to parse a TCP segment from the next UDP
-//! payload recv()d from the socket.
+//! payload received from the socket. Datagrams are received in batches with
+//! UDPSocket::recv_batch; the socket is only read again once the previous batch
+//! has been consumed (see buffered_reads()). With FdAdapterConfig::udp_segmentation_offload,
+//! the kernel may coalesce a train of datagrams into one buffer (UDP_GRO); each wire datagram
+//! is then sliced out of that buffer in turn without copying.
 //!
 //! If this succeeds, it then checks that the received segment is related to the
 //! current connection. When a TCP connection has been established, this means
@@ -19,16 +23,33 @@ using namespace std;
 //! the result that future outgoing segments go to the sender of the SYN segment.
 //! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
 optional<TCPSegment> TCPOverUDPSocketAdapter::read() {
-    auto datagram = _sock.recv();
+    if (_rx_next == _rx_batch.size()) {
+        _sock.recv_batch(_rx_batch, BATCH_SIZE);
+        _rx_next = 0;
+        if (_rx_batch.empty()) {
+            return {};
+        }
+    }
+
+    auto &coalesced = _rx_batch[_rx_next];
+    UDPSocket::received_buffer datagram{coalesced.source_address, coalesced.payload, 0};
+    if (coalesced.segment_size > 0 and coalesced.payload.size() > coalesced.segment_size) {
+        // slice the first wire datagram off the GRO train; the rest stays queued
+        datagram.payload.remove_suffix(coalesced.payload.size() - coalesced.segment_size);
+        coalesced.payload.remove_prefix(coalesced.segment_size);
+    } else {
+        _rx_next++;
+    }
 
     // is it for us?
     if (not listening() and (datagram.source_address != config().destination)) {
         return {};
     }
 
-    // is the payload a valid TCP segment?
+    // is the payload a valid TCP segment? Once connected, the payload checksum is verified by the
+    // TCPReceiver while it copies the payload out, rather than in a separate pass here.
     TCPSegment seg;
-    if (ParseResult::NoError != seg.parse(move(datagram.payload), 0)) {
+    if (ParseResult::NoError != seg.parse(move(datagram.payload), 0, not listening())) {
         return {};
     }
 
@@ -45,12 +66,45 @@ optional<TCPSegment> TCPOverUDPSocketAdapter::read() {
     return seg;
 }
 
+//! \details UDP_GRO is turned on here, before the connection starts, so that every datagram of the
+//! connection can be coalesced. (It is never turned off again: read() handles either kind of buffer.)
+void TCPOverUDPSocketAdapter::set_config(const FdAdapterConfig &cfg) {
+    FdAdapterBase::set_config(cfg);
+    if (cfg.udp_segmentation_offload) {
+        _sock.set_gro();
+    }
+}
+
 //! Serialize a TCP segment and send it as the payload of a UDP datagram.
 //! \param[in] seg is the TCP segment to write
+//! \details While corked, the serialized segment is queued and sent by the next uncork()
+//! (or as soon as a full batch has accumulated).
 void TCPOverUDPSocketAdapter::write(TCPSegment &seg) {
     seg.header().sport = config().source.port();
     seg.header().dport = config().destination.port();
-    _sock.sendto(config().destination, seg.serialize(0));
+    if (not _corked) {
+        _sock.sendto(config().destination, seg.serialize(0));
+        return;
+    }
+
+    _tx_batch.push_back(seg.serialize(0));
+    if (_tx_batch.size() >= BATCH_SIZE) {
+        _flush();
+    }
+}
+
+void TCPOverUDPSocketAdapter::uncork() {
+    _corked = false;
+    _flush();
+}
+
+void TCPOverUDPSocketAdapter::_flush() {
+    if (_tx_batch.empty()) {
+        return;
+    }
+    const vector<BufferViewList> payloads(_tx_batch.begin(), _tx_batch.end());
+    _sock.send_batch(config().destination, payloads, config().udp_segmentation_offload);
+    _tx_batch.clear();
 }
 
 //! Specialize LossyFdAdapter to TCPOverUDPSocketAdapter
@@ -10,6 +10,7 @@
 
 #include <optional>
 #include <utility>
+#include <vector>
 
 //! \brief Basic functionality for file descriptor adaptors
 //! \details See TCPOverUDPSocketAdapter and TCPOverIPv4OverTunFdAdapter for more information.
@@ -38,25 +39,64 @@ class FdAdapterBase {
     //! \returns a mutable reference
     FdAdapterConfig &config_mut() { return _cfg; }
 
+    //! \brief Replace the configuration
+    //! \details Adapters that set up their file descriptor according to the configuration do so here.
+    void set_config(const FdAdapterConfig &cfg) { _cfg = cfg; }
+
     //! Called periodically when time elapses
     void tick(const size_t) {}
+
+    //! \brief Number of segments already received from the kernel but not yet returned by read()
+    //! \details An adapter that reads in batches returns nonzero here so that the caller keeps calling
+    //! read() even though the underlying file descriptor may no longer be readable.
+    size_t buffered_reads() const { return 0; }
+
+    //! \brief Start holding back written segments so that they can be sent together
+    void cork() {}
+
+    //! \brief Send any segments held back since cork()
+    void uncork() {}
 };
 
 //! \brief A FD adaptor that reads and writes TCP segments in UDP payloads
 class TCPOverUDPSocketAdapter : public FdAdapterBase {
   private:
+    //! Most datagrams moved by a single recvmmsg() or sendmmsg()
+    static constexpr size_t BATCH_SIZE = 32;
+
     UDPSocket _sock;
 
+    std::vector<UDPSocket::received_buffer> _rx_batch{};  //!< datagrams from the last recv_batch()
+    size_t _rx_next{0};                                   //!< index of the next datagram in `_rx_batch` to parse
+
+    std::vector<BufferList> _tx_batch{};  //!< segments written while corked
+    bool _corked{false};                  //!< hold back writes until uncork()?
+
+    //! Send the segments held in `_tx_batch` with sendmmsg()
+    void _flush();
+
   public:
     //! Construct from a UDPSocket sliced into a FileDescriptor
     explicit TCPOverUDPSocketAdapter(UDPSocket &&sock) : _sock(std::move(sock)) {}
 
+    //! Replace the configuration, turning on UDP_GRO for the socket if it asks for segmentation offload
+    void set_config(const FdAdapterConfig &cfg);
+
     //! Attempts to read and return a TCP segment related to the current connection from a UDP payload
     std::optional<TCPSegment> read();
 
     //! Writes a TCP segment into a UDP payload
     void write(TCPSegment &seg);
 
+    //! Datagrams received by the last recv_batch() that read() has not yet returned
+    size_t buffered_reads() const { return _rx_batch.size() - _rx_next; }
+
+    //! Hold back writes until uncork(), then send them with one sendmmsg()
+    void cork() { _corked = true; }
+
+    //! Send everything written since cork()
+    void uncork();
+
     //! Access the underlying UDP socket
     operator UDPSocket &() { return _sock; }
 
@@ -3,20 +3,28 @@
 #include "parser.hh"
 #include "util.hh"
 
+#include <cstring>
 #include <stdexcept>
 #include <string>
+#include <utility>
 
 using namespace std;
 
 ParseResult IPv4Datagram::parse(const Buffer buffer) {
     NetParser p{buffer};
-    _header.parse(p);
+    const ParseResult header_result = _header.parse(p);
     _payload = p.buffer();
+    _checksum_current = false;
 
     if (_payload.size() != _header.payload_length()) {
         return ParseResult::PacketTooShort;
     }
 
+    // the checksum stays usable only if it was verified and serialize() would reproduce the same header
+    // (which it does not when there are options, since those are written back as zeros)
+    _checksum_current = header_result == ParseResult::NoError and _header.hlen * 4 == IPv4Header::LENGTH and
+                        not p.error();
+
     return p.get_error();
 }
 
@@ -25,17 +33,99 @@ BufferList IPv4Datagram::serialize() const {
         throw runtime_error("IPv4Datagram::serialize: payload is wrong size");
     }
 
-    IPv4Header header_out = _header;
-    header_out.cksum = 0;
-    const string header_zero_checksum = header_out.serialize();
+    // write the header straight into the payload's headroom (when there is room, the datagram stays contiguous),
+    // but check the header first, so that a malformed one does not use up the headroom
+    const size_t header_len = _header.serialized_length();
+    BufferList ret{_payload};
+    char *const header_out = ret.prepend(header_len);
+    if (_checksum_current) {
+        _header.serialize_into(header_out, header_len);
+        return ret;
+    }
+
+    IPv4Header header_zero_checksum = _header;
+    header_zero_checksum.cksum = 0;
+    header_zero_checksum.serialize_into(header_out, header_len);
 
-    // calculate checksum -- taken over header only
+    // calculate checksum -- taken over header only -- and patch it into place
     InternetChecksum check;
-    check.add(header_zero_checksum);
-    header_out.cksum = check.value();
+    check.add({header_out, header_len});
+    NetUnparser::u16(header_out, IPv4Header::CKSUM_OFFSET, check.value());
+    return ret;
+}
+
+//! \details TTL shares a 16-bit header word with the protocol number; the checksum is adjusted for
+//! the change to that one word ([RFC 1624](\ref rfc::rfc1624)).
+void IPv4Datagram::decrement_ttl() {
+    const uint16_t old_word = (_header.ttl << 8) | _header.proto;
+    _header.ttl--;
+    const uint16_t new_word = (_header.ttl << 8) | _header.proto;
+    _header.cksum = InternetChecksum::adjust(_header.cksum, old_word, new_word);
+}
 
-    BufferList ret;
-    ret.append(header_out.serialize());
-    ret.append(_payload);
+//! \details Applies the same checks as IPv4Datagram::parse() and IPv4Header::parse(), and in addition rejects a
+//! datagram whose header checksum is bad, since a router must not forward one ([RFC 1812](\ref rfc::rfc1812)).
+ParseResult IPv4DatagramView::parse(const Buffer buffer) {
+    _header = Buffer{};
+    _payload = Buffer{};
+
+    const string_view bytes = buffer.str();
+    if (bytes.size() < IPv4Header::LENGTH) {
+        return ParseResult::PacketTooShort;
+    }
+
+    const uint8_t first_byte = NetParser::u8(bytes, 0);
+    const size_t header_len = 4 * (first_byte & 0x0f);
+    if (bytes.size() < header_len) {
+        return ParseResult::PacketTooShort;
+    }
+    if (first_byte >> 4 != 4) {
+        return ParseResult::WrongIPVersion;
+    }
+    if (header_len < IPv4Header::LENGTH) {
+        return ParseResult::HeaderTooShort;
+    }
+    if (bytes.size() != NetParser::u16(bytes, 2)) {
+        return ParseResult::TruncatedPacket;
+    }
+
+    InternetChecksum check;
+    check.add(bytes.substr(0, header_len));
+    if (check.value()) {
+        return ParseResult::BadChecksum;
+    }
+
+    _header = buffer;
+    _header.remove_suffix(bytes.size() - header_len);
+    if (bytes.size() > header_len) {
+        _payload = buffer;
+        _payload.remove_prefix(header_len);
+    }
+    return ParseResult::NoError;
+}
+
+BufferList IPv4DatagramView::serialize() const {
+    BufferList ret{_header};
+    if (_payload.size() > 0) {
+        ret.append(_payload);
+    }
     return ret;
 }
+
+//! \details The received header may be shared with other copies of the frame, so it is never written in
+//! place. The copy has headroom for the link-layer header, and the checksum is adjusted for the one
+//! changed 16-bit word ([RFC 1624](\ref rfc::rfc1624)), as in IPv4Datagram::decrement_ttl().
+void IPv4DatagramView::decrement_ttl() {
+    Buffer header = Buffer::allocate(_header.size(), Buffer::DEFAULT_HEADROOM);
+    char *const dest = header.mutable_data();
+    memcpy(dest, _header.str().data(), _header.size());
+
+    const uint8_t proto = NetParser::u8(_header, 9);
+    const uint16_t old_word = (ttl() << 8) | proto;
+    const uint16_t new_word = ((ttl() - 1) << 8) | proto;
+    NetUnparser::u8(dest, 8, ttl() - 1);
+    NetUnparser::u16(dest,
+                     IPv4Header::CKSUM_OFFSET,
+                     InternetChecksum::adjust(NetParser::u16(_header, IPv4Header::CKSUM_OFFSET), old_word, new_word));
+    _header = move(header);
+}
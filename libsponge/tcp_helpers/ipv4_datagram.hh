@@ -9,18 +9,27 @@ class IPv4Datagram {
   private:
     IPv4Header _header{};
     BufferList _payload{};
+    bool _checksum_current{false};  //!< does `_header.cksum` already match the header (e.g. straight after parse())?
 
   public:
     //! \brief Parse the segment from a string
     ParseResult parse(const Buffer buffer);
 
     //! \brief Serialize the segment to a string
+    //! \note The header checksum is only recomputed if the header may have changed since parse()
     BufferList serialize() const;
 
+    //! \brief Decrement the TTL, patching the header checksum instead of recomputing it
+    void decrement_ttl();
+
     //! \name Accessors
     //!@{
     const IPv4Header &header() const { return _header; }
-    IPv4Header &header() { return _header; }
+    //! \note Assumes the caller modifies the header, so serialize() will recompute the checksum
+    IPv4Header &header() {
+        _checksum_current = false;
+        return _header;
+    }
 
     const BufferList &payload() const { return _payload; }
     BufferList &payload() { return _payload; }
@@ -29,4 +38,31 @@ class IPv4Datagram {
 
 using InternetDatagram = IPv4Datagram;
 
+//! \brief A received [IPv4](\ref rfc::rfc791) datagram, decoded only as far as forwarding needs
+//! \details parse() validates the header in place without building an IPv4Header, and the accessors
+//! read single fields straight from the received bytes. decrement_ttl() copies just the header (patching
+//! the TTL and checksum), so serialize() returns the new header followed by the untouched payload.
+class IPv4DatagramView {
+  private:
+    Buffer _header{};
+    Buffer _payload{};
+
+  public:
+    //! \brief Check that the buffer holds a whole datagram with a valid header, without decoding it
+    ParseResult parse(const Buffer buffer);
+
+    //! \brief Serialize the datagram (the header as received, or as patched by decrement_ttl())
+    BufferList serialize() const;
+
+    //! \brief Decrement the TTL in a private copy of the header, patching the header checksum
+    void decrement_ttl();
+
+    //! \name Header fields, read on demand
+    //!@{
+    uint8_t ttl() const { return NetParser::u8(_header, 8); }
+    uint32_t src() const { return NetParser::u32(_header, 12); }
+    uint32_t dst() const { return NetParser::u32(_header, 16); }
+    //!@}
+};
+
 #endif  // SPONGE_LIBSPONGE_IPV4_DATAGRAM_HH
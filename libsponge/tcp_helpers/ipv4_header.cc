@@ -3,6 +3,7 @@
 #include "util.hh"
 
 #include <arpa/inet.h>
+#include <cstring>
 #include <iomanip>
 #include <sstream>
 
@@ -23,28 +24,31 @@ using namespace std;
 ParseResult IPv4Header::parse(NetParser &p) {
     Buffer original_serialized_version = p.buffer();
 
+    // check the length once, then decode the whole fixed part in one step
     const size_t data_size = p.buffer().size();
-    if (data_size < IPv4Header::LENGTH) {
+    const string_view fixed = p.peek(IPv4Header::LENGTH);
+    if (fixed.empty()) {
         return ParseResult::PacketTooShort;
     }
 
-    const uint8_t first_byte = p.u8();
-    ver = first_byte >> 4;     // version
-    hlen = first_byte & 0x0f;  // header length
-    tos = p.u8();              // type of service
-    len = p.u16();             // length
-    id = p.u16();              // id
+    const uint8_t first_byte = NetParser::u8(fixed, 0);
+    ver = first_byte >> 4;           // version
+    hlen = first_byte & 0x0f;        // header length
+    tos = NetParser::u8(fixed, 1);   // type of service
+    len = NetParser::u16(fixed, 2);  // length
+    id = NetParser::u16(fixed, 4);   // id
 
-    const uint16_t fo_val = p.u16();
+    const uint16_t fo_val = NetParser::u16(fixed, 6);
     df = static_cast<bool>(fo_val & 0x4000);  // don't fragment
     mf = static_cast<bool>(fo_val & 0x2000);  // more fragments
     offset = fo_val & 0x1fff;                 // offset
 
-    ttl = p.u8();     // ttl
-    proto = p.u8();   // proto
-    cksum = p.u16();  // checksum
-    src = p.u32();    // source address
-    dst = p.u32();    // destination address
+    ttl = NetParser::u8(fixed, 8);      // ttl
+    proto = NetParser::u8(fixed, 9);    // proto
+    cksum = NetParser::u16(fixed, 10);  // checksum
+    src = NetParser::u32(fixed, 12);    // source address
+    dst = NetParser::u32(fixed, 16);    // destination address
+    p.remove_prefix(IPv4Header::LENGTH);
 
     if (data_size < 4 * hlen) {
         return ParseResult::PacketTooShort;
@@ -74,41 +78,55 @@ ParseResult IPv4Header::parse(NetParser &p) {
     return ParseResult::NoError;
 }
 
-//! Serialize the IPv4Header to a string (does not recompute the checksum)
-string IPv4Header::serialize() const {
-    // sanity checks
-    if (ver != 4) {
-        throw runtime_error("wrong IP version");
+//! \param[out] dest receives the header
+//! \param[in] size is the room available at `dest`, checked once before anything is written
+//! \returns the number of bytes written (`4 * hlen`); options are written as zeros
+size_t IPv4Header::serialize_into(char *dest, const size_t size) const {
+    const size_t header_len = serialized_length();
+    if (size < header_len) {
+        throw runtime_error("no room to serialize IP header");
     }
-    if (4 * hlen < IPv4Header::LENGTH) {
-        throw runtime_error("IP header too short");
-    }
-
-    string ret;
-    ret.reserve(4 * hlen);
 
     const uint8_t first_byte = (ver << 4) | (hlen & 0xf);
-    NetUnparser::u8(ret, first_byte);  // version and header length
-    NetUnparser::u8(ret, tos);         // type of service
-    NetUnparser::u16(ret, len);        // length
-    NetUnparser::u16(ret, id);         // id
+    NetUnparser::u8(dest, 0, first_byte);  // version and header length
+    NetUnparser::u8(dest, 1, tos);         // type of service
+    NetUnparser::u16(dest, 2, len);        // length
+    NetUnparser::u16(dest, 4, id);         // id
 
     const uint16_t fo_val = (df ? 0x4000 : 0) | (mf ? 0x2000 : 0) | (offset & 0x1fff);
-    NetUnparser::u16(ret, fo_val);  // flags and offset
+    NetUnparser::u16(dest, 6, fo_val);  // flags and offset
 
-    NetUnparser::u8(ret, ttl);    // time to live
-    NetUnparser::u8(ret, proto);  // protocol number
+    NetUnparser::u8(dest, 8, ttl);    // time to live
+    NetUnparser::u8(dest, 9, proto);  // protocol number
 
-    NetUnparser::u16(ret, cksum);  // checksum
+    NetUnparser::u16(dest, CKSUM_OFFSET, cksum);  // checksum
 
-    NetUnparser::u32(ret, src);  // src address
-    NetUnparser::u32(ret, dst);  // dst address
+    NetUnparser::u32(dest, 12, src);  // src address
+    NetUnparser::u32(dest, 16, dst);  // dst address
 
-    ret.resize(4 * hlen);  // expand header to advertised size
+    memset(dest + LENGTH, 0, header_len - LENGTH);  // expand header to advertised size
+
+    return header_len;
+}
 
+//! Serialize the IPv4Header to a string (does not recompute the checksum)
+string IPv4Header::serialize() const {
+    string ret(serialized_length(), 0);
+    serialize_into(ret.data(), ret.size());
     return ret;
 }
 
+size_t IPv4Header::serialized_length() const {
+    // sanity checks
+    if (ver != 4) {
+        throw runtime_error("wrong IP version");
+    }
+    if (4 * hlen < IPv4Header::LENGTH) {
+        throw runtime_error("IP header too short");
+    }
+    return 4 * hlen;
+}
+
 uint16_t IPv4Header::payload_length() const { return len - 4 * hlen; }
 
 //! \details This value is needed when computing the checksum of an encapsulated TCP segment.
@@ -7,6 +7,7 @@
 //! \note IP options are not supported
 struct IPv4Header {
     static constexpr size_t LENGTH = 20;         //!< [IPv4](\ref rfc::rfc791) header length, not including options
+    static constexpr size_t CKSUM_OFFSET = 10;   //!< offset of the checksum field within the header
     static constexpr uint8_t DEFAULT_TTL = 128;  //!< A reasonable default TTL value
     static constexpr uint8_t PROTO_TCP = 6;      //!< Protocol number for [tcp](\ref rfc::rfc793)
 
@@ -52,6 +53,12 @@ struct IPv4Header {
     //! Serialize the IP fields
     std::string serialize() const;
 
+    //! Serialize the IP fields into `size` bytes of preallocated memory at `dest`
+    size_t serialize_into(char *dest, const size_t size) const;
+
+    //! Number of bytes serialize_into() writes (`4 * hlen`), after checking that the header can be serialized
+    size_t serialized_length() const;
+
     //! Length of the payload
     uint16_t payload_length() const;
 
@@ -0,0 +1,63 @@
+#include "loopback_adapter.hh"
+
+#include "ipv4_datagram.hh"
+
+#include <cstring>
+
+using namespace std;
+
+pair<TCPOverIPv4OverLoopbackAdapter, TCPOverIPv4OverLoopbackAdapter> TCPOverIPv4OverLoopbackAdapter::make_pair(
+    const size_t capacity) {
+    auto a_to_b = make_shared<Link>(capacity);
+    auto b_to_a = make_shared<Link>(capacity);
+    return {TCPOverIPv4OverLoopbackAdapter(b_to_a, a_to_b), TCPOverIPv4OverLoopbackAdapter(a_to_b, b_to_a)};
+}
+
+//! \details Once the inbound ring is empty, the doorbell is reset, so that it wakes the event loop only
+//! for datagrams written after this. (A datagram written just before the reset is still counted by
+//! buffered_reads(), so it is not missed.)
+optional<TCPSegment> TCPOverIPv4OverLoopbackAdapter::read() {
+    Buffer raw_datagram;
+    const bool popped = _inbound->datagrams.pop(raw_datagram);
+    if (_inbound->datagrams.size() == 0) {
+        _inbound->doorbell.clear();
+    }
+    if (not popped) {
+        return {};
+    }
+
+    InternetDatagram ip_dgram;
+    if (ip_dgram.parse(move(raw_datagram)) != ParseResult::NoError) {
+        return {};
+    }
+    return unwrap_tcp_in_ip(ip_dgram);
+}
+
+//! \param[in] seg the TCPSegment to send
+void TCPOverIPv4OverLoopbackAdapter::write(TCPSegment &seg) {
+    // serialize the datagram into one Buffer, as it would be on the wire
+    const BufferList serialized = wrap_tcp_in_ip(seg).serialize();
+    Buffer raw_datagram = Buffer::allocate(serialized.size());
+    char *dest = raw_datagram.mutable_data();
+    for (const iovec &piece : BufferViewList(serialized).as_iovecs()) {
+        memcpy(dest, piece.iov_base, piece.iov_len);
+        dest += piece.iov_len;
+    }
+
+    if (not _outbound->datagrams.push(move(raw_datagram))) {
+        _dropped++;
+        return;
+    }
+    _pending = true;
+    if (not _corked) {
+        uncork();
+    }
+}
+
+void TCPOverIPv4OverLoopbackAdapter::uncork() {
+    _corked = false;
+    if (_pending) {
+        _pending = false;
+        _outbound->doorbell.notify();
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef SPONGE_LIBSPONGE_LOOPBACK_ADAPTER_HH
+#define SPONGE_LIBSPONGE_LOOPBACK_ADAPTER_HH
+
+#include "buffer.hh"
+#include "event_fd.hh"
+#include "spsc_ring.hh"
+#include "tcp_over_ip.hh"
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <utility>
+
+//! \brief A FD adapter for serialized IPv4 datagrams, passed in memory to a peer adapter in the same process
+//! \details make_pair() connects two adapters with a lock-free ring in each direction, so that two
+//! TCPSpongeSockets (each with its own TCP thread) can talk without a kernel network device or any
+//! privileges. Every segment is still wrapped in an IPv4 datagram, serialized into a Buffer, and parsed
+//! again on the other side, as it would be on a TUN device. A datagram that finds the ring full is
+//! dropped, like a packet that finds a NIC queue full. The receiving side is woken with an eventfd, which
+//! is rung once per batch of datagrams written while corked.
+class TCPOverIPv4OverLoopbackAdapter : public TCPOverIPv4Adapter {
+  public:
+    //! Default number of datagrams each direction can hold
+    static constexpr size_t DEFAULT_CAPACITY = 1024;
+
+  private:
+    //! One direction of the pair: datagrams in flight, and the doorbell of the side receiving them
+    struct Link {
+        SpscRing<Buffer> datagrams;
+        EventFD doorbell{};
+
+        explicit Link(const size_t capacity) : datagrams(capacity) {}
+    };
+
+    std::shared_ptr<Link> _inbound;   //!< datagrams from the peer
+    std::shared_ptr<Link> _outbound;  //!< datagrams to the peer
+
+    bool _corked{false};   //!< hold off ringing the peer's doorbell until uncork()?
+    bool _pending{false};  //!< datagrams written since the peer's doorbell was last rung?
+    size_t _dropped{0};    //!< datagrams dropped because `_outbound` was full
+
+    TCPOverIPv4OverLoopbackAdapter(std::shared_ptr<Link> inbound, std::shared_ptr<Link> outbound)
+        : _inbound(std::move(inbound)), _outbound(std::move(outbound)) {}
+
+  public:
+    //! \brief Create two adapters connected to each other
+    //! \param[in] capacity is the number of datagrams each direction can hold (a power of two)
+    static std::pair<TCPOverIPv4OverLoopbackAdapter, TCPOverIPv4OverLoopbackAdapter> make_pair(
+        const size_t capacity = DEFAULT_CAPACITY);
+
+    //! Attempts to take and parse an IPv4 datagram containing a TCP segment related to the current connection
+    std::optional<TCPSegment> read();
+
+    //! Serializes a TCP segment in an IPv4 datagram and passes it to the peer
+    void write(TCPSegment &seg);
+
+    //! Datagrams from the peer that read() has not yet returned
+    size_t buffered_reads() const { return _inbound->datagrams.size(); }
+
+    //! Hold off waking the peer until uncork()
+    void cork() { _corked = true; }
+
+    //! Wake the peer for everything written since cork()
+    void uncork();
+
+    //! Datagrams dropped because the peer had not yet taken the earlier ones
+    size_t dropped() const { return _dropped; }
+
+    //! Access the doorbell that the peer rings when it writes
+    operator EventFD &() { return _inbound->doorbell; }
+
+    //! Access the doorbell that the peer rings when it writes
+    operator const EventFD &() const { return _inbound->doorbell; }
+};
+
+#endif  // SPONGE_LIBSPONGE_LOOPBACK_ADAPTER_HH
@@ -65,7 +65,13 @@ class LossyFdAdapter {
     FdAdapterConfig &config_mut() { return _adapter.config_mut(); }      //!< FdAdapterBase::config_mut passthrough
     void tick(const size_t ms_since_last_tick) {
         _adapter.tick(ms_since_last_tick);
-    }  //!< FdAdapterBase::tick passthrough
+    }                                                                    //!< FdAdapterBase::tick passthrough
+    size_t buffered_reads() const { return _adapter.buffered_reads(); }  //!< FdAdapterBase::buffered_reads passthrough
+    void cork() { _adapter.cork(); }                                     //!< FdAdapterBase::cork passthrough
+    void uncork() { _adapter.uncork(); }                                 //!< FdAdapterBase::uncork passthrough
+
+    //! FdAdapterBase::set_config passthrough
+    void set_config(const FdAdapterConfig &cfg) { _adapter.set_config(cfg); }
     //!@}
 };
 
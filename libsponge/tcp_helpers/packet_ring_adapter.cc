@@ -0,0 +1,69 @@
+#include "packet_ring_adapter.hh"
+
+#include "ethernet_frame.hh"
+
+#include <utility>
+
+using namespace std;
+
+//! \param[in] ring Packet socket that will be owned by the adapter
+//! \param[in] eth_address Ethernet address (local address) of the adapter
+//! \param[in] ip_address IP address (local address) of the adapter
+//! \param[in] next_hop IP address of the next hop (typically a router or default gateway)
+TCPOverIPv4OverPacketRingAdapter::TCPOverIPv4OverPacketRingAdapter(PacketRingFD &&ring,
+                                                                   const EthernetAddress &eth_address,
+                                                                   const Address &ip_address,
+                                                                   const Address &next_hop)
+    : _ring(move(ring)), _interface(eth_address, ip_address), _next_hop(next_hop) {}
+
+optional<TCPSegment> TCPOverIPv4OverPacketRingAdapter::read() {
+    // Take the next frame from the receive ring, without copying it
+    optional<PacketRingFD::received_frame> raw_frame = _ring.read_frame();
+    if (not raw_frame.has_value()) {
+        return {};
+    }
+    EthernetFrame frame;
+    if (frame.parse(move(raw_frame->frame)) != ParseResult::NoError) {
+        return {};
+    }
+
+    // Give the frame to the NetworkInterface. Get back an Internet datagram if frame was carrying one.
+    optional<InternetDatagram> ip_dgram = _interface.recv_frame(frame);
+
+    // The incoming frame may have caused the NetworkInterface to send a frame.
+    send_pending();
+
+    // Try to interpret IPv4 datagram as TCP
+    if (ip_dgram) {
+        return unwrap_tcp_in_ip(ip_dgram.value(), raw_frame->checksum_verified);
+    }
+    return {};
+}
+
+//! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
+void TCPOverIPv4OverPacketRingAdapter::tick(const size_t ms_since_last_tick) {
+    _interface.tick(ms_since_last_tick);
+    send_pending();
+}
+
+//! \param[in] seg the TCPSegment to send
+void TCPOverIPv4OverPacketRingAdapter::write(TCPSegment &seg) {
+    _interface.send_datagram(wrap_tcp_in_ip(seg), _next_hop);
+    send_pending();
+}
+
+void TCPOverIPv4OverPacketRingAdapter::uncork() {
+    _corked = false;
+    _ring.flush();
+}
+
+void TCPOverIPv4OverPacketRingAdapter::send_pending() {
+    auto &frames = _interface.frames_out();
+    while (not frames.empty()) {
+        _ring.write_frame(frames.front().serialize());
+        frames.pop();
+    }
+    if (not _corked) {
+        _ring.flush();
+    }
+}
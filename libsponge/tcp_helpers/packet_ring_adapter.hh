@@ -0,0 +1,59 @@
+#ifndef SPONGE_LIBSPONGE_PACKET_RING_ADAPTER_HH
+#define SPONGE_LIBSPONGE_PACKET_RING_ADAPTER_HH
+
+#include "ethernet_header.hh"
+#include "network_interface.hh"
+#include "packet_ring.hh"
+#include "tcp_over_ip.hh"
+
+#include <optional>
+
+//! \brief A FD adapter for IPv4 datagrams in Ethernet frames, moved through the memory-mapped rings of a
+//! packet socket on an existing network interface (for example, one end of a veth pair)
+//! \details Received frames are parsed in place in the receive ring. Frames written while corked are
+//! queued in the transmit ring and sent with one system call by uncork().
+class TCPOverIPv4OverPacketRingAdapter : public TCPOverIPv4Adapter {
+  private:
+    PacketRingFD _ring;  //!< Packet socket with its rings
+
+    NetworkInterface _interface;  //!< NIC abstraction
+
+    Address _next_hop;  //!< IP address of the next hop
+
+    bool _corked{false};  //!< hold back frames in the transmit ring until uncork()?
+
+    void send_pending();  //!< Copies any pending Ethernet frames into the transmit ring
+
+  public:
+    //! Construct from a PacketRingFD
+    explicit TCPOverIPv4OverPacketRingAdapter(PacketRingFD &&ring,
+                                              const EthernetAddress &eth_address,
+                                              const Address &ip_address,
+                                              const Address &next_hop);
+
+    //! Attempts to read and parse an Ethernet frame containing an IPv4 datagram that contains a TCP segment
+    std::optional<TCPSegment> read();
+
+    //! Sends a TCP segment (in an IPv4 datagram, in an Ethernet frame).
+    void write(TCPSegment &seg);
+
+    //! Called periodically when time elapses
+    void tick(const size_t ms_since_last_tick);
+
+    //! Frames the kernel has already placed in the receive ring
+    size_t buffered_reads() const { return _ring.buffered_frames(); }
+
+    //! Hold back frames in the transmit ring until uncork()
+    void cork() { _corked = true; }
+
+    //! Send every frame written since cork()
+    void uncork();
+
+    //! Access the underlying packet socket
+    operator PacketRingFD &() { return _ring; }
+
+    //! Access the underlying packet socket
+    operator const PacketRingFD &() const { return _ring; }
+};
+
+#endif  // SPONGE_LIBSPONGE_PACKET_RING_ADAPTER_HH
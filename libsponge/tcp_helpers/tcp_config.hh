@@ -30,6 +30,8 @@ class FdAdapterConfig {
 
     uint16_t loss_rate_dn = 0;  //!< Downlink loss rate (for LossyFdAdapter)
     uint16_t loss_rate_up = 0;  //!< Uplink loss rate (for LossyFdAdapter)
+
+    bool udp_segmentation_offload = false;  //!< Use UDP GSO/GRO (for TCPOverUDPSocketAdapter)
 };
 
 #endif  // SPONGE_LIBSPONGE_TCP_CONFIG_HH
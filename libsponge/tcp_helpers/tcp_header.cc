@@ -1,9 +1,20 @@
 #include "tcp_header.hh"
 
+#include <cstring>
 #include <sstream>
 
 using namespace std;
 
+//! Unpack the flags byte of a TCP header
+static void parse_flags(TCPHeader &header, const uint8_t fl_b) {
+    header.urg = static_cast<bool>(fl_b & 0b0010'0000);  // binary literals and ' digit separator since C++14!!!
+    header.ack = static_cast<bool>(fl_b & 0b0001'0000);
+    header.psh = static_cast<bool>(fl_b & 0b0000'1000);
+    header.rst = static_cast<bool>(fl_b & 0b0000'0100);
+    header.syn = static_cast<bool>(fl_b & 0b0000'0010);
+    header.fin = static_cast<bool>(fl_b & 0b0000'0001);
+}
+
 //! \param[in,out] p is a NetParser from which the TCP fields will be extracted
 //! \returns a ParseResult indicating success or the reason for failure
 //! \details It is important to check for (at least) the following potential errors
@@ -14,24 +25,33 @@ using namespace std;
 //! - the header's `doff` field is shorter than the minimum allowed
 //! - there is less data in the header than the `doff` field claims
 //! - the checksum is bad
+//!
+//! The fixed part of the header is decoded in one step when it is all present. Otherwise the fields are
+//! read one at a time, so that a truncated header leaves exactly the same partial result as it always has.
 ParseResult TCPHeader::parse(NetParser &p) {
-    sport = p.u16();                 // source port
-    dport = p.u16();                 // destination port
-    seqno = WrappingInt32{p.u32()};  // sequence number
-    ackno = WrappingInt32{p.u32()};  // ack number
-    doff = p.u8() >> 4;              // data offset
-
-    const uint8_t fl_b = p.u8();                  // byte including flags
-    urg = static_cast<bool>(fl_b & 0b0010'0000);  // binary literals and ' digit separator since C++14!!!
-    ack = static_cast<bool>(fl_b & 0b0001'0000);
-    psh = static_cast<bool>(fl_b & 0b0000'1000);
-    rst = static_cast<bool>(fl_b & 0b0000'0100);
-    syn = static_cast<bool>(fl_b & 0b0000'0010);
-    fin = static_cast<bool>(fl_b & 0b0000'0001);
-
-    win = p.u16();    // window size
-    cksum = p.u16();  // checksum
-    uptr = p.u16();   // urgent pointer
+    const string_view fixed = p.peek(TCPHeader::LENGTH);
+    if (not fixed.empty() and not p.error()) {
+        sport = NetParser::u16(fixed, 0);                 // source port
+        dport = NetParser::u16(fixed, 2);                 // destination port
+        seqno = WrappingInt32{NetParser::u32(fixed, 4)};  // sequence number
+        ackno = WrappingInt32{NetParser::u32(fixed, 8)};  // ack number
+        doff = NetParser::u8(fixed, 12) >> 4;             // data offset
+        parse_flags(*this, NetParser::u8(fixed, 13));     // byte including flags
+        win = NetParser::u16(fixed, 14);                  // window size
+        cksum = NetParser::u16(fixed, 16);                // checksum
+        uptr = NetParser::u16(fixed, 18);                 // urgent pointer
+        p.remove_prefix(TCPHeader::LENGTH);
+    } else {
+        sport = p.u16();                 // source port
+        dport = p.u16();                 // destination port
+        seqno = WrappingInt32{p.u32()};  // sequence number
+        ackno = WrappingInt32{p.u32()};  // ack number
+        doff = p.u8() >> 4;              // data offset
+        parse_flags(*this, p.u8());      // byte including flags
+        win = p.u16();                   // window size
+        cksum = p.u16();                 // checksum
+        uptr = p.u16();                  // urgent pointer
+    }
 
     if (doff < 5) {
         return ParseResult::HeaderTooShort;
@@ -47,36 +67,50 @@ ParseResult TCPHeader::parse(NetParser &p) {
     return ParseResult::NoError;
 }
 
-//! Serialize the TCPHeader to a string (does not recompute the checksum)
-string TCPHeader::serialize() const {
-    // sanity check
-    if (doff < 5) {
-        throw runtime_error("TCP header too short");
+//! \param[out] dest receives the header
+//! \param[in] size is the room available at `dest`, checked once before anything is written
+//! \returns the number of bytes written (`4 * doff`); options are written as zeros
+size_t TCPHeader::serialize_into(char *dest, const size_t size) const {
+    const size_t len = serialized_length();
+    if (size < len) {
+        throw runtime_error("no room to serialize TCP header");
     }
 
-    string ret;
-    ret.reserve(4 * doff);
-
-    NetUnparser::u16(ret, sport);              // source port
-    NetUnparser::u16(ret, dport);              // destination port
-    NetUnparser::u32(ret, seqno.raw_value());  // sequence number
-    NetUnparser::u32(ret, ackno.raw_value());  // ack number
-    NetUnparser::u8(ret, doff << 4);           // data offset
+    NetUnparser::u16(dest, 0, sport);              // source port
+    NetUnparser::u16(dest, 2, dport);              // destination port
+    NetUnparser::u32(dest, 4, seqno.raw_value());  // sequence number
+    NetUnparser::u32(dest, 8, ackno.raw_value());  // ack number
+    NetUnparser::u8(dest, 12, doff << 4);          // data offset
 
     const uint8_t fl_b = (urg ? 0b0010'0000 : 0) | (ack ? 0b0001'0000 : 0) | (psh ? 0b0000'1000 : 0) |
                          (rst ? 0b0000'0100 : 0) | (syn ? 0b0000'0010 : 0) | (fin ? 0b0000'0001 : 0);
-    NetUnparser::u8(ret, fl_b);  // flags
-    NetUnparser::u16(ret, win);  // window size
+    NetUnparser::u8(dest, 13, fl_b);  // flags
+    NetUnparser::u16(dest, 14, win);  // window size
 
-    NetUnparser::u16(ret, cksum);  // checksum
+    NetUnparser::u16(dest, CKSUM_OFFSET, cksum);  // checksum
 
-    NetUnparser::u16(ret, uptr);  // urgent pointer
+    NetUnparser::u16(dest, 18, uptr);  // urgent pointer
 
-    ret.resize(4 * doff);  // expand header to advertised size
+    memset(dest + LENGTH, 0, len - LENGTH);  // expand header to advertised size
 
+    return len;
+}
+
+//! Serialize the TCPHeader to a string (does not recompute the checksum)
+string TCPHeader::serialize() const {
+    string ret(serialized_length(), 0);
+    serialize_into(ret.data(), ret.size());
     return ret;
 }
 
+size_t TCPHeader::serialized_length() const {
+    // sanity check
+    if (doff < 5) {
+        throw runtime_error("TCP header too short");
+    }
+    return 4 * doff;
+}
+
 //! \returns A string with the header's contents
 string TCPHeader::to_string() const {
     stringstream ss{};
@@ -7,7 +7,8 @@
 //! \brief [TCP](\ref rfc::rfc793) segment header
 //! \note TCP options are not supported
 struct TCPHeader {
-    static constexpr size_t LENGTH = 20;  //!< [TCP](\ref rfc::rfc793) header length, not including options
+    static constexpr size_t LENGTH = 20;       //!< [TCP](\ref rfc::rfc793) header length, not including options
+    static constexpr size_t CKSUM_OFFSET = 16;  //!< offset of the checksum field within the header
 
     //! \struct TCPHeader
     //! ~~~{.txt}
@@ -56,6 +57,12 @@ struct TCPHeader {
     //! Serialize the TCP fields
     std::string serialize() const;
 
+    //! Serialize the TCP fields into `size` bytes of preallocated memory at `dest`
+    size_t serialize_into(char *dest, const size_t size) const;
+
+    //! Number of bytes serialize_into() writes (`4 * doff`), after checking that the header can be serialized
+    size_t serialized_length() const;
+
     //! Return a string containing a header in human-readable format
     std::string to_string() const;
 
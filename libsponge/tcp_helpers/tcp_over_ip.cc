@@ -22,8 +22,11 @@ using namespace std;
 //! and the TCP segment read from the wire includes a SYN, this function clears the
 //! `_listen` flag and records the source and destination addresses and port numbers
 //! from the TCP header; it uses this information to filter future reads.
+//! \param[in] ip_dgram is the datagram to unwrap
+//! \param[in] checksum_verified skips the TCP checksum, which the kernel has vouched for (checksum offload)
 //! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
-optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram &ip_dgram) {
+optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram &ip_dgram,
+                                                          const bool checksum_verified) {
     // is the IPv4 datagram for us?
     // Note: it's valid to bind to address "0" (INADDR_ANY) and reply from actual address contacted
     if (not listening() and (ip_dgram.header().dst != config().source.ipv4_numeric())) {
@@ -40,9 +43,15 @@ optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram
         return {};
     }
 
-    // is the payload a valid TCP segment?
+    // is the payload a valid TCP segment? Once connected, the payload checksum is verified by the
+    // TCPReceiver while it copies the payload out, rather than in a separate pass here.
     TCPSegment tcp_seg;
-    if (ParseResult::NoError != tcp_seg.parse(ip_dgram.payload(), ip_dgram.header().pseudo_cksum())) {
+    if (checksum_verified) {
+        if (ParseResult::NoError != tcp_seg.parse_without_checksum(ip_dgram.payload())) {
+            return {};
+        }
+    } else if (ParseResult::NoError !=
+               tcp_seg.parse(ip_dgram.payload(), ip_dgram.header().pseudo_cksum(), not listening())) {
         return {};
     }
 
@@ -74,8 +83,7 @@ optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip(const InternetDatagram
 //! \param[in] seg is the TCP segment to convert
 InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip(TCPSegment &seg) {
     // set the port numbers in the TCP segment
-    seg.header().sport = config().source.port();
-    seg.header().dport = config().destination.port();
+    seg.set_ports(config().source.port(), config().destination.port());
 
     // create an Internet Datagram and set its addresses and length
     InternetDatagram ip_dgram;
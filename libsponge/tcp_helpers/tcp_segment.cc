@@ -3,43 +3,127 @@
 #include "parser.hh"
 #include "util.hh"
 
+#include <cstring>
 #include <variant>
 
 using namespace std;
 
 //! \param[in] buffer string/Buffer to be parsed
 //! \param[in] datagram_layer_checksum pseudo-checksum from the lower-layer protocol
-ParseResult TCPSegment::parse(const Buffer buffer, const uint32_t datagram_layer_checksum) {
+//! \param[in] defer_checksum leaves the payload unread: only the header is summed now, and the rest of the
+//! verification is done by copy_payload() as the payload is copied out (so its bytes are read once, not twice)
+ParseResult TCPSegment::parse(const Buffer buffer, const uint32_t datagram_layer_checksum, const bool defer_checksum) {
+    _checksum_pseudo.reset();
+    _pending_checksum.reset();
+
     InternetChecksum check(datagram_layer_checksum);
-    check.add(buffer);
-    if (check.value()) {
-        return ParseResult::BadChecksum;
+    if (not defer_checksum) {
+        check.add(buffer);
+        if (check.value()) {
+            return ParseResult::BadChecksum;
+        }
+    }
+
+    NetParser p{buffer};
+    _header.parse(p);
+    _payload = p.buffer();
+
+    if (defer_checksum) {
+        if (not p.error()) {
+            check.add(buffer.str().substr(0, buffer.size() - _payload.size()));
+            _pending_checksum = check;
+        }
+        return p.get_error();
     }
 
+    // options are written back as zeros, so only an option-free header keeps its checksum
+    if (not p.error() and _header.doff * 4 == TCPHeader::LENGTH) {
+        _checksum_pseudo = datagram_layer_checksum;
+    }
+    return p.get_error();
+}
+
+ParseResult TCPSegment::parse_without_checksum(const Buffer buffer) {
+    _checksum_pseudo.reset();
+    _pending_checksum.reset();
+
     NetParser p{buffer};
     _header.parse(p);
     _payload = p.buffer();
     return p.get_error();
 }
 
+//! \param[out] dest receives the payload; it must have room for `payload().size()` bytes
+bool TCPSegment::copy_payload(char *dest) const {
+    const iovec whole{dest, _payload.size()};
+    return copy_payload(&whole, 1);
+}
+
+bool TCPSegment::copy_payload(const iovec *dest, const size_t count, const size_t offset) const {
+    optional<InternetChecksum> check = _pending_checksum;
+    string_view rest = _payload.str();
+
+    const string_view skipped = rest.substr(0, offset);
+    if (check.has_value()) {
+        check->add(skipped);
+    }
+    rest.remove_prefix(skipped.size());
+
+    for (size_t i = 0; i < count and not rest.empty(); i++) {
+        const string_view piece = rest.substr(0, dest[i].iov_len);
+        char *const piece_dest = static_cast<char *>(dest[i].iov_base);
+        if (check.has_value()) {
+            check->copy_and_add(piece_dest, piece);
+        } else if (not piece.empty()) {
+            memcpy(piece_dest, piece.data(), piece.size());
+        }
+        rest.remove_prefix(piece.size());
+    }
+
+    if (not check.has_value()) {
+        return true;
+    }
+    check->add(rest);
+    return check->value() == 0;
+}
+
 size_t TCPSegment::length_in_sequence_space() const {
     return payload().str().size() + (header().syn ? 1 : 0) + (header().fin ? 1 : 0);
 }
 
 //! \param[in] datagram_layer_checksum pseudo-checksum from the lower-layer protocol
+//! \details If the segment is unchanged since it was parsed (apart from set_ports()), the existing checksum is
+//! adjusted for any change in the pseudo-header ([RFC 1624](\ref rfc::rfc1624)) instead of re-summing the segment.
 BufferList TCPSegment::serialize(const uint32_t datagram_layer_checksum) const {
-    TCPHeader header_out = _header;
-    header_out.cksum = 0;
+    // write the header straight into the payload's headroom, so the segment stays contiguous when there is room
+    // (but check the header first, so that a malformed one does not use up the headroom)
+    const size_t header_len = _header.serialized_length();
+    BufferList ret{_payload};
+    char *const header_out = ret.prepend(header_len);
+    if (_checksum_pseudo.has_value()) {
+        TCPHeader header_adjusted = _header;
+        header_adjusted.cksum =
+            InternetChecksum::adjust(_header.cksum, _checksum_pseudo.value(), datagram_layer_checksum);
+        header_adjusted.serialize_into(header_out, header_len);
+        return ret;
+    }
+
+    TCPHeader header_zero_checksum = _header;
+    header_zero_checksum.cksum = 0;
+    header_zero_checksum.serialize_into(header_out, header_len);
 
-    // calculate checksum -- taken over entire segment
+    // calculate checksum -- taken over entire segment -- and patch it into place
     InternetChecksum check(datagram_layer_checksum);
-    check.add(header_out.serialize());
+    check.add({header_out, header_len});
     check.add(_payload);
-    header_out.cksum = check.value();
-
-    BufferList ret;
-    ret.append(header_out.serialize());
-    ret.append(_payload);
+    NetUnparser::u16(header_out, TCPHeader::CKSUM_OFFSET, check.value());
 
     return ret;
 }
+
+void TCPSegment::set_ports(const uint16_t sport, const uint16_t dport) {
+    _header.cksum = InternetChecksum::adjust(
+        _header.cksum, uint32_t(_header.sport) + _header.dport, uint32_t(sport) + dport);
+    _header.sport = sport;
+    _header.dport = dport;
+}
@@ -3,8 +3,10 @@
 
 #include "buffer.hh"
 #include "tcp_header.hh"
+#include "util.hh"
 
 #include <cstdint>
+#include <optional>
 
 //! \brief [TCP](\ref rfc::rfc793) segment
 class TCPSegment {
@@ -12,20 +14,64 @@ class TCPSegment {
     TCPHeader _header{};
     Buffer _payload{};
 
+    //! The pseudo-header checksum that `_header.cksum` is valid for, while the checksum is current
+    std::optional<uint32_t> _checksum_pseudo{};
+
+    //! After a parse that deferred verification: the checksum so far, missing only the payload
+    std::optional<InternetChecksum> _pending_checksum{};
+
   public:
     //! \brief Parse the segment from a string
-    ParseResult parse(const Buffer buffer, const uint32_t datagram_layer_checksum = 0);
+    //! \param defer_checksum skips summing the payload; the checksum is verified later by copy_payload()
+    ParseResult parse(const Buffer buffer,
+                      const uint32_t datagram_layer_checksum = 0,
+                      const bool defer_checksum = false);
+
+    //! \brief Parse the segment without verifying its checksum, which the lower layer has vouched for
+    //! \details For a packet the kernel hands over with checksum offload, whose checksum field may hold only
+    //! the pseudo-header's sum (VIRTIO_NET_HDR_F_NEEDS_CSUM) or has been checked already
+    ParseResult parse_without_checksum(const Buffer buffer);
+
+    //! \brief Has the checksum still to be verified (by copy_payload())?
+    bool checksum_pending() const { return _pending_checksum.has_value(); }
+
+    //! \brief Copy the payload to `dest`, completing any deferred checksum verification in the same pass
+    //! \returns `false` if the checksum turned out to be bad, in which case the segment must be discarded
+    bool copy_payload(char *dest) const;
+
+    //! \brief Copy the payload, from byte `offset` on, into the `count` pieces at `dest` in turn (as far as
+    //! they reach), completing any deferred checksum verification in the same pass
+    //! \details Lets the payload go straight into a receive buffer that wraps around, such as
+    //! ByteStream::free_space(). Bytes that are not copied are still checksummed.
+    //! \returns `false` if the checksum turned out to be bad, in which case the segment must be discarded
+    bool copy_payload(const iovec *dest, const size_t count, const size_t offset = 0) const;
+
+    //! \brief Complete any deferred checksum verification without copying the payload
+    //! \returns `false` if the checksum turned out to be bad, in which case the segment must be discarded
+    bool verify_payload() const { return copy_payload(nullptr, 0); }
 
     //! \brief Serialize the segment to a string
+    //! \note The checksum is only recomputed in full if the segment may have changed since parse()
     BufferList serialize(const uint32_t datagram_layer_checksum = 0) const;
 
+    //! \brief Rewrite the port numbers, patching the checksum instead of invalidating it
+    void set_ports(const uint16_t sport, const uint16_t dport);
+
     //! \name Accessors
     //!@{
     const TCPHeader &header() const { return _header; }
-    TCPHeader &header() { return _header; }
+    //! \note Assumes the caller modifies the header, so serialize() will recompute the checksum
+    TCPHeader &header() {
+        _checksum_pseudo.reset();
+        return _header;
+    }
 
     const Buffer &payload() const { return _payload; }
-    Buffer &payload() { return _payload; }
+    //! \note Assumes the caller modifies the payload, so serialize() will recompute the checksum
+    Buffer &payload() {
+        _checksum_pseudo.reset();
+        return _payload;
+    }
     //!@}
 
     //! \brief Segment's length in sequence space
@@ -76,10 +76,13 @@ void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
     _eventloop.add_rule(_datagram_adapter,
                         Direction::In,
                         [&] {
-                            auto seg = _datagram_adapter.read();
-                            if (seg) {
-                                _tcp->segment_received(move(seg.value()));
-                            }
+                            // a batching adapter may hand back several segments per readable event
+                            do {
+                                auto seg = _datagram_adapter.read();
+                                if (seg) {
+                                    _tcp->segment_received(move(seg.value()));
+                                }
+                            } while (_datagram_adapter.buffered_reads() > 0);
 
                             // debugging output:
                             if (_thread_data.eof() and _tcp.value().bytes_in_flight() == 0 and not _fully_acked) {
@@ -154,10 +157,12 @@ void TCPSpongeSocket<AdaptT>::_initialize_TCP(const TCPConfig &config) {
     _eventloop.add_rule(_datagram_adapter,
                         Direction::Out,
                         [&] {
+                            _datagram_adapter.cork();
                             while (not _tcp->segments_out().empty()) {
                                 _datagram_adapter.write(_tcp->segments_out().front());
                                 _tcp->segments_out().pop();
                             }
+                            _datagram_adapter.uncork();
                         },
                         [&] { return not _tcp->segments_out().empty(); });
 }
@@ -210,7 +215,7 @@ void TCPSpongeSocket<AdaptT>::connect(const TCPConfig &c_tcp, const FdAdapterCon
 
     _initialize_TCP(c_tcp);
 
-    _datagram_adapter.config_mut() = c_ad;
+    _datagram_adapter.set_config(c_ad);
 
     cerr << "DEBUG: Connecting to " << c_ad.destination.to_string() << "...\n";
     _tcp->connect();
@@ -238,7 +243,7 @@ void TCPSpongeSocket<AdaptT>::listen_and_accept(const TCPConfig &c_tcp, const Fd
 
     _initialize_TCP(c_tcp);
 
-    _datagram_adapter.config_mut() = c_ad;
+    _datagram_adapter.set_config(c_ad);
     _datagram_adapter.set_listening(true);
 
     cerr << "DEBUG: Listening for incoming connection...\n";
@@ -279,13 +284,23 @@ template class TCPSpongeSocket<TCPOverIPv4OverTunFdAdapter>;
 //! Specialization of TCPSpongeSocket for TCPOverIPv4OverEthernetAdapter
 template class TCPSpongeSocket<TCPOverIPv4OverEthernetAdapter>;
 
+//! Specialization of TCPSpongeSocket for TCPOverIPv4OverPacketRingAdapter
+template class TCPSpongeSocket<TCPOverIPv4OverPacketRingAdapter>;
+
+//! Specialization of TCPSpongeSocket for TCPOverIPv4OverXDPAdapter
+template class TCPSpongeSocket<TCPOverIPv4OverXDPAdapter>;
+
+//! Specialization of TCPSpongeSocket for TCPOverIPv4OverLoopbackAdapter
+template class TCPSpongeSocket<TCPOverIPv4OverLoopbackAdapter>;
+
 //! Specialization of TCPSpongeSocket for LossyTCPOverUDPSocketAdapter
 template class TCPSpongeSocket<LossyTCPOverUDPSocketAdapter>;
 
 //! Specialization of TCPSpongeSocket for LossyTCPOverIPv4OverTunFdAdapter
 template class TCPSpongeSocket<LossyTCPOverIPv4OverTunFdAdapter>;
 
-CS144TCPSocket::CS144TCPSocket() : TCPOverIPv4SpongeSocket(TCPOverIPv4OverTunFdAdapter(TunFD("tun144"))) {}
+CS144TCPSocket::CS144TCPSocket()
+    : TCPOverIPv4SpongeSocket(TCPOverIPv4OverTunFdAdapter(TunDispatcher::open("tun144", true))) {}
 
 void CS144TCPSocket::connect(const Address &address) {
     TCPConfig tcp_config;
@@ -313,7 +328,7 @@ EthernetAddress random_private_ethernet_address() {
 }
 
 FullStackSocket::FullStackSocket()
-    : TCPOverIPv4OverEthernetSpongeSocket(TCPOverIPv4OverEthernetAdapter(TapFD("tap10"),
+    : TCPOverIPv4OverEthernetSpongeSocket(TCPOverIPv4OverEthernetAdapter(TunDispatcher::open("tap10", false),
                                                                          random_private_ethernet_address(),
                                                                          Address(LOCAL_TAP_IP_ADDRESS, "0"),
                                                                          Address(LOCAL_TAP_NEXT_HOP_ADDRESS, "0"))) {}
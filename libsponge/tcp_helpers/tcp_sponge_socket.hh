@@ -5,10 +5,13 @@
 #include "eventloop.hh"
 #include "fd_adapter.hh"
 #include "file_descriptor.hh"
+#include "loopback_adapter.hh"
 #include "network_interface.hh"
+#include "packet_ring_adapter.hh"
 #include "tcp_config.hh"
 #include "tcp_connection.hh"
 #include "tuntap_adapter.hh"
+#include "xdp_adapter.hh"
 
 #include <atomic>
 #include <cstdint>
@@ -99,6 +102,9 @@ class TCPSpongeSocket : public LocalStreamSocket {
 using TCPOverUDPSpongeSocket = TCPSpongeSocket<TCPOverUDPSocketAdapter>;
 using TCPOverIPv4SpongeSocket = TCPSpongeSocket<TCPOverIPv4OverTunFdAdapter>;
 using TCPOverIPv4OverEthernetSpongeSocket = TCPSpongeSocket<TCPOverIPv4OverEthernetAdapter>;
+using TCPOverIPv4OverPacketRingSpongeSocket = TCPSpongeSocket<TCPOverIPv4OverPacketRingAdapter>;
+using TCPOverIPv4OverXDPSpongeSocket = TCPSpongeSocket<TCPOverIPv4OverXDPAdapter>;
+using TCPOverIPv4OverLoopbackSpongeSocket = TCPSpongeSocket<TCPOverIPv4OverLoopbackAdapter>;
 
 using LossyTCPOverUDPSpongeSocket = TCPSpongeSocket<LossyTCPOverUDPSocketAdapter>;
 using LossyTCPOverIPv4SpongeSocket = TCPSpongeSocket<LossyTCPOverIPv4OverTunFdAdapter>;
@@ -123,7 +129,9 @@ using LossyTCPOverIPv4SpongeSocket = TCPSpongeSocket<LossyTCPOverIPv4OverTunFdAd
 //! - if TCPSpongeSocket is destructed while a TCP connection is open, the connection is
 //!   immediately terminated with a RST (call `wait_until_closed` to avoid this)
 
-//! Helper class that makes a TCPOverIPv4SpongeSocket behave more like a (kernel) TCPSocket
+//! \brief Helper class that makes a TCPOverIPv4SpongeSocket behave more like a (kernel) TCPSocket
+//! \details The sockets of a process share tun144 through one TunDispatcher, which hands each socket the
+//! packets of its own connection, so connections in one process run in parallel on the sockets' threads.
 class CS144TCPSocket : public TCPOverIPv4SpongeSocket {
   public:
     CS144TCPSocket();
@@ -0,0 +1,92 @@
+#include "tcp_super_segment.hh"
+
+#include "ipv4_datagram.hh"
+#include "util.hh"
+
+#include <cstring>
+
+using namespace std;
+
+//! \param[in] seg the segment to append
+bool TCPSuperSegment::can_append(const TCPSegment &seg) const {
+    if (_segments.empty()) {
+        return true;
+    }
+
+    const TCPHeader &first = _segments.front().header();
+    const TCPSegment &last = _segments.back();
+    const size_t gso_size = _segments.front().payload().size();
+    const TCPHeader &header = seg.header();
+
+    if (first.syn or first.rst or first.urg or header.syn or header.rst or header.urg or last.header().fin) {
+        return false;
+    }
+    if (header.doff != first.doff or header.ack != first.ack or header.ackno != first.ackno or
+        header.win != first.win) {
+        return false;
+    }
+    return gso_size > 0 and last.payload().size() == gso_size and seg.payload().size() > 0 and
+           seg.payload().size() <= gso_size and header.seqno == last.header().seqno + last.payload().size() and
+           _payload_size + seg.payload().size() <= max_payload(first);
+}
+
+//! \param[in] seg the segment to append
+void TCPSuperSegment::append(const TCPSegment &seg) {
+    _segments.push_back(seg);
+    _payload_size += seg.payload().size();
+}
+
+void TCPSuperSegment::clear() {
+    _segments.clear();
+    _payload_size = 0;
+}
+
+//! \details The checksum starts at the TCP header; gso_size is the first segment's payload size.
+VirtioNetHeader TCPSuperSegment::vnet_header() const {
+    const size_t tcp_header_len = 4 * _segments.front().header().doff;
+
+    VirtioNetHeader vnet_header{};
+    vnet_header.flags = VirtioNetHeader::F_NEEDS_CSUM;
+    vnet_header.hdr_len = IPv4Header::LENGTH + tcp_header_len;
+    vnet_header.csum_start = IPv4Header::LENGTH;
+    vnet_header.csum_offset = TCPHeader::CKSUM_OFFSET;
+    if (_segments.size() > 1) {
+        vnet_header.gso_type = VirtioNetHeader::GSO_TCPV4;
+        vnet_header.gso_size = _segments.front().payload().size();
+    }
+    return vnet_header;
+}
+
+//! \param[in] source the local address and port
+//! \param[in] destination the peer's address and port
+//! \details The TCP checksum field holds just the pseudo-header's sum, and the kernel adds in the rest
+//! (VirtioNetHeader::F_NEEDS_CSUM). The payloads are sent as they are, without being copied together.
+BufferList TCPSuperSegment::serialize(const Address &source, const Address &destination) const {
+    TCPHeader header = _segments.front().header();
+    header.sport = source.port();
+    header.dport = destination.port();
+    header.fin = _segments.back().header().fin;
+    header.psh = _segments.back().header().psh;
+
+    BufferList tcp_segment;
+    for (const TCPSegment &seg : _segments) {
+        if (seg.payload().size() > 0) {
+            tcp_segment.append(seg.payload());
+        }
+    }
+
+    InternetDatagram ip_dgram;
+    ip_dgram.header().src = source.ipv4_numeric();
+    ip_dgram.header().dst = destination.ipv4_numeric();
+    ip_dgram.header().len = ip_dgram.header().hlen * 4 + header.doff * 4 + _payload_size;
+
+    header.cksum = ~InternetChecksum(ip_dgram.header().pseudo_cksum()).value();
+    const size_t header_len = header.serialized_length();
+    header.serialize_into(tcp_segment.prepend(header_len), header_len);
+    ip_dgram.payload() = move(tcp_segment);
+    BufferList packet = ip_dgram.serialize();
+
+    const VirtioNetHeader vnet = vnet_header();
+    memcpy(packet.prepend(sizeof(vnet)), &vnet, sizeof(vnet));
+    return packet;
+}
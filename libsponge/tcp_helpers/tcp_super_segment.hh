@@ -0,0 +1,56 @@
+#ifndef SPONGE_LIBSPONGE_TCP_SUPER_SEGMENT_HH
+#define SPONGE_LIBSPONGE_TCP_SUPER_SEGMENT_HH
+
+#include "address.hh"
+#include "buffer.hh"
+#include "ipv4_header.hh"
+#include "tcp_header.hh"
+#include "tcp_segment.hh"
+#include "tun.hh"
+
+#include <cstddef>
+#include <vector>
+
+//! \brief A run of consecutive TCP segments, sent as one IPv4 datagram that the kernel cuts back into
+//! the original segments (TSO)
+//! \details TSO gives every segment the first segment's header, with the sequence number advanced by
+//! `gso_size` each time and with FIN and PSH only on the last. So the segments must carry the same
+//! acknowledgment and window, follow each other in sequence space, and all but the last must be full.
+class TCPSuperSegment {
+  private:
+    std::vector<TCPSegment> _segments{};  //!< the segments, in sequence order
+    size_t _payload_size{0};              //!< payload bytes in `_segments`
+
+  public:
+    //! \brief Most payload bytes in one super-segment whose header is `header`, so that its IPv4 length
+    //! still fits in 16 bits (the TCP options, if any, count against it)
+    static size_t max_payload(const TCPHeader &header) { return 65535 - IPv4Header::LENGTH - 4 * header.doff; }
+
+    //! Are there no segments yet?
+    bool empty() const { return _segments.empty(); }
+
+    //! Number of segments
+    size_t size() const { return _segments.size(); }
+
+    //! Payload bytes in all the segments together
+    size_t payload_size() const { return _payload_size; }
+
+    //! Can `seg` be appended, so that TSO still reproduces every segment? (Any segment can start one.)
+    bool can_append(const TCPSegment &seg) const;
+
+    //! Add `seg` after the segments so far (which can_append() should have allowed)
+    void append(const TCPSegment &seg);
+
+    //! Start over with no segments
+    void clear();
+
+    //! \brief The VirtioNetHeader that asks the kernel to finish the checksum and, for more than one
+    //! segment, to cut the datagram up again
+    VirtioNetHeader vnet_header() const;
+
+    //! \brief The super-segment as one IPv4 datagram from `source` to `destination`, after its
+    //! VirtioNetHeader, ready to write to a TUN device opened with `vnet_hdr`
+    BufferList serialize(const Address &source, const Address &destination) const;
+};
+
+#endif  // SPONGE_LIBSPONGE_TCP_SUPER_SEGMENT_HH
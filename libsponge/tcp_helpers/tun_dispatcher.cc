@@ -0,0 +1,271 @@
+#include "tun_dispatcher.hh"
+
+#include "ethernet_header.hh"
+#include "ipv4_header.hh"
+#include "util.hh"
+
+#include <array>
+#include <cerrno>
+#include <iostream>
+#include <map>
+#include <poll.h>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+uint16_t load_be16(const string_view bytes, const size_t offset) {
+    return uint16_t(uint8_t(bytes[offset]) << 8 | uint8_t(bytes[offset + 1]));
+}
+
+uint32_t load_be32(const string_view bytes, const size_t offset) {
+    return uint32_t(load_be16(bytes, offset)) << 16 | load_be16(bytes, offset + 2);
+}
+
+}  // namespace
+
+size_t FlowKeyHash::operator()(const FlowKey &key) const {
+    const uint64_t ips = uint64_t(key.local_ip) << 32 | key.remote_ip;
+    const uint64_t ports = uint64_t(key.local_port) << 16 | key.remote_port;
+    // a multiplicative mix, so that flows differing only in a port spread over the buckets
+    return (ips * 0x9e3779b97f4a7c15ULL) ^ (ports * 0xc2b2ae3d27d4eb4fULL);
+}
+
+//! \param[in] endpoint identifies the endpoint (e.g. by the order in which endpoints were added)
+//! \param[in] key is the flow it expects, with zero `remote_ip` and `remote_port` to listen for any peer,
+//! and zero `local_ip` to accept any local address
+void FlowDispatchTable::bind(const size_t endpoint, const FlowKey &key) {
+    const auto bound = _endpoints.find(key);
+    if (bound != _endpoints.end()) {
+        if (bound->second == endpoint) {
+            return;
+        }
+        throw runtime_error("FlowDispatchTable: flow already bound to another endpoint");
+    }
+    unbind(endpoint);
+    _endpoints.emplace(key, endpoint);
+    _bindings.emplace(endpoint, key);
+}
+
+void FlowDispatchTable::unbind(const size_t endpoint) {
+    const auto binding = _bindings.find(endpoint);
+    if (binding == _bindings.end()) {
+        return;
+    }
+    _endpoints.erase(binding->second);
+    _bindings.erase(binding);
+}
+
+//! \param[in] flow the flow of an inbound packet, from this host's side
+optional<size_t> FlowDispatchTable::lookup(const FlowKey &flow) const {
+    for (const FlowKey &key : {flow,
+                               FlowKey{flow.local_ip, 0, flow.local_port, 0},
+                               FlowKey{0, 0, flow.local_port, 0}}) {
+        const auto bound = _endpoints.find(key);
+        if (bound != _endpoints.end()) {
+            return bound->second;
+        }
+    }
+    return {};
+}
+
+optional<FlowKey> FlowDispatchTable::inbound_flow(string_view packet, const bool ethernet) {
+    if (ethernet) {
+        if (packet.size() < EthernetHeader::LENGTH or load_be16(packet, 12) != EthernetHeader::TYPE_IPv4) {
+            return {};
+        }
+        packet.remove_prefix(EthernetHeader::LENGTH);
+    }
+
+    if (packet.size() < IPv4Header::LENGTH or uint8_t(packet[0]) >> 4 != 4) {
+        return {};
+    }
+    const size_t header_length = (uint8_t(packet[0]) & 0xf) * 4;
+    const bool first_fragment = (load_be16(packet, 6) & 0x1fff) == 0;
+    if (header_length < IPv4Header::LENGTH or uint8_t(packet[9]) != IPv4Header::PROTO_TCP or not first_fragment or
+        packet.size() < header_length + 4) {
+        return {};
+    }
+
+    FlowKey flow;
+    flow.remote_ip = load_be32(packet, 12);
+    flow.local_ip = load_be32(packet, 16);
+    flow.remote_port = load_be16(packet, header_length);
+    flow.local_port = load_be16(packet, header_length + 2);
+    return flow;
+}
+
+bool FlowDispatchTable::for_all(const string_view packet, const bool ethernet) {
+    return ethernet and packet.size() >= EthernetHeader::LENGTH and
+           load_be16(packet, 12) == EthernetHeader::TYPE_ARP;
+}
+
+//! \details Opens the first queue, and the rest only if that one turns out to be one of several.
+TunDispatcher::TunDispatcher(const string &devname,
+                             const bool is_tun,
+                             const bool vnet_hdr,
+                             const size_t queue_count)
+    : _ethernet(not is_tun), _vnet_hdr(vnet_hdr), _queues() {
+    _queues.emplace_back(devname, is_tun, true, vnet_hdr);
+    while (_queues.front().multi_queue() and _queues.size() < queue_count) {
+        _queues.emplace_back(devname, is_tun, true, vnet_hdr);
+    }
+
+    for (size_t i = 0; i < _queues.size(); i++) {
+        _workers.emplace_back(&TunDispatcher::work, this, i);
+    }
+}
+
+TunDispatcher::~TunDispatcher() {
+    _running.store(false);
+    _stop.notify();
+    for (auto &worker : _workers) {
+        worker.join();
+    }
+}
+
+shared_ptr<TunDispatcher> TunDispatcher::open(const string &devname,
+                                              const bool is_tun,
+                                              const bool vnet_hdr,
+                                              const size_t queue_count) {
+    static mutex open_mutex;
+    static map<string, weak_ptr<TunDispatcher>> dispatchers;
+
+    lock_guard<mutex> lock(open_mutex);
+    shared_ptr<TunDispatcher> dispatcher = dispatchers[devname].lock();
+    if (dispatcher) {
+        if (dispatcher->_ethernet == is_tun or dispatcher->_vnet_hdr != vnet_hdr) {
+            throw runtime_error("TunDispatcher: " + devname + " is already open with other settings");
+        }
+        return dispatcher;
+    }
+    dispatcher.reset(new TunDispatcher(devname, is_tun, vnet_hdr, queue_count));
+    dispatchers[devname] = dispatcher;
+    return dispatcher;
+}
+
+//! \param[in] index the queue that this worker reads
+void TunDispatcher::work(const size_t index) {
+    try {
+        TunTapFD &queue = _queues[index];
+        array<pollfd, 2> fds{{{queue.fd_num(), POLLIN, 0}, {_stop.fd_num(), POLLIN, 0}}};
+        while (_running.load()) {
+            SystemCall("poll", ::poll(fds.data(), fds.size(), -1), EINTR);
+            if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                throw runtime_error("TunDispatcher: queue " + to_string(index) + " failed");
+            }
+            if (fds[0].revents & POLLIN) {
+                Buffer packet;
+                queue.read(packet);
+                dispatch(move(packet));
+            }
+        }
+    } catch (const exception &e) {
+        cerr << "Exception in TunDispatcher worker thread: " << e.what() << "\n";
+    }
+}
+
+//! \param[in] packet a packet read from one of the queues, which goes to at most one endpoint (or, for an
+//! ARP frame, to all of them)
+void TunDispatcher::dispatch(Buffer &&packet) {
+    string_view contents = packet;
+    if (_vnet_hdr) {
+        if (contents.size() < sizeof(VirtioNetHeader)) {
+            return;
+        }
+        contents.remove_prefix(sizeof(VirtioNetHeader));
+    }
+
+    shared_lock<shared_mutex> lock(_table_mutex);
+    if (FlowDispatchTable::for_all(contents, _ethernet)) {
+        for (auto &[id, inbox] : _inboxes) {
+            deliver(*inbox, Buffer(packet));
+        }
+        return;
+    }
+
+    const optional<FlowKey> flow = FlowDispatchTable::inbound_flow(contents, _ethernet);
+    if (not flow.has_value()) {
+        return;
+    }
+    const optional<size_t> endpoint = _table.lookup(flow.value());
+    if (endpoint.has_value()) {
+        deliver(*_inboxes.at(endpoint.value()), move(packet));
+    }
+}
+
+//! \details The doorbell is notified when the inbox stops being empty; Endpoint::read() resets it when the
+//! inbox is empty again, under the same lock, so no packet is left without a notification.
+void TunDispatcher::deliver(Inbox &inbox, Buffer &&packet) {
+    lock_guard<mutex> lock(inbox.mutex);
+    if (inbox.packets.size() >= INBOX_CAPACITY) {
+        inbox.dropped++;
+        return;
+    }
+    inbox.packets.push_back(move(packet));
+    if (inbox.packets.size() == 1) {
+        inbox.doorbell.notify();
+    }
+}
+
+TunDispatcher::Endpoint TunDispatcher::add_endpoint(const shared_ptr<TunDispatcher> &dispatcher) {
+    auto inbox = make_shared<Inbox>();
+    size_t id = 0;
+    {
+        unique_lock<shared_mutex> lock(dispatcher->_table_mutex);
+        id = dispatcher->_next_endpoint++;
+        dispatcher->_inboxes.emplace(id, inbox);
+    }
+    return Endpoint(dispatcher, id, move(inbox));
+}
+
+//! \details The endpoints' writes are spread over the queues, so that the kernel's per-queue work (and, for
+//! the flows they send, its choice of queue for inbound packets) is spread too.
+TunDispatcher::Endpoint::Endpoint(shared_ptr<TunDispatcher> dispatcher, const size_t id, shared_ptr<Inbox> inbox)
+    : _dispatcher(move(dispatcher))
+    , _id(id)
+    , _inbox(move(inbox))
+    , _queue(_dispatcher->_next_writer++ % _dispatcher->_queues.size()) {}
+
+TunDispatcher::Endpoint::~Endpoint() {
+    // a moved-from endpoint has nothing to remove
+    if (not _dispatcher) {
+        return;
+    }
+    unique_lock<shared_mutex> lock(_dispatcher->_table_mutex);
+    _dispatcher->_table.unbind(_id);
+    _dispatcher->_inboxes.erase(_id);
+}
+
+//! \param[in] flow the flow to receive, as for FlowDispatchTable::bind
+void TunDispatcher::Endpoint::bind(const FlowKey &flow) {
+    unique_lock<shared_mutex> lock(_dispatcher->_table_mutex);
+    _dispatcher->_table.bind(_id, flow);
+}
+
+//! \param[out] packet the packet taken, as read from the device (including any VirtioNetHeader)
+bool TunDispatcher::Endpoint::read(Buffer &packet) {
+    lock_guard<mutex> lock(_inbox->mutex);
+    if (not _inbox->packets.empty()) {
+        packet = move(_inbox->packets.front());
+        _inbox->packets.pop_front();
+    } else {
+        _inbox->doorbell.clear();
+        return false;
+    }
+    if (_inbox->packets.empty()) {
+        _inbox->doorbell.clear();
+    }
+    return true;
+}
+
+size_t TunDispatcher::Endpoint::buffered() const {
+    lock_guard<mutex> lock(_inbox->mutex);
+    return _inbox->packets.size();
+}
+
+size_t TunDispatcher::Endpoint::dropped() const {
+    lock_guard<mutex> lock(_inbox->mutex);
+    return _inbox->dropped;
+}
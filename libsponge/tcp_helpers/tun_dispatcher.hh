@@ -0,0 +1,195 @@
+#ifndef SPONGE_LIBSPONGE_TUN_DISPATCHER_HH
+#define SPONGE_LIBSPONGE_TUN_DISPATCHER_HH
+
+#include "buffer.hh"
+#include "event_fd.hh"
+#include "tun.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+//! The addresses and ports of a TCP flow, from this host's side (raw, host byte order)
+struct FlowKey {
+    uint32_t local_ip{0};     //!< in a binding, 0 matches any local address
+    uint32_t remote_ip{0};    //!< in a binding, 0 (with `remote_port` 0) matches any peer, as for a listener
+    uint16_t local_port{0};   //!< the port of this host's end
+    uint16_t remote_port{0};  //!< the peer's port
+
+    bool operator==(const FlowKey &other) const {
+        return local_ip == other.local_ip and remote_ip == other.remote_ip and local_port == other.local_port and
+               remote_port == other.remote_port;
+    }
+};
+
+//! Hash of a FlowKey, for std::unordered_map
+struct FlowKeyHash {
+    size_t operator()(const FlowKey &key) const;
+};
+
+//! \brief Which endpoint (of those sharing a TUN or TAP device in one process) each inbound packet is for
+//! \details Each endpoint binds the flow it expects, or, while listening, just its local address and port.
+//! An inbound TCP packet goes to the endpoint bound to its exact flow if there is one, and otherwise to a
+//! listener on its destination address (or on any address) and port.
+class FlowDispatchTable {
+  private:
+    std::unordered_map<FlowKey, size_t, FlowKeyHash> _endpoints{};  //!< the endpoint bound to each key
+    std::unordered_map<size_t, FlowKey> _bindings{};                //!< the key each endpoint is bound to
+
+  public:
+    //! \brief Bind `endpoint` to `key`, in place of the key it was bound to before (if any)
+    //! \note Throws if another endpoint is bound to `key`
+    void bind(const size_t endpoint, const FlowKey &key);
+
+    //! Remove the binding of `endpoint`, if any
+    void unbind(const size_t endpoint);
+
+    //! The endpoint that an inbound packet of `flow` is for, if any
+    std::optional<size_t> lookup(const FlowKey &flow) const;
+
+    //! \brief The flow of an inbound IPv4 TCP packet, from this host's side
+    //! \param[in] packet is an IPv4 datagram, or with `ethernet`, an Ethernet frame
+    //! \returns an empty optional for anything else (including fragments after the first)
+    static std::optional<FlowKey> inbound_flow(std::string_view packet, const bool ethernet);
+
+    //! Is `packet` for every endpoint? (An ARP frame is, since each endpoint has its own NetworkInterface.)
+    static bool for_all(std::string_view packet, const bool ethernet);
+};
+
+//! \brief Reads every packet that a TUN or TAP device passes to this process, and hands each to the
+//! Endpoint it is for
+//! \details The kernel spreads a `multi_queue` device's inbound packets over its queues by flow, but a flow
+//! is not bound to a queue (see TunTapFD), so sockets cannot each just own a queue. Instead, one
+//! TunDispatcher per device opens a fixed set of queues, each read by a worker thread of its own. A worker
+//! finds the endpoint that each packet is for in a FlowDispatchTable, and passes the packet to it through
+//! a queue in memory, waking its owner through an eventfd. Endpoints write straight to the device.
+//!
+//! All the queues of a device should belong to one TunDispatcher: a packet that reaches a queue opened
+//! by another process (or opened directly with TunTapFD) is lost to the endpoints of this one.
+class TunDispatcher {
+  public:
+    //! Queues opened (and worker threads started) for a `multi_queue` device
+    static constexpr size_t DEFAULT_QUEUE_COUNT = 4;
+
+    //! Most packets waiting for an endpoint to read them; more are dropped, as by a full NIC queue
+    static constexpr size_t INBOX_CAPACITY = 1024;
+
+    class Endpoint;
+
+  private:
+    //! Packets waiting for an endpoint, and the eventfd that is readable while there are any
+    struct Inbox {
+        std::mutex mutex{};
+        std::deque<Buffer> packets{};
+        EventFD doorbell{};
+        size_t dropped{0};  //!< packets dropped because the inbox was full
+    };
+
+    const bool _ethernet;  //!< is this a TAP device?
+    const bool _vnet_hdr;  //!< does every packet start with a VirtioNetHeader?
+
+    std::vector<TunTapFD> _queues;
+    std::vector<std::thread> _workers{};
+    EventFD _stop{};  //!< wakes the workers to stop
+    std::atomic<bool> _running{true};
+    std::atomic<size_t> _next_writer{0};  //!< the queue that the next endpoint writes to
+
+    mutable std::shared_mutex _table_mutex{};  //!< guards `_table`, `_inboxes` and `_next_endpoint`
+    FlowDispatchTable _table{};
+    std::unordered_map<size_t, std::shared_ptr<Inbox>> _inboxes{};
+    size_t _next_endpoint{0};
+
+    TunDispatcher(const std::string &devname, const bool is_tun, const bool vnet_hdr, const size_t queue_count);
+
+    //! The loop run by the worker that reads queue `index`
+    void work(const size_t index);
+
+    //! Hand a packet read from the device to the endpoint(s) it is for
+    void dispatch(Buffer &&packet);
+
+    //! Add a packet to an inbox, dropping it if the inbox is full
+    static void deliver(Inbox &inbox, Buffer &&packet);
+
+  public:
+    //! \brief The TunDispatcher for device `devname`, opening it if this process does not have it open yet
+    //! \param[in] devname is the name of the TUN or TAP device
+    //! \param[in] is_tun is `true` for a TUN device, or `false` for a TAP device
+    //! \param[in] vnet_hdr is passed to TunTapFD for each queue
+    //! \param[in] queue_count is the number of queues to open, if the device was created with `multi_queue`
+    static std::shared_ptr<TunDispatcher> open(const std::string &devname,
+                                               const bool is_tun,
+                                               const bool vnet_hdr = false,
+                                               const size_t queue_count = DEFAULT_QUEUE_COUNT);
+
+    ~TunDispatcher();
+
+    //! \name No copying or moving: the workers refer to the dispatcher
+    //!@{
+    TunDispatcher(const TunDispatcher &other) = delete;
+    TunDispatcher &operator=(const TunDispatcher &other) = delete;
+    //!@}
+
+    //! Number of queues (and workers): one if the device was created without `multi_queue`
+    size_t queue_count() const { return _queues.size(); }
+
+    //! \brief A new endpoint, which receives nothing until it is bound to a flow
+    static Endpoint add_endpoint(const std::shared_ptr<TunDispatcher> &dispatcher);
+};
+
+//! \brief One user of a TunDispatcher's device, such as the adapter of a socket
+//! \details Only one thread at a time may use an Endpoint (but endpoints of the same device are independent).
+class TunDispatcher::Endpoint {
+  private:
+    std::shared_ptr<TunDispatcher> _dispatcher;
+    size_t _id;
+    std::shared_ptr<Inbox> _inbox;
+    size_t _queue;  //!< the queue that this endpoint writes to
+
+    friend class TunDispatcher;
+    Endpoint(std::shared_ptr<TunDispatcher> dispatcher, const size_t id, std::shared_ptr<Inbox> inbox);
+
+  public:
+    ~Endpoint();
+
+    //! \name Endpoints can be moved, but not copied or assigned
+    //!@{
+    Endpoint(Endpoint &&other) = default;
+    Endpoint &operator=(Endpoint &&other) = delete;
+    Endpoint(const Endpoint &other) = delete;
+    Endpoint &operator=(const Endpoint &other) = delete;
+    //!@}
+
+    //! \brief Receive the packets of `flow` (see FlowDispatchTable::bind), instead of those of any earlier flow
+    void bind(const FlowKey &flow);
+
+    //! \brief Take the oldest packet waiting for this endpoint
+    //! \returns `false` if there is none
+    bool read(Buffer &packet);
+
+    //! Packets waiting for read()
+    size_t buffered() const;
+
+    //! Packets dropped because read() was not called soon enough
+    size_t dropped() const;
+
+    //! A new descriptor to write this endpoint's packets to
+    TunTapFD writer() const { return _dispatcher->_queues.at(_queue).dup(); }
+
+    //! The eventfd that is readable while packets are waiting
+    EventFD &doorbell() { return _inbox->doorbell; }
+
+    //! The eventfd that is readable while packets are waiting
+    const EventFD &doorbell() const { return _inbox->doorbell; }
+};
+
+#endif  // SPONGE_LIBSPONGE_TUN_DISPATCHER_HH
@@ -1,12 +1,126 @@
 #include "tuntap_adapter.hh"
 
+#include <cstring>
+
 using namespace std;
 
+namespace {
+
+//! The flow that an adapter with configuration `cfg` expects: just its local address while listening
+FlowKey configured_flow(const FdAdapterConfig &cfg, const bool listening) {
+    FlowKey flow;
+    flow.local_ip = cfg.source.ipv4_numeric();
+    flow.local_port = cfg.source.port();
+    if (not listening) {
+        flow.remote_ip = cfg.destination.ipv4_numeric();
+        flow.remote_port = cfg.destination.port();
+    }
+    return flow;
+}
+
+}  // namespace
+
+void TCPOverIPv4OverTunFdAdapter::bind_endpoint() {
+    if (_endpoint.has_value()) {
+        _endpoint->bind(configured_flow(config(), listening()));
+    }
+}
+
+//! \param[in] cfg the new configuration
+void TCPOverIPv4OverTunFdAdapter::set_config(const FdAdapterConfig &cfg) {
+    FdAdapterBase::set_config(cfg);
+    bind_endpoint();
+}
+
+//! \param[in] l is the new value for the flag
+void TCPOverIPv4OverTunFdAdapter::set_listening(const bool l) {
+    FdAdapterBase::set_listening(l);
+    bind_endpoint();
+}
+
+TCPOverIPv4OverTunFdAdapter::operator FileDescriptor &() {
+    if (_endpoint.has_value()) {
+        return _endpoint->doorbell();
+    }
+    return _tun;
+}
+
+TCPOverIPv4OverTunFdAdapter::operator const FileDescriptor &() const {
+    if (_endpoint.has_value()) {
+        return _endpoint->doorbell();
+    }
+    return _tun;
+}
+
+//! \details With `vnet_hdr`, each packet starts with a virtio-net header. The TCP checksum is skipped if the
+//! header says the packet never left this host (its checksum is only partial) or the kernel checked it already.
+//!
+//! With a TunDispatcher, the datagram comes from the endpoint instead of the device. Once a listening adapter
+//! accepts a SYN, the endpoint is bound to that one flow.
+optional<TCPSegment> TCPOverIPv4OverTunFdAdapter::read() {
+    Buffer raw_datagram;
+    if (not _endpoint.has_value()) {
+        _tun.read(raw_datagram);
+    } else if (not _endpoint->read(raw_datagram)) {
+        return {};
+    }
+    bool checksum_verified = false;
+    if (_tun.vnet_hdr()) {
+        VirtioNetHeader vnet_header{};
+        if (raw_datagram.size() < sizeof(vnet_header)) {
+            return {};
+        }
+        memcpy(&vnet_header, raw_datagram.str().data(), sizeof(vnet_header));
+        raw_datagram.remove_prefix(sizeof(vnet_header));
+        checksum_verified = vnet_header.flags & (VirtioNetHeader::F_NEEDS_CSUM | VirtioNetHeader::F_DATA_VALID);
+    }
+
+    InternetDatagram ip_dgram;
+    if (ip_dgram.parse(move(raw_datagram)) != ParseResult::NoError) {
+        return {};
+    }
+    const bool was_listening = listening();
+    optional<TCPSegment> seg = unwrap_tcp_in_ip(ip_dgram, checksum_verified);
+    if (was_listening and not listening()) {
+        bind_endpoint();
+    }
+    return seg;
+}
+
+//! \details With `vnet_hdr`, the segment is held back while corked, as long as it continues the super-segment
+//! being built; otherwise it is sent straight away (after any segments held back).
+void TCPOverIPv4OverTunFdAdapter::write(TCPSegment &seg) {
+    if (not _tun.vnet_hdr()) {
+        _tun.write(wrap_tcp_in_ip(seg).serialize());
+        return;
+    }
+
+    if (not _super_segment.can_append(seg)) {
+        send_super_segment();
+    }
+    _super_segment.append(seg);
+    if (not _corked) {
+        send_super_segment();
+    }
+}
+
+void TCPOverIPv4OverTunFdAdapter::uncork() {
+    _corked = false;
+    if (not _super_segment.empty()) {
+        send_super_segment();
+    }
+}
+
+void TCPOverIPv4OverTunFdAdapter::send_super_segment() {
+    _tun.write(_super_segment.serialize(config().source, config().destination));
+    _super_segment.clear();
+}
+
 //! \param[in] tap Raw network device that will be owned by the adapter
 //! \param[in] eth_address Ethernet address (local address) of the adapter
 //! \param[in] ip_address IP address (local address) of the adapter
 //! \param[in] next_hop IP address of the next hop (typically a router or default gateway)
-TCPOverIPv4OverEthernetAdapter::TCPOverIPv4OverEthernetAdapter(TapFD &&tap,
+TCPOverIPv4OverEthernetAdapter::TCPOverIPv4OverEthernetAdapter(TunTapFD &&tap,
                                                                const EthernetAddress &eth_address,
                                                                const Address &ip_address,
                                                                const Address &next_hop)
@@ -16,10 +130,72 @@ TCPOverIPv4OverEthernetAdapter::TCPOverIPv4OverEthernetAdapter(TapFD &&tap,
     _tap.write(dummy_frame.serialize());
 }
 
+//! \param[in] endpoint the endpoint that inbound frames come from (its queue is used for writing)
+//! \param[in] eth_address Ethernet address (local address) of the adapter
+//! \param[in] ip_address IP address (local address) of the adapter
+//! \param[in] next_hop IP address of the next hop (typically a router or default gateway)
+TCPOverIPv4OverEthernetAdapter::TCPOverIPv4OverEthernetAdapter(TunDispatcher::Endpoint &&endpoint,
+                                                               const EthernetAddress &eth_address,
+                                                               const Address &ip_address,
+                                                               const Address &next_hop)
+    : TCPOverIPv4OverEthernetAdapter(endpoint.writer(), eth_address, ip_address, next_hop) {
+    _endpoint.emplace(move(endpoint));
+}
+
+//! \param[in] dispatcher the TunDispatcher of the TAP device to share
+//! \param[in] eth_address Ethernet address (local address) of the adapter
+//! \param[in] ip_address IP address (local address) of the adapter
+//! \param[in] next_hop IP address of the next hop (typically a router or default gateway)
+TCPOverIPv4OverEthernetAdapter::TCPOverIPv4OverEthernetAdapter(const shared_ptr<TunDispatcher> &dispatcher,
+                                                               const EthernetAddress &eth_address,
+                                                               const Address &ip_address,
+                                                               const Address &next_hop)
+    : TCPOverIPv4OverEthernetAdapter(TunDispatcher::add_endpoint(dispatcher), eth_address, ip_address, next_hop) {}
+
+void TCPOverIPv4OverEthernetAdapter::bind_endpoint() {
+    if (_endpoint.has_value()) {
+        _endpoint->bind(configured_flow(config(), listening()));
+    }
+}
+
+//! \param[in] cfg the new configuration
+void TCPOverIPv4OverEthernetAdapter::set_config(const FdAdapterConfig &cfg) {
+    FdAdapterBase::set_config(cfg);
+    bind_endpoint();
+}
+
+//! \param[in] l is the new value for the flag
+void TCPOverIPv4OverEthernetAdapter::set_listening(const bool l) {
+    FdAdapterBase::set_listening(l);
+    bind_endpoint();
+}
+
+TCPOverIPv4OverEthernetAdapter::operator FileDescriptor &() {
+    if (_endpoint.has_value()) {
+        return _endpoint->doorbell();
+    }
+    return _tap;
+}
+
+TCPOverIPv4OverEthernetAdapter::operator const FileDescriptor &() const {
+    if (_endpoint.has_value()) {
+        return _endpoint->doorbell();
+    }
+    return _tap;
+}
+
+//! \details With a TunDispatcher, the frame comes from the endpoint instead of the device, as for
+//! TCPOverIPv4OverTunFdAdapter::read().
 optional<TCPSegment> TCPOverIPv4OverEthernetAdapter::read() {
     // Read Ethernet frame from the raw device
+    Buffer raw_frame;
+    if (not _endpoint.has_value()) {
+        _tap.read(raw_frame);
+    } else if (not _endpoint->read(raw_frame)) {
+        return {};
+    }
     EthernetFrame frame;
-    if (frame.parse(_tap.read()) != ParseResult::NoError) {
+    if (frame.parse(move(raw_frame)) != ParseResult::NoError) {
         return {};
     }
 
@@ -31,7 +207,12 @@ optional<TCPSegment> TCPOverIPv4OverEthernetAdapter::read() {
 
     // Try to interpret IPv4 datagram as TCP
     if (ip_dgram) {
-        return unwrap_tcp_in_ip(ip_dgram.value());
+        const bool was_listening = listening();
+        optional<TCPSegment> seg = unwrap_tcp_in_ip(ip_dgram.value());
+        if (was_listening and not listening()) {
+            bind_endpoint();
+        }
+        return seg;
     }
     return {};
 }
@@ -49,10 +230,7 @@ void TCPOverIPv4OverEthernetAdapter::write(TCPSegment &seg) {
 }
 
 void TCPOverIPv4OverEthernetAdapter::send_pending() {
-    while (not _interface.frames_out().empty()) {
-        _tap.write(_interface.frames_out().front().serialize());
-        _interface.frames_out().pop();
-    }
+    _interface.drain_to(_tap);
 }
 
 //! Specialize LossyFdAdapter to TCPOverIPv4OverTunFdAdapter
@@ -3,47 +3,89 @@
 
 #include "ethernet_header.hh"
 #include "network_interface.hh"
+#include "tcp_super_segment.hh"
 #include "tun.hh"
+#include "tun_dispatcher.hh"
 
+#include <memory>
 #include <optional>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 //! \brief A FD adapter for IPv4 datagrams read from and written to a TUN device
+//! \details If the TunFD was opened with `vnet_hdr`, the adapter uses the kernel's offloads. Outgoing
+//! segments leave their checksums for the kernel to finish, and while corked, a run of consecutive
+//! segments is sent as one TCP super-segment of up to 64 KiB that the kernel cuts back into segments
+//! (TSO). Incoming packets may be GRO-coalesced into one large segment, which is passed on whole.
+//!
+//! Constructed from a TunDispatcher, the adapter shares the device with the other adapters in the process:
+//! it receives the packets of the flow in its configuration, and is readable through an eventfd.
 class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter {
   private:
-    TunFD _tun;
+    TunTapFD _tun;  //!< the device, or with `_endpoint`, a descriptor for writing to one of its queues
+
+    std::optional<TunDispatcher::Endpoint> _endpoint{};  //!< where inbound packets come from, if dispatched
+
+    TCPSuperSegment _super_segment{};  //!< consecutive segments written while corked, to send as one
+    bool _corked{false};               //!< hold back writes until uncork()?
+
+    //! Send `_super_segment` as one packet, and start a new one
+    void send_super_segment();
+
+    //! Bind `_endpoint` (if any) to the flow in the configuration
+    void bind_endpoint();
+
+    //! Construct from an endpoint of a TunDispatcher for a TUN device
+    explicit TCPOverIPv4OverTunFdAdapter(TunDispatcher::Endpoint &&endpoint)
+        : _tun(endpoint.writer()), _endpoint(std::move(endpoint)) {}
 
   public:
-    //! Construct from a TunFD
+    //! Construct from a TunFD, which the adapter then reads on its own
     explicit TCPOverIPv4OverTunFdAdapter(TunFD &&tun) : _tun(std::move(tun)) {}
 
+    //! Construct from a TunDispatcher, sharing its TUN device
+    explicit TCPOverIPv4OverTunFdAdapter(const std::shared_ptr<TunDispatcher> &dispatcher)
+        : TCPOverIPv4OverTunFdAdapter(TunDispatcher::add_endpoint(dispatcher)) {}
+
     //! Attempts to read and parse an IPv4 datagram containing a TCP segment related to the current connection
-    std::optional<TCPSegment> read() {
-        InternetDatagram ip_dgram;
-        if (ip_dgram.parse(_tun.read()) != ParseResult::NoError) {
-            return {};
-        }
-        return unwrap_tcp_in_ip(ip_dgram);
-    }
+    std::optional<TCPSegment> read();
 
     //! Creates an IPv4 datagram from a TCP segment and writes it to the TUN device
-    void write(TCPSegment &seg) { _tun.write(wrap_tcp_in_ip(seg).serialize()); }
+    void write(TCPSegment &seg);
+
+    //! FdAdapterBase::set_config, which also binds the endpoint (if any) to the configured flow
+    void set_config(const FdAdapterConfig &cfg);
+
+    //! FdAdapterBase::set_listening, which also binds the endpoint (if any) to the configured local address
+    void set_listening(const bool l);
+
+    //! Datagrams that the dispatcher has passed on and read() has not yet returned
+    size_t buffered_reads() const { return _endpoint.has_value() ? _endpoint->buffered() : 0; }
+
+    //! Hold back writes until uncork(), so that consecutive segments can be sent as one (with `vnet_hdr`)
+    void cork() { _corked = true; }
 
-    //! Access the underlying TUN device
-    operator TunFD &() { return _tun; }
+    //! Send everything written since cork()
+    void uncork();
 
-    //! Access the underlying TUN device
-    operator const TunFD &() const { return _tun; }
+    //! Access the descriptor that is readable when there is something to read()
+    operator FileDescriptor &();
+
+    //! Access the descriptor that is readable when there is something to read()
+    operator const FileDescriptor &() const;
 };
 
 //! Typedef for TCPOverIPv4OverTunFdAdapter
 using LossyTCPOverIPv4OverTunFdAdapter = LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>;
 
 //! \brief A FD adapter for IPv4 datagrams read from and written to a TAP device
+//! \details As with TCPOverIPv4OverTunFdAdapter, the TAP device may be shared through a TunDispatcher.
 class TCPOverIPv4OverEthernetAdapter : public TCPOverIPv4Adapter {
   private:
-    TapFD _tap;  //!< Raw Ethernet connection
+    TunTapFD _tap;  //!< Raw Ethernet connection (with `_endpoint`, for writing only)
+
+    std::optional<TunDispatcher::Endpoint> _endpoint{};  //!< where inbound frames come from, if dispatched
 
     NetworkInterface _interface;  //!< NIC abstraction
 
@@ -51,9 +93,31 @@ class TCPOverIPv4OverEthernetAdapter : public TCPOverIPv4Adapter {
 
     void send_pending();  //!< Sends any pending Ethernet frames
 
+    //! Bind `_endpoint` (if any) to the flow in the configuration
+    void bind_endpoint();
+
+    //! Construct from a descriptor for the TAP device (or one of its queues)
+    TCPOverIPv4OverEthernetAdapter(TunTapFD &&tap,
+                                   const EthernetAddress &eth_address,
+                                   const Address &ip_address,
+                                   const Address &next_hop);
+
+    //! Construct from an endpoint of a TunDispatcher for a TAP device
+    TCPOverIPv4OverEthernetAdapter(TunDispatcher::Endpoint &&endpoint,
+                                   const EthernetAddress &eth_address,
+                                   const Address &ip_address,
+                                   const Address &next_hop);
+
   public:
     //! Construct from a TapFD
     explicit TCPOverIPv4OverEthernetAdapter(TapFD &&tap,
+                                            const EthernetAddress &eth_address,
+                                            const Address &ip_address,
+                                            const Address &next_hop)
+        : TCPOverIPv4OverEthernetAdapter(static_cast<TunTapFD &&>(tap), eth_address, ip_address, next_hop) {}
+
+    //! Construct from a TunDispatcher, sharing its TAP device
+    explicit TCPOverIPv4OverEthernetAdapter(const std::shared_ptr<TunDispatcher> &dispatcher,
                                             const EthernetAddress &eth_address,
                                             const Address &ip_address,
                                             const Address &next_hop);
@@ -66,11 +130,20 @@ class TCPOverIPv4OverEthernetAdapter : public TCPOverIPv4Adapter {
     //! Called periodically when time elapses
     void tick(const size_t ms_since_last_tick);
 
-    //! Access the underlying raw Ethernet connection
-    operator TapFD &() { return _tap; }
+    //! FdAdapterBase::set_config, which also binds the endpoint (if any) to the configured flow
+    void set_config(const FdAdapterConfig &cfg);
+
+    //! FdAdapterBase::set_listening, which also binds the endpoint (if any) to the configured local address
+    void set_listening(const bool l);
+
+    //! Frames that the dispatcher has passed on and read() has not yet taken
+    size_t buffered_reads() const { return _endpoint.has_value() ? _endpoint->buffered() : 0; }
+
+    //! Access the descriptor that is readable when there is something to read()
+    operator FileDescriptor &();
 
-    //! Access the underlying raw Ethernet connection
-    operator const TapFD &() const { return _tap; }
+    //! Access the descriptor that is readable when there is something to read()
+    operator const FileDescriptor &() const;
 };
 
 #endif  // SPONGE_LIBSPONGE_TUNFD_ADAPTER_HH
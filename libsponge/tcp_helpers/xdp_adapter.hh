@@ -0,0 +1,59 @@
+#ifndef SPONGE_LIBSPONGE_XDP_ADAPTER_HH
+#define SPONGE_LIBSPONGE_XDP_ADAPTER_HH
+
+#include "ethernet_header.hh"
+#include "network_interface.hh"
+#include "tcp_over_ip.hh"
+#include "xdp_socket.hh"
+
+#include <optional>
+
+//! \brief A FD adapter for IPv4 datagrams in Ethernet frames, moved through an AF_XDP socket on one queue
+//! of a network interface, bypassing the kernel's network stack
+//! \details Received frames are parsed in place in the UMEM. Frames written while corked are queued on the
+//! transmit ring and handed to the kernel together by uncork().
+class TCPOverIPv4OverXDPAdapter : public TCPOverIPv4Adapter {
+  private:
+    XDPSocketFD _xsk;  //!< AF_XDP socket with its UMEM
+
+    NetworkInterface _interface;  //!< NIC abstraction
+
+    Address _next_hop;  //!< IP address of the next hop
+
+    bool _corked{false};  //!< hold back frames on the transmit ring until uncork()?
+
+    void send_pending();  //!< Queues any pending Ethernet frames on the transmit ring
+
+  public:
+    //! Construct from an XDPSocketFD
+    explicit TCPOverIPv4OverXDPAdapter(XDPSocketFD &&xsk,
+                                       const EthernetAddress &eth_address,
+                                       const Address &ip_address,
+                                       const Address &next_hop);
+
+    //! Attempts to read and parse an Ethernet frame containing an IPv4 datagram that contains a TCP segment
+    std::optional<TCPSegment> read();
+
+    //! Sends a TCP segment (in an IPv4 datagram, in an Ethernet frame).
+    void write(TCPSegment &seg);
+
+    //! Called periodically when time elapses
+    void tick(const size_t ms_since_last_tick);
+
+    //! Frames the kernel has already placed on the receive ring
+    size_t buffered_reads() const { return _xsk.buffered_frames(); }
+
+    //! Hold back frames on the transmit ring until uncork()
+    void cork() { _corked = true; }
+
+    //! Send every frame written since cork()
+    void uncork();
+
+    //! Access the underlying AF_XDP socket
+    operator XDPSocketFD &() { return _xsk; }
+
+    //! Access the underlying AF_XDP socket
+    operator const XDPSocketFD &() const { return _xsk; }
+};
+
+#endif  // SPONGE_LIBSPONGE_XDP_ADAPTER_HH
@@ -10,27 +10,53 @@ void DUMMY_CODE(Targs &&... /* unused */) {}
 
 using namespace std;
 
-void TCPReceiver::segment_received(const TCPSegment &seg) {
+bool TCPReceiver::segment_received(const TCPSegment &seg) {
     const TCPHeader &header = seg.header();
+    ByteStream &stream = _reassembler.stream_out();
 
-    // 当包含 SYN 的 Segment 没有到来前，其他的 Segment 都会被遗弃
-    // 包含 SYN 的 Segment 到来后，设置 isn = seqno
-    if (!_set_syn) {
-        if (!header.syn) {
-            return;
-        }
-        _isn = header.seqno;
-        _set_syn = true;
+    // 当包含 SYN 的 Segment 没有到来前，其他的 Segment 都会被遗弃（校验和错误的仍然报告为错误）
+    if (!_set_syn && !header.syn) {
+        return seg.verify_payload();
     }
 
+    // 校验和错误的 Segment 在改变任何状态之前被丢弃，所以先只计算出 stream index：
+    // 包含 SYN 的 Segment 到来后，isn = seqno
+    const WrappingInt32 isn = _set_syn ? _isn : header.seqno;
     // 根据 bytestream 写出的字节数 + 1（还要计算开头的 SYN），得到 checkpoint，即 Accept 的最后一个字节的 absolute
     // index
-    uint64_t abs_ackno = _reassembler.stream_out().bytes_written() + 1;
+    uint64_t abs_ackno = stream.bytes_written() + 1;
     // 根据 checkpoint、seqno 和 isn 计算得到 absolute seqno
-    uint64_t abs_seqno = unwrap(header.seqno, _isn, abs_ackno);
+    uint64_t abs_seqno = unwrap(header.seqno, isn, abs_ackno);
     // 根据 absolute seqno 计算 stream index
     uint64_t stream_index = abs_seqno - 1 + (header.syn);
-    _reassembler.push_substring(seg.payload().copy(), stream_index, header.fin);
+
+    // 最常见的情况：Segment 从 bytestream 期待的下一个字节（或更早）开始，且新的字节全部放得进 bytestream 的空闲空间。
+    // 此时载荷直接复制进 bytestream 的存储，同时完成校验和的验证（载荷的每个字节只读取、复制一次）；
+    // 校验和错误时这些字节不会被提交。已经收到 FIN 之后，FIN 之后的字节不属于这个流，不能走这条路径
+    const size_t payload_size = seg.payload().size();
+    const uint64_t next_index = stream.bytes_written();
+    if (!stream.input_ended() && stream_index <= next_index && stream.remaining_capacity() > 0) {
+        const size_t offset = min<uint64_t>(next_index - stream_index, payload_size);
+        if (payload_size - offset <= stream.remaining_capacity()) {
+            const auto space = stream.free_space();
+            if (!seg.copy_payload(space.data(), space.size(), offset)) {
+                return false;
+            }
+            _isn = isn;
+            _set_syn = true;
+            _reassembler.push_written(payload_size - offset, header.fin);
+            return true;
+        }
+    }
+
+    // 其他情况（乱序到达，或超出空闲空间）：先验证校验和，再由 reassembler 复制需要保存的部分
+    if (!seg.verify_payload()) {
+        return false;
+    }
+    _isn = isn;
+    _set_syn = true;
+    _reassembler.push_substring(seg.payload().str(), stream_index, header.fin);
+    return true;
 }
 
 optional<WrappingInt32> TCPReceiver::ackno() const {
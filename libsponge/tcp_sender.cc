@@ -49,7 +49,9 @@ void TCPSender::fill_window() {
         // 字节，尽可能多传，但是不能超过 MAX_PAYLOAD_SIZE 然后从 Bytestream_In 中读取发送的字节流
         const size_t payload_size =
             min(TCPConfig::MAX_PAYLOAD_SIZE, curr_window_size - _outgoing_size - segment.header().syn);
-        string payload = _stream.read(payload_size);
+        // 直接读进缓冲池的内存，并在前面留出各层头部的空间，以便序列化时就地添加头部
+        Buffer payload = Buffer::allocate(min(payload_size, _stream.buffer_size()), Buffer::DEFAULT_HEADROOM);
+        _stream.read(payload.mutable_data(), payload.size());
 
         // 如果未发送最后一个 Segment (FIN Segment) 且 Bytestream_In 已经读取了所有要发送的字节 且 Segment 的 Payload
         // 中还有位置容纳 FIN 字节，附加 FIN 标志
@@ -59,7 +61,7 @@ void TCPSender::fill_window() {
         }
 
         // Segment 设置 Payload
-        segment.payload() = Buffer(move(payload));
+        segment.payload() = move(payload);
 
         // 如果 Segment 的 Payload 为空代表目前没有字节需要发送，则退出
         if (segment.length_in_sequence_space() == 0)
@@ -0,0 +1,262 @@
+#include "threaded_router.hh"
+
+#include "util.hh"
+
+#include <cerrno>
+#include <chrono>
+#include <poll.h>
+#include <stdexcept>
+
+using namespace std;
+
+size_t ThreadedRouter::add_interface(AsyncNetworkInterface &&interface) {
+    if (_running.load()) {
+        throw runtime_error("ThreadedRouter: cannot add an interface while running");
+    }
+    _ports.push_back(make_unique<Port>(move(interface)));
+    return _ports.size() - 1;
+}
+
+//! \details Runs `update` on a copy of the current table and, if it returns `true`, publishes the copy.
+//! Readers see either the old table or the new one; the old one is freed once every running worker has
+//! begun a new pass of its loop (a quiescent state), after which none can still hold a reference to it.
+template <typename Update>
+bool ThreadedRouter::update_route_table(Update &&update) {
+    lock_guard<mutex> lock(_update_mutex);
+
+    auto updated = make_unique<ForwardingTable>(*_route_table_owner);
+    if (not update(*updated)) {
+        return false;
+    }
+    _route_table.store(updated.get());
+    const uint64_t epoch = _epoch.fetch_add(1) + 1;
+    for (const auto &port : _ports) {
+        wake(*port);
+    }
+
+    // wait for a quiescent state of every worker (stopped workers record UINT64_MAX)
+    for (const auto &port : _ports) {
+        while (port->quiescent_epoch.load() < epoch) {
+            this_thread::yield();
+        }
+    }
+    _route_table_owner = move(updated);
+    return true;
+}
+
+void ThreadedRouter::add_route(const uint32_t route_prefix,
+                               const uint8_t prefix_length,
+                               const optional<Address> next_hop,
+                               const size_t interface_num) {
+    update_route_table([&](ForwardingTable &table) {
+        table.add_route({route_prefix, prefix_length, next_hop, interface_num});
+        return true;
+    });
+}
+
+bool ThreadedRouter::remove_route(const uint32_t route_prefix, const uint8_t prefix_length) {
+    return update_route_table(
+        [&](ForwardingTable &table) { return table.remove_route(route_prefix, prefix_length); });
+}
+
+void ThreadedRouter::start() {
+    if (_running.exchange(true)) {
+        throw runtime_error("ThreadedRouter: already running");
+    }
+
+    // one ring for each (sending worker, receiving worker) pair keeps every ring single-producer
+    for (auto &port : _ports) {
+        port->forwarded_to.assign(_ports.size(), false);
+        port->forwarded_in.clear();
+        for (size_t i = 0; i < _ports.size(); i++) {
+            port->forwarded_in.push_back(make_unique<SpscRing<Forwarded>>(FORWARD_RING_CAPACITY));
+        }
+    }
+
+    for (size_t i = 0; i < _ports.size(); i++) {
+        _ports[i]->quiescent_epoch.store(_epoch.load());
+        _ports[i]->worker = thread(&ThreadedRouter::work, this, i);
+    }
+}
+
+void ThreadedRouter::stop() {
+    _running.store(false);
+    for (auto &port : _ports) {
+        wake(*port);
+    }
+    for (auto &port : _ports) {
+        if (port->worker.joinable()) {
+            port->worker.join();
+        }
+    }
+}
+
+bool ThreadedRouter::deliver_frame(const size_t N, EthernetFrame &&frame) {
+    Port &port = *_ports.at(N);
+    if (not port.frames_in.push(move(frame))) {
+        return false;
+    }
+    wake(port);
+    return true;
+}
+
+optional<EthernetFrame> ThreadedRouter::take_frame(const size_t N) {
+    Port &port = *_ports.at(N);
+    EthernetFrame frame;
+    if (not port.frames_out.pop(frame)) {
+        return {};
+    }
+    // the worker may be waiting for room to hand over more frames
+    wake(port);
+    return frame;
+}
+
+//! \details Reads everything whose change comes with a wake(): the worker's inbound rings, the route table
+//! epoch and the running flag, plus whether frames are waiting for room in its outbound ring.
+bool ThreadedRouter::has_work(Port &port) const {
+    if (not _running.load() or _epoch.load() != port.quiescent_epoch.load(memory_order_relaxed)) {
+        return true;
+    }
+    if (port.frames_in.size() > 0) {
+        return true;
+    }
+    for (const auto &ring : port.forwarded_in) {
+        if (ring->size() > 0) {
+            return true;
+        }
+    }
+    return not port.interface.frames_out().empty() and port.frames_out.size() < port.frames_out.capacity();
+}
+
+//! \details The worker announces that it is going to sleep before checking for work one last time, and a
+//! producer makes its work visible before checking whether the worker sleeps. With a full fence between the
+//! two steps on each side, at least one of them sees the other: either the worker finds the work and does
+//! not sleep, or the producer finds the worker asleep and notifies the doorbell.
+void ThreadedRouter::sleep(Port &port) {
+    port.sleeping.store(true);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (not has_work(port)) {
+        pollfd pfd{port.doorbell.fd_num(), POLLIN, 0};
+        SystemCall("poll", ::poll(&pfd, 1, IDLE_TIMEOUT_MS), EINTR);
+    }
+    port.sleeping.store(false);
+    port.doorbell.clear();
+}
+
+//! \details Only the caller that finds the worker sleeping (and marks it awake) notifies the doorbell, so
+//! one sleep costs at most one notification however many producers there are.
+void ThreadedRouter::wake(Port &port) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (port.sleeping.load(memory_order_relaxed) and port.sleeping.exchange(false)) {
+        port.doorbell.notify();
+    }
+}
+
+//! \param[in] index the interface whose received datagrams to route
+//! \param[in] route_table the table the worker is reading during this pass
+void ThreadedRouter::forward(const size_t index, const ForwardingTable &route_table) {
+    Port &port = *_ports[index];
+    auto &queue = port.interface.unparsed_datagrams_out();
+
+    // as in Router::route_batch, but each datagram goes to the outbound interface's worker instead of being sent
+    for (size_t count = 0; count < BATCH_SIZE and not queue.empty(); count++, queue.pop()) {
+        IPv4DatagramView dgram;
+        if (dgram.parse(queue.front()) != ParseResult::NoError) {
+            continue;
+        }
+        const uint32_t dst_ip_addr = dgram.dst();
+        const optional<size_t> match = port.flow_cache.lookup(route_table, dst_ip_addr);
+        if (not match.has_value() or dgram.ttl() <= 1) {
+            continue;
+        }
+        const ForwardingTable::Route &match_entry = route_table.route(match.value());
+        if (match_entry.interface_idx >= _ports.size()) {
+            continue;
+        }
+        dgram.decrement_ttl();
+        const uint32_t next_hop_ip =
+            match_entry.next_hop.has_value() ? match_entry.next_hop->ipv4_numeric() : dst_ip_addr;
+
+        // drop the datagram if that worker is too far behind, as a full NIC queue would
+        Forwarded forwarded{move(dgram), next_hop_ip};
+        if (_ports[match_entry.interface_idx]->forwarded_in[index]->push(move(forwarded))) {
+            port.forwarded_to[match_entry.interface_idx] = true;
+        } else {
+            port.dropped.fetch_add(1, memory_order_relaxed);
+        }
+    }
+
+    // one wake-up per outbound worker and batch, rather than per datagram
+    for (size_t i = 0; i < _ports.size(); i++) {
+        if (port.forwarded_to[i]) {
+            port.forwarded_to[i] = false;
+            if (i != index) {
+                wake(*_ports[i]);
+            }
+        }
+    }
+}
+
+//! \param[in] index the interface this worker services
+void ThreadedRouter::work(const size_t index) {
+    Port &port = *_ports[index];
+    const ForwardingTable *last_route_table = nullptr;
+    vector<Forwarded> batch;
+    batch.reserve(BATCH_SIZE * _ports.size());
+    EthernetFrame frame;
+    auto last_tick = chrono::steady_clock::now();
+
+    while (_running.load(memory_order_relaxed)) {
+        bool busy = false;
+
+        // quiescent state: nothing read from the route table during the previous pass is still in use
+        port.quiescent_epoch.store(_epoch.load());
+        const ForwardingTable *route_table = _route_table.load();
+        if (route_table != last_route_table) {
+            port.flow_cache.invalidate();
+            last_route_table = route_table;
+        }
+
+        // receive frames and route the datagrams in them
+        for (size_t count = 0; count < BATCH_SIZE and port.frames_in.pop(frame); count++) {
+            port.interface.recv_frame(frame);
+            busy = true;
+        }
+        forward(index, *route_table);
+
+        // send the datagrams that workers (including this one) have routed to this interface
+        for (const auto &ring : port.forwarded_in) {
+            Forwarded forwarded;
+            for (size_t count = 0; count < BATCH_SIZE and ring->pop(forwarded); count++) {
+                batch.push_back(move(forwarded));
+            }
+        }
+        if (not batch.empty()) {
+            port.interface.send_datagrams(batch);
+            batch.clear();
+            busy = true;
+        }
+
+        // hand outgoing frames to the owner; if the ring is full, they wait for the next pass
+        auto &frames_out = port.interface.frames_out();
+        while (not frames_out.empty() and port.frames_out.push(move(frames_out.front()))) {
+            frames_out.pop();
+            busy = true;
+        }
+
+        // ARP cache expiry and request retransmission
+        const auto now = chrono::steady_clock::now();
+        const auto ms_since_last_tick = chrono::duration_cast<chrono::milliseconds>(now - last_tick);
+        if (ms_since_last_tick.count() > 0) {
+            port.interface.tick(ms_since_last_tick.count());
+            last_tick += ms_since_last_tick;
+        }
+
+        if (not busy) {
+            sleep(port);
+        }
+    }
+
+    // a stopped worker reads no route table, so updates need not wait for it
+    port.quiescent_epoch.store(UINT64_MAX);
+}
@@ -0,0 +1,147 @@
+#ifndef SPONGE_LIBSPONGE_THREADED_ROUTER_HH
+#define SPONGE_LIBSPONGE_THREADED_ROUTER_HH
+
+#include "event_fd.hh"
+#include "forwarding_table.hh"
+#include "router.hh"
+#include "spsc_ring.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//! \brief A router that services each of its network interfaces on a worker thread of its own
+//! \details Each interface is only ever touched by its own worker. Frames reach a worker, and leave it,
+//! through lock-free single-producer/single-consumer rings. A worker parses and routes the datagrams
+//! its interface receives, and passes each one to the worker of the outbound interface over a ring
+//! dedicated to that pair of workers. The outbound worker then sends its datagrams in batches.
+//!
+//! The route table is shared by all the workers in read-copy-update style. Workers read the current
+//! table without locking. An update copies the table, changes the copy and publishes it. The old table
+//! is freed only after every worker has started a new pass of its loop, because from then on none of
+//! them can still be reading it. Each worker keeps a FlowCache of its own, and empties it when it
+//! picks up a new table.
+//!
+//! A worker that finds nothing to do sleeps in [poll(2)](\ref man2::poll) on an eventfd of its own. Whoever
+//! gives it work (a frame, a routed datagram, room in its outbound ring, a route update or a stop request)
+//! notifies the eventfd, but only if the worker has said it is going to sleep, so a busy worker costs
+//! its producers no system calls.
+class ThreadedRouter {
+  public:
+    //! Slots in each ring of frames to or from an interface
+    static constexpr size_t FRAME_RING_CAPACITY = 1024;
+
+    //! Slots in each ring of datagrams from one worker to another
+    static constexpr size_t FORWARD_RING_CAPACITY = 256;
+
+    //! Most frames or datagrams a worker handles in one step before checking its other work
+    static constexpr size_t BATCH_SIZE = 32;
+
+    //! Longest an idle worker sleeps before it runs its interface's timers (ARP expiry and retransmission)
+    static constexpr int IDLE_TIMEOUT_MS = 100;
+
+  private:
+    //! A routed datagram and the raw IP address of its next hop
+    using Forwarded = std::pair<IPv4DatagramView, uint32_t>;
+
+    //! An interface and everything its worker owns
+    struct Port {
+        AsyncNetworkInterface interface;
+        SpscRing<EthernetFrame> frames_in{FRAME_RING_CAPACITY};   //!< from the owner to the worker
+        SpscRing<EthernetFrame> frames_out{FRAME_RING_CAPACITY};  //!< from the worker to the owner
+        std::vector<std::unique_ptr<SpscRing<Forwarded>>> forwarded_in{};  //!< from each worker, by its index
+        FlowCache flow_cache{};
+        std::atomic<uint64_t> quiescent_epoch{UINT64_MAX};  //!< `_epoch` when the worker's pass began
+        std::atomic<uint64_t> dropped{0};                   //!< datagrams dropped because a ring was full
+        std::vector<bool> forwarded_to{};                   //!< workers given datagrams in this pass, by index
+        EventFD doorbell{};                                 //!< wakes the worker while it sleeps
+        std::atomic<bool> sleeping{false};                  //!< the worker is (about to be) waiting on `doorbell`
+        std::thread worker{};
+
+        explicit Port(AsyncNetworkInterface &&iface) : interface(std::move(iface)) {}
+    };
+
+    std::vector<std::unique_ptr<Port>> _ports{};
+
+    //! The route table that workers read
+    std::atomic<const ForwardingTable *> _route_table{nullptr};
+
+    //! Owns `_route_table`; only replaced (under `_update_mutex`) once no worker can still be reading it
+    std::unique_ptr<const ForwardingTable> _route_table_owner{std::make_unique<const ForwardingTable>()};
+
+    //! Serializes route table updates
+    std::mutex _update_mutex{};
+
+    //! Counts route table updates; workers record it at the start of each pass of their loop
+    std::atomic<uint64_t> _epoch{0};
+
+    std::atomic<bool> _running{false};
+
+    //! The loop run by the worker of interface `index`
+    void work(const size_t index);
+
+    //! Route the datagrams that interface `index` has received, handing them to the outbound workers
+    void forward(const size_t index, const ForwardingTable &route_table);
+
+    //! Whether the worker of `port` has anything to do
+    bool has_work(Port &port) const;
+
+    //! Block the worker of `port` until it is woken, or for at most IDLE_TIMEOUT_MS
+    void sleep(Port &port);
+
+    //! Wake the worker of `port` if it is sleeping; called after giving it work
+    static void wake(Port &port);
+
+    //! Publish a modified copy of the route table, then wait until the old one is no longer in use
+    template <typename Update>
+    bool update_route_table(Update &&update);
+
+  public:
+    ThreadedRouter() { _route_table.store(_route_table_owner.get()); }
+    ~ThreadedRouter() { stop(); }
+
+    //! \name No copying or moving: the workers refer to the router
+    //!@{
+    ThreadedRouter(const ThreadedRouter &other) = delete;
+    ThreadedRouter &operator=(const ThreadedRouter &other) = delete;
+    //!@}
+
+    //! \brief Add an interface to the router (only before start())
+    //! \returns The index of the interface after it has been added to the router
+    size_t add_interface(AsyncNetworkInterface &&interface);
+
+    //! Add a route (a forwarding rule), replacing any route for the same prefix; may be called while running
+    void add_route(const uint32_t route_prefix,
+                   const uint8_t prefix_length,
+                   const std::optional<Address> next_hop,
+                   const size_t interface_num);
+
+    //! \brief Remove the route for a prefix; may be called while running
+    //! \returns `true` if there was such a route
+    bool remove_route(const uint32_t route_prefix, const uint8_t prefix_length);
+
+    //! Start a worker thread for each interface
+    void start();
+
+    //! Stop and join the worker threads
+    void stop();
+
+    //! \brief Hand a received frame to an interface's worker
+    //! \note For each interface, only one thread at a time may call this
+    //! \returns `false` (dropping the frame) if the worker is too far behind
+    bool deliver_frame(const size_t N, EthernetFrame &&frame);
+
+    //! \brief Take the next frame an interface wants sent
+    //! \note For each interface, only one thread at a time may call this
+    std::optional<EthernetFrame> take_frame(const size_t N);
+
+    //! Number of datagrams received on interface `N` and dropped because the outbound worker was too far behind
+    uint64_t dropped(const size_t N) const { return _ports.at(N)->dropped.load(std::memory_order_relaxed); }
+};
+
+#endif  // SPONGE_LIBSPONGE_THREADED_ROUTER_HH
@@ -2,12 +2,58 @@
 
 using namespace std;
 
+Buffer::Buffer(string &&str) : _storage(), _starting_offset(0), _length(str.size()) {
+    if (_length > 0) {
+        _storage = BlockRef(BufferPool::adopt_string(move(str)));
+    }
+}
+
+Buffer Buffer::allocate(const size_t size, const size_t headroom) {
+    Buffer ret;
+    if (size > 0) {
+        ret._storage = BlockRef(BufferPool::allocate(headroom + size));
+        ret._storage->set_front(headroom);
+        ret._starting_offset = headroom;
+        ret._length = size;
+    }
+    return ret;
+}
+
+Buffer Buffer::adopt(BlockRef &&storage, const size_t size) {
+    Buffer ret;
+    if (size > 0) {
+        ret._storage = move(storage);
+        ret._length = size;
+    }
+    return ret;
+}
+
+char *Buffer::expand_front(const size_t n) {
+    if (not _storage or not _storage->claim_front(_starting_offset, n)) {
+        return nullptr;
+    }
+    _starting_offset -= n;
+    _length += n;
+    return mutable_data();
+}
+
 void Buffer::remove_prefix(const size_t n) {
     if (n > str().size()) {
         throw out_of_range("Buffer::remove_prefix");
     }
     _starting_offset += n;
-    if (_storage and _starting_offset == _storage->size()) {
+    _length -= n;
+    if (_storage and _length == 0) {
+        _storage.reset();
+    }
+}
+
+void Buffer::remove_suffix(const size_t n) {
+    if (n > str().size()) {
+        throw out_of_range("Buffer::remove_suffix");
+    }
+    _length -= n;
+    if (_storage and _length == 0) {
         _storage.reset();
     }
 }
@@ -16,6 +62,23 @@ void BufferList::append(const BufferList &other) {
     for (const auto &buf : other._buffers) {
         _buffers.push_back(buf);
     }
+    _size += other._size;
+}
+
+char *BufferList::prepend(const size_t n) {
+    if (not _buffers.empty() and _buffers.front().size() == 0) {
+        _buffers.erase_front(1);
+    }
+    _size += n;
+    if (not _buffers.empty()) {
+        char *const in_place = _buffers.front().expand_front(n);
+        if (in_place) {
+            return in_place;
+        }
+    }
+
+    _buffers.push_front(Buffer::allocate(n, Buffer::DEFAULT_HEADROOM));
+    return _buffers.front().mutable_data();
 }
 
 BufferList::operator Buffer() const {
@@ -40,63 +103,54 @@ string BufferList::concatenate() const {
     return ret;
 }
 
-size_t BufferList::size() const {
-    size_t ret = 0;
-    for (const auto &buf : _buffers) {
-        ret += buf.size();
+void BufferList::remove_prefix(size_t n) {
+    if (n > _size) {
+        throw std::out_of_range("BufferList::remove_prefix");
     }
-    return ret;
-}
+    _size -= n;
 
-void BufferList::remove_prefix(size_t n) {
+    size_t emptied = 0;
     while (n > 0) {
-        if (_buffers.empty()) {
-            throw std::out_of_range("BufferList::remove_prefix");
-        }
-
-        if (n < _buffers.front().str().size()) {
-            _buffers.front().remove_prefix(n);
+        Buffer &buf = _buffers[emptied];
+        if (n < buf.size()) {
+            buf.remove_prefix(n);
             n = 0;
         } else {
-            n -= _buffers.front().str().size();
-            _buffers.pop_front();
+            n -= buf.size();
+            emptied++;
         }
     }
+    _buffers.erase_front(emptied);
 }
 
-BufferViewList::BufferViewList(const BufferList &buffers) {
+BufferViewList::BufferViewList(const BufferList &buffers) : _size(buffers.size()) {
     for (const auto &x : buffers.buffers()) {
         _views.push_back(x);
     }
 }
 
 void BufferViewList::remove_prefix(size_t n) {
-    while (n > 0) {
-        if (_views.empty()) {
-            throw std::out_of_range("BufferListView::remove_prefix");
-        }
+    if (n > _size) {
+        throw std::out_of_range("BufferListView::remove_prefix");
+    }
+    _size -= n;
 
-        if (n < _views.front().size()) {
-            _views.front().remove_prefix(n);
+    size_t emptied = 0;
+    while (n > 0) {
+        string_view &view = _views[emptied];
+        if (n < view.size()) {
+            view.remove_prefix(n);
             n = 0;
         } else {
-            n -= _views.front().size();
-            _views.pop_front();
+            n -= view.size();
+            emptied++;
         }
     }
+    _views.erase_front(emptied);
 }
 
-size_t BufferViewList::size() const {
-    size_t ret = 0;
-    for (const auto &buf : _views) {
-        ret += buf.size();
-    }
-    return ret;
-}
-
-vector<iovec> BufferViewList::as_iovecs() const {
-    vector<iovec> ret;
-    ret.reserve(_views.size());
+SmallVector<iovec, INLINE_BUFFER_COUNT> BufferViewList::as_iovecs() const {
+    SmallVector<iovec, INLINE_BUFFER_COUNT> ret;
     for (const auto &x : _views) {
         ret.push_back({const_cast<char *>(x.data()), x.size()});
     }
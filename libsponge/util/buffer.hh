@@ -1,8 +1,10 @@
 #ifndef SPONGE_LIBSPONGE_BUFFER_HH
 #define SPONGE_LIBSPONGE_BUFFER_HH
 
+#include "buffer_pool.hh"
+#include "small_vector.hh"
+
 #include <algorithm>
-#include <deque>
 #include <memory>
 #include <numeric>
 #include <stdexcept>
@@ -12,16 +14,42 @@
 #include <vector>
 
 //! \brief A reference-counted read-only string that can discard bytes from the front
+//! \details The bytes live in a BufferBlock drawn from the BufferPool, except that a Buffer constructed
+//! from a std::string keeps the string's own bytes.
 class Buffer {
   private:
-    std::shared_ptr<std::string> _storage{};
+    BlockRef _storage{};
     size_t _starting_offset{};
+    size_t _length{};
 
   public:
+    //! Free space reserved in front of new outgoing data, enough for TCP, IPv4 and Ethernet headers
+    static constexpr size_t DEFAULT_HEADROOM = 128;
+
     Buffer() = default;
 
-    //! \brief Construct by taking ownership of a string
-    Buffer(std::string &&str) noexcept : _storage(std::make_shared<std::string>(std::move(str))) {}
+    //! \brief Construct from the contents of a string, taking over the string rather than copying it
+    //! \note The result has no headroom. Data that is about to be sent is better written straight into
+    //! a Buffer from allocate(), with DEFAULT_HEADROOM for its headers.
+    Buffer(std::string &&str);
+
+    //! \brief Allocate a Buffer of `size` uninitialized bytes from the BufferPool
+    //! \details Fill it through mutable_data(), then trim any unused tail with remove_suffix().
+    //! The first `headroom` bytes of the block are left free for expand_front().
+    static Buffer allocate(const size_t size, const size_t headroom = 0);
+
+    //! \brief Wrap the first `size` bytes of a block (e.g. one from BufferPool::place()), taking its reference
+    static Buffer adopt(BlockRef &&storage, const size_t size);
+
+    //! \brief Grow the Buffer by `n` bytes at the front, using free headroom in the same block
+    //! \returns a pointer to the `n` new (uninitialized) bytes, or nullptr if they are unavailable
+    //! \details Only one Buffer can claim any given byte of headroom, so this is safe even when the
+    //! block is shared: a copy that tries to claim headroom that is already taken gets nullptr.
+    char *expand_front(const size_t n);
+
+    //! \brief Writable access to the contents
+    //! \note Only valid while no other Buffer shares the storage (e.g. straight after allocate()).
+    char *mutable_data() { return _storage ? _storage->data() + _starting_offset : nullptr; }
 
     //! \name Expose contents as a std::string_view
     //!@{
@@ -29,7 +57,7 @@ class Buffer {
         if (not _storage) {
             return {};
         }
-        return {_storage->data() + _starting_offset, _storage->size() - _starting_offset};
+        return {_storage->data() + _starting_offset, _length};
     }
 
     operator std::string_view() const { return str(); }
@@ -47,8 +75,16 @@ class Buffer {
     //! \brief Discard the first `n` bytes of the string (does not require a copy or move)
     //! \note Doesn't free any memory until the whole string has been discarded in all copies of the Buffer.
     void remove_prefix(const size_t n);
+
+    //! \brief Discard the last `n` bytes of the string (does not require a copy or move)
+    //! \note Together with remove_prefix(), this lets several Buffers share slices of one allocation.
+    void remove_suffix(const size_t n);
 };
 
+//! Number of pieces a BufferList or BufferViewList holds before it needs a heap allocation
+//! (a payload plus a separately-allocated header or two)
+static constexpr size_t INLINE_BUFFER_COUNT = 4;
+
 //! \brief A reference-counted discontiguous string that can discard bytes from the front
 //! \note Used to model packets that contain multiple sets of headers
 //! + a payload. This allows us to prepend headers (e.g., to
@@ -56,7 +92,8 @@ class Buffer {
 //! the TCPSegment in an IPv4Datagram) without copying the payload.
 class BufferList {
   private:
-    std::deque<Buffer> _buffers{};
+    SmallVector<Buffer, INLINE_BUFFER_COUNT> _buffers{};
+    size_t _size{0};  //!< total length of `_buffers`
 
   public:
     //! \name Constructors
@@ -65,21 +102,24 @@ class BufferList {
     BufferList() = default;
 
     //! \brief Construct from a Buffer
-    BufferList(Buffer buffer) : _buffers{buffer} {}
+    BufferList(Buffer buffer) : _size(buffer.size()) { _buffers.push_back(std::move(buffer)); }
 
-    //! \brief Construct by taking ownership of a std::string
-    BufferList(std::string &&str) noexcept {
-        Buffer buf{std::move(str)};
-        append(buf);
-    }
+    //! \brief Construct from the contents of a std::string
+    BufferList(std::string &&str) : BufferList(Buffer{std::move(str)}) {}
     //!@}
 
-    //! \brief Access the underlying queue of Buffers
-    const std::deque<Buffer> &buffers() const { return _buffers; }
+    //! \brief Access the underlying sequence of Buffers
+    const SmallVector<Buffer, INLINE_BUFFER_COUNT> &buffers() const { return _buffers; }
 
     //! \brief Append a BufferList
     void append(const BufferList &other);
 
+    //! \brief Make room for `n` bytes at the front (e.g. for a protocol header)
+    //! \returns a pointer to the `n` new bytes, which the caller must fill in
+    //! \details The bytes are taken from the first Buffer's headroom when possible, so headers
+    //! prepended layer by layer end up contiguous with the payload; otherwise a new Buffer is added.
+    char *prepend(const size_t n);
+
     //! \brief Transform to a Buffer
     //! \note Throws an exception unless BufferList is contiguous
     operator Buffer() const;
@@ -88,7 +128,7 @@ class BufferList {
     void remove_prefix(size_t n);
 
     //! \brief Size of the string
-    size_t size() const;
+    size_t size() const { return _size; }
 
     //! \brief Make a copy to a new std::string
     std::string concatenate() const;
@@ -96,7 +136,8 @@ class BufferList {
 
 //! \brief A non-owning temporary view (similar to std::string_view) of a discontiguous string
 class BufferViewList {
-    std::deque<std::string_view> _views{};
+    SmallVector<std::string_view, INLINE_BUFFER_COUNT> _views{};
+    size_t _size{0};  //!< total length of `_views`
 
   public:
     //! \name Constructors
@@ -112,19 +153,19 @@ class BufferViewList {
     BufferViewList(const BufferList &buffers);
 
     //! \brief Construct from a std::string_view
-    BufferViewList(std::string_view str) { _views.push_back({const_cast<char *>(str.data()), str.size()}); }
+    BufferViewList(std::string_view str) : _size(str.size()) { _views.push_back(str); }
     //!@}
 
     //! \brief Discard the first `n` bytes of the string (does not require a copy or move)
     void remove_prefix(size_t n);
 
     //! \brief Size of the string
-    size_t size() const;
+    size_t size() const { return _size; }
 
-    //! \brief Convert to a vector of `iovec` structures
+    //! \brief Convert to a sequence of `iovec` structures (allocation-free for up to INLINE_BUFFER_COUNT pieces)
     //! \note used for system calls that write discontiguous buffers,
     //! e.g. [writev(2)](\ref man2::writev) and [sendmsg(2)](\ref man2::sendmsg)
-    std::vector<iovec> as_iovecs() const;
+    SmallVector<iovec, INLINE_BUFFER_COUNT> as_iovecs() const;
 };
 
 #endif  // SPONGE_LIBSPONGE_BUFFER_HH
@@ -0,0 +1,205 @@
+#include "buffer_pool.hh"
+
+#include <array>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+//! Geometry of one pool size class
+struct SizeClass {
+    size_t block_size;       //!< usable bytes per block
+    size_t blocks_per_slab;  //!< blocks carved from each slab
+    size_t cache_limit;      //!< a thread's free list spills to the shared list beyond this many blocks
+};
+
+constexpr array<SizeClass, 2> SIZE_CLASSES{
+    {{BufferPool::SMALL_BLOCK_SIZE, 128, 256}, {BufferPool::LARGE_BLOCK_SIZE, 16, 64}}};
+
+//! Number of blocks moved between a thread's free list and the shared list at a time
+constexpr size_t TRANSFER_BATCH = 64;
+
+using FreeLists = array<vector<BufferBlock *>, SIZE_CLASSES.size()>;
+
+//! State shared by all threads
+struct SharedPool {
+    mutex lock{};            //!< protects `free_lists`
+    FreeLists free_lists{};  //!< blocks not cached by any thread
+
+    atomic<uint64_t> hits{0};
+    atomic<uint64_t> misses{0};
+    atomic<uint64_t> slabs{0};
+};
+
+//! The shared pool is deliberately never destroyed, so Buffers that outlive static destruction can still be freed
+SharedPool &shared_pool() {
+    static SharedPool *const pool = new SharedPool;
+    return *pool;
+}
+
+//! Move up to `count` blocks from the back of `from` to `to`
+void transfer(vector<BufferBlock *> &from, vector<BufferBlock *> &to, const size_t count) {
+    const size_t n = min(count, from.size());
+    to.insert(to.end(), from.end() - n, from.end());
+    from.resize(from.size() - n);
+}
+
+//! A thread's private free lists; flushed to the shared pool when the thread exits
+struct ThreadCache {
+    FreeLists free_lists{};
+
+    ThreadCache() = default;
+    ThreadCache(const ThreadCache &other) = delete;
+    ThreadCache &operator=(const ThreadCache &other) = delete;
+
+    ~ThreadCache();
+};
+
+// The cache itself has a non-trivial destructor, so it is reached through a plain pointer that
+// is cleared when the cache is destroyed. Blocks released after that go straight to the shared pool.
+thread_local ThreadCache *current_cache = nullptr;
+thread_local bool cache_destroyed = false;
+
+ThreadCache::~ThreadCache() {
+    current_cache = nullptr;
+    cache_destroyed = true;
+
+    auto &pool = shared_pool();
+    lock_guard<mutex> guard(pool.lock);
+    for (size_t i = 0; i < free_lists.size(); i++) {
+        transfer(free_lists[i], pool.free_lists[i], free_lists[i].size());
+    }
+}
+
+//! \returns this thread's cache, or nullptr while the thread is exiting
+ThreadCache *thread_cache() {
+    if (current_cache == nullptr and not cache_destroyed) {
+        thread_local ThreadCache cache;
+        current_cache = &cache;
+    }
+    return current_cache;
+}
+
+}  // namespace
+
+//! \param[in] size is the number of bytes needed
+//! \returns a block with a reference count of one; its contents are uninitialized
+BufferBlock *BufferPool::allocate(const size_t size) {
+    auto &pool = shared_pool();
+
+    uint8_t index = 0;
+    while (index < SIZE_CLASSES.size() and SIZE_CLASSES[index].block_size < size) {
+        index++;
+    }
+
+    if (index == SIZE_CLASSES.size()) {
+        pool.misses.fetch_add(1, memory_order_relaxed);
+        return new (::operator new(sizeof(BufferBlock) + size)) BufferBlock(size, HEAP_CLASS);
+    }
+
+    ThreadCache *const cache = thread_cache();
+    vector<BufferBlock *> local;  // stands in for the cache while the thread is exiting
+    vector<BufferBlock *> &free_list = cache ? cache->free_lists[index] : local;
+
+    bool hit = true;
+    if (free_list.empty()) {
+        lock_guard<mutex> guard(pool.lock);
+        transfer(pool.free_lists[index], free_list, TRANSFER_BATCH);
+        if (free_list.empty()) {
+            _carve_slab(index, free_list);
+            hit = false;
+        }
+        if (not cache) {
+            // keep one block and leave the rest to the shared pool
+            transfer(free_list, pool.free_lists[index], free_list.size() - 1);
+        }
+    }
+    (hit ? pool.hits : pool.misses).fetch_add(1, memory_order_relaxed);
+
+    BufferBlock *const block = free_list.back();
+    free_list.pop_back();
+    block->_refcount.store(1, memory_order_relaxed);
+    block->set_front(0);
+    return block;
+}
+
+void BufferPool::_carve_slab(const uint8_t size_class, vector<BufferBlock *> &free_list) {
+    const auto &geometry = SIZE_CLASSES.at(size_class);
+    const size_t stride = sizeof(BufferBlock) + geometry.block_size;
+    char *const slab = static_cast<char *>(::operator new(stride * geometry.blocks_per_slab));
+    for (size_t i = 0; i < geometry.blocks_per_slab; i++) {
+        free_list.push_back(new (slab + i * stride) BufferBlock(geometry.block_size, size_class));
+    }
+    shared_pool().slabs.fetch_add(1, memory_order_relaxed);
+}
+
+//! \param[in] data is where the block's bytes are
+//! \param[in] capacity is the number of bytes
+//! \param[in] owner takes the block back when its reference count drops to zero
+BufferBlock *BufferPool::place(char *data, const size_t capacity, BlockOwner *owner) {
+    static_assert(sizeof(BufferBlock) + sizeof(BlockOwner *) <= PLACEMENT_OVERHEAD);
+    memcpy(data - PLACEMENT_OVERHEAD, &owner, sizeof(owner));
+    return new (data - sizeof(BufferBlock)) BufferBlock(capacity, PLACED_CLASS);
+}
+
+//! \param[in] str is the string whose contents the block takes over
+BufferBlock *BufferPool::adopt_string(string &&str) {
+    static_assert(sizeof(BufferBlock) % alignof(string) == 0);
+    const size_t size = str.size();
+    char *const memory = static_cast<char *>(::operator new(sizeof(BufferBlock) + sizeof(string)));
+    new (memory + sizeof(BufferBlock)) string(move(str));
+    return new (memory) BufferBlock(size, STRING_CLASS);
+}
+
+//! \param[in] block has a reference count of zero
+void BufferPool::_recycle(BufferBlock *block) {
+    if (block->_size_class == PLACED_CLASS) {
+        const char *const data = block->data();
+        BlockOwner *owner = nullptr;
+        memcpy(&owner, data - PLACEMENT_OVERHEAD, sizeof(owner));
+        block->~BufferBlock();
+        owner->release_block(data);
+        return;
+    }
+
+    if (block->_size_class == STRING_CLASS) {
+        launder(reinterpret_cast<string *>(block + 1))->~string();
+        block->~BufferBlock();
+        ::operator delete(block);
+        return;
+    }
+
+    if (block->_size_class == HEAP_CLASS) {
+        block->~BufferBlock();
+        ::operator delete(block);
+        return;
+    }
+
+    ThreadCache *const cache = thread_cache();
+    if (cache) {
+        auto &free_list = cache->free_lists[block->_size_class];
+        free_list.push_back(block);
+        if (free_list.size() <= SIZE_CLASSES[block->_size_class].cache_limit) {
+            return;
+        }
+        auto &pool = shared_pool();
+        lock_guard<mutex> guard(pool.lock);
+        transfer(free_list, pool.free_lists[block->_size_class], TRANSFER_BATCH);
+        return;
+    }
+
+    auto &pool = shared_pool();
+    lock_guard<mutex> guard(pool.lock);
+    pool.free_lists[block->_size_class].push_back(block);
+}
+
+BufferPool::Stats BufferPool::stats() {
+    const auto &pool = shared_pool();
+    return {pool.hits.load(memory_order_relaxed),
+            pool.misses.load(memory_order_relaxed),
+            pool.slabs.load(memory_order_relaxed)};
+}
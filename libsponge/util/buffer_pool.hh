@@ -0,0 +1,197 @@
+#ifndef SPONGE_LIBSPONGE_BUFFER_POOL_HH
+#define SPONGE_LIBSPONGE_BUFFER_POOL_HH
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+//! \brief Owner of BufferBlocks that live in memory outside the pool (see BufferPool::place())
+class BlockOwner {
+  public:
+    //! \brief Take back a placed block whose last reference has been dropped
+    //! \param[in] data is the block's data(), as passed to BufferPool::place()
+    virtual void release_block(const char *data) = 0;
+
+    virtual ~BlockOwner() = default;
+};
+
+//! \brief A block of packet memory with an intrusive reference count
+//! \details The bytes follow the header directly, so a block is a single allocation.
+//! Blocks are handed out by BufferPool and managed through BlockRef.
+class alignas(16) BufferBlock {
+  private:
+    friend class BufferPool;
+
+    std::atomic<uint32_t> _refcount{1};  //!< Number of BlockRefs pointing at this block
+    std::atomic<uint32_t> _front{0};     //!< Offset of the first byte in use; bytes before it are free headroom
+    uint32_t _capacity;                  //!< Number of bytes available after the header
+    uint8_t _size_class;                 //!< Index of the pool size class, or BufferPool::HEAP_CLASS
+
+    BufferBlock(const uint32_t capacity, const uint8_t size_class) : _capacity(capacity), _size_class(size_class) {}
+
+  public:
+    //! \brief The block's bytes
+    char *data();
+
+    //! \brief The block's bytes
+    const char *data() const;
+
+    //! \brief Number of bytes in the block
+    size_t capacity() const { return _capacity; }
+
+    //! \brief Take another reference
+    void retain() { _refcount.fetch_add(1, std::memory_order_relaxed); }
+
+    //! \brief Drop a reference; the block returns to its pool when the last one is dropped
+    void release();
+
+    //! \brief Is this the only reference to the block?
+    bool unique() const { return _refcount.load(std::memory_order_acquire) == 1; }
+
+    //! \brief Mark the bytes before `offset` as free headroom (only while the block is unshared)
+    void set_front(const size_t offset) { _front.store(offset, std::memory_order_relaxed); }
+
+    //! \brief Claim headroom: move the first byte in use from `offset` down to `offset - n`
+    //! \returns `true` if nobody else had already claimed the bytes just before `offset`
+    bool claim_front(const size_t offset, const size_t n) {
+        uint32_t expected = offset;
+        return n <= offset and _front.compare_exchange_strong(expected, offset - n, std::memory_order_acq_rel);
+    }
+};
+
+//! \brief Fixed-size slab allocator for packet memory
+//! \details Requests are rounded up to one of a few size classes. Each class keeps a
+//! free list per thread (no locking on the fast path) backed by a shared free list
+//! that is refilled by carving new slabs. Slabs are never returned to the system.
+//! Requests larger than the largest class are served from the heap.
+class BufferPool {
+  public:
+    //! Block size for anything that fits in one Ethernet frame
+    static constexpr size_t SMALL_BLOCK_SIZE = 2048;
+
+    //! Block size for the largest IP datagram (or a GRO-coalesced train of them) plus link-layer headers
+    static constexpr size_t LARGE_BLOCK_SIZE = 65536 + 512;
+
+    //! BufferBlock::_size_class of blocks that bypass the pool
+    static constexpr uint8_t HEAP_CLASS = 0xff;
+
+    //! BufferBlock::_size_class of blocks placed in memory outside the pool
+    static constexpr uint8_t PLACED_CLASS = 0xfe;
+
+    //! BufferBlock::_size_class of blocks whose bytes are a std::string's (see adopt_string())
+    static constexpr uint8_t STRING_CLASS = 0xfd;
+
+    //! Bytes that place() needs in front of a block's data, for a pointer to the owner and the BufferBlock
+    static constexpr size_t PLACEMENT_OVERHEAD = 32;
+
+    //! Allocation counters, summed over all threads
+    struct Stats {
+        uint64_t hits;    //!< allocations served from a free list
+        uint64_t misses;  //!< allocations that needed a new slab or the heap
+        uint64_t slabs;   //!< slabs carved so far
+    };
+
+    //! \brief Get a block of at least `size` bytes, with a reference count of one
+    static BufferBlock *allocate(const size_t size);
+
+    //! \brief Build a block, with a reference count of one, whose data are `capacity` bytes at `data`
+    //! \details Lets memory that is not the pool's (such as a packet ring shared with the kernel) be passed
+    //! around in Buffers without copying. `data` must be 16-byte aligned, and the PLACEMENT_OVERHEAD bytes in
+    //! front of it are overwritten. When the last reference is dropped, the block goes to `owner`.
+    static BufferBlock *place(char *data, const size_t capacity, BlockOwner *owner);
+
+    //! \brief Build a block, with a reference count of one, whose data are the contents of `str`
+    //! \details The string is moved into a small heap allocation next to the block header, so its
+    //! contents are not copied. The block has no headroom.
+    static BufferBlock *adopt_string(std::string &&str);
+
+    //! \brief Current allocation counters
+    static Stats stats();
+
+  private:
+    friend class BufferBlock;
+
+    //! Carve a new slab for `size_class` and put its blocks on `free_list`
+    static void _carve_slab(const uint8_t size_class, std::vector<BufferBlock *> &free_list);
+
+    //! Return a block whose reference count has dropped to zero
+    static void _recycle(BufferBlock *block);
+};
+
+//! The std::string that holds the bytes of a block of BufferPool::STRING_CLASS sits right after the header
+inline char *BufferBlock::data() {
+    if (_size_class == BufferPool::STRING_CLASS) {
+        return std::launder(reinterpret_cast<std::string *>(this + 1))->data();
+    }
+    return reinterpret_cast<char *>(this + 1);
+}
+
+inline const char *BufferBlock::data() const {
+    if (_size_class == BufferPool::STRING_CLASS) {
+        return std::launder(reinterpret_cast<const std::string *>(this + 1))->data();
+    }
+    return reinterpret_cast<const char *>(this + 1);
+}
+
+inline void BufferBlock::release() {
+    if (_refcount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        BufferPool::_recycle(this);
+    }
+}
+
+//! \brief Owning handle to a BufferBlock (the intrusive counterpart of a std::shared_ptr)
+class BlockRef {
+  private:
+    BufferBlock *_block{nullptr};
+
+  public:
+    BlockRef() = default;
+
+    //! \brief Adopt a block and the reference that comes with it (e.g. from BufferPool::allocate)
+    explicit BlockRef(BufferBlock *block) : _block(block) {}
+
+    ~BlockRef() { reset(); }
+
+    //! \name Copy/move constructor/assignment operators
+    //!@{
+    BlockRef(const BlockRef &other) : _block(other._block) {
+        if (_block) {
+            _block->retain();
+        }
+    }
+    BlockRef(BlockRef &&other) noexcept : _block(std::exchange(other._block, nullptr)) {}
+    BlockRef &operator=(const BlockRef &other) {
+        BlockRef(other).swap(*this);
+        return *this;
+    }
+    BlockRef &operator=(BlockRef &&other) noexcept {
+        BlockRef(std::move(other)).swap(*this);
+        return *this;
+    }
+    //!@}
+
+    //! \brief Exchange with another BlockRef
+    void swap(BlockRef &other) noexcept { std::swap(_block, other._block); }
+
+    //! \brief Drop the reference (if any)
+    void reset() {
+        if (_block) {
+            std::exchange(_block, nullptr)->release();
+        }
+    }
+
+    //! \brief The referenced block, or nullptr
+    BufferBlock *get() const { return _block; }
+
+    //! \name Pointer-like access
+    //!@{
+    BufferBlock *operator->() const { return _block; }
+    explicit operator bool() const { return _block != nullptr; }
+    //!@}
+};
+
+#endif  // SPONGE_LIBSPONGE_BUFFER_POOL_HH
@@ -0,0 +1,23 @@
+#include "event_fd.hh"
+
+#include "util.hh"
+
+#include <cerrno>
+#include <cstdint>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+EventFD::EventFD() : FileDescriptor(SystemCall("eventfd", eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))) {}
+
+void EventFD::notify() {
+    const uint64_t one = 1;
+    // no register_write(): the write count is not atomic, and any thread may call this
+    SystemCall("write", ::write(fd_num(), &one, sizeof(one)));
+}
+
+bool EventFD::clear() {
+    uint64_t count = 0;
+    const ssize_t bytes_read = SystemCall("read", ::read(fd_num(), &count, sizeof(count)), EAGAIN);
+    register_read();
+    return bytes_read > 0;
+}
@@ -0,0 +1,21 @@
+#ifndef SPONGE_LIBSPONGE_EVENT_FD_HH
+#define SPONGE_LIBSPONGE_EVENT_FD_HH
+
+#include "file_descriptor.hh"
+
+//! \brief A non-blocking [eventfd(2)](\ref man2::eventfd): a counter that one thread bumps to wake up
+//! another thread polling the descriptor, which is readable while the counter is nonzero
+class EventFD : public FileDescriptor {
+  public:
+    //! Create an eventfd with a count of zero
+    EventFD();
+
+    //! Add one to the count, making the descriptor readable (safe to call from any thread)
+    void notify();
+
+    //! \brief Reset the count to zero
+    //! \returns `false` if it was already zero
+    bool clear();
+};
+
+#endif  // SPONGE_LIBSPONGE_EVENT_FD_HH
@@ -1,11 +1,15 @@
 #include "file_descriptor.hh"
 
+#include "io_uring.hh"
 #include "util.hh"
 
 #include <algorithm>
+#include <cstring>
 #include <fcntl.h>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
+#include <sys/socket.h>
 #include <sys/uio.h>
 #include <unistd.h>
 
@@ -63,6 +67,38 @@ void FileDescriptor::read(std::string &str, const size_t limit) {
     register_read();
 }
 
+//! \param[out] buffer is replaced by a Buffer holding the bytes read
+//! \param[in] limit is the maximum number of bytes to read; fewer bytes may be returned
+//! \details The storage comes from the BufferPool, so a datagram read from e.g. a TUN device can
+//! be parsed and passed up the stack without touching the general-purpose allocator. A read is at
+//! most BufferPool::LARGE_BLOCK_SIZE bytes (enough for a GRO-coalesced 64 KiB packet and its
+//! virtio-net header), so that it always fits a pool block. The read goes into a block big enough
+//! for `limit` bytes; if what arrives fits in a small block, it is copied into one, so that a small
+//! datagram does not pin a large block for as long as its payload is kept. (The large block goes
+//! straight back to this thread's free list, ready for the next read.)
+void FileDescriptor::read(Buffer &buffer, const size_t limit) {
+    const size_t size_to_read = min(BufferPool::LARGE_BLOCK_SIZE, limit);
+    buffer = Buffer::allocate(size_to_read);
+
+    ssize_t bytes_read = SystemCall("read", ::read(fd_num(), buffer.mutable_data(), size_to_read));
+    if (limit > 0 && bytes_read == 0) {
+        _internal_fd->_eof = true;
+    }
+    if (bytes_read > static_cast<ssize_t>(size_to_read)) {
+        throw runtime_error("read() read more than requested");
+    }
+    if (size_to_read > BufferPool::SMALL_BLOCK_SIZE and bytes_read > 0 and
+        size_t(bytes_read) <= BufferPool::SMALL_BLOCK_SIZE) {
+        Buffer small = Buffer::allocate(bytes_read);
+        memcpy(small.mutable_data(), buffer.str().data(), bytes_read);
+        buffer = move(small);
+    } else {
+        buffer.remove_suffix(size_to_read - bytes_read);
+    }
+
+    register_read();
+}
+
 //! \param[in] limit is the maximum number of bytes to read; fewer bytes may be returned
 //! \returns a vector of bytes read
 string FileDescriptor::read(const size_t limit) {
@@ -98,6 +134,112 @@ size_t FileDescriptor::write(BufferViewList buffer, const bool write_all) {
     return total_bytes_written;
 }
 
+//! Scratch space for FileDescriptor::write_packets, reused by every call on the same thread
+struct WritePacketsScratch {
+    vector<iovec> iovecs{};      //!< the pieces of every packet, one packet after another
+    vector<mmsghdr> messages{};  //!< one entry per packet, pointing into `iovecs`
+};
+
+//! Writes queued on an IoUring by one FileDescriptor::write_packets call, at most
+static constexpr unsigned WRITE_RING_ENTRIES = 64;
+
+//! \brief This thread's IoUring for FileDescriptor::write_packets
+//! \returns null if io_uring is not available (e.g. the kernel is too old, or a seccomp filter forbids it)
+static IoUring *write_ring() {
+    thread_local unique_ptr<IoUring> ring;
+    thread_local bool unavailable = false;
+    if (not ring and not unavailable) {
+        try {
+            ring = make_unique<IoUring>(WRITE_RING_ENTRIES);
+        } catch (const exception &) {
+            unavailable = true;
+        }
+    }
+    return ring.get();
+}
+
+//! \param[in] packets are the packets to write, in order
+//! \details On a socket, the whole batch is handed to the kernel with one [sendmmsg(2)](\ref man2::sendmmsg)
+//! (resubmitting the remainder if the kernel accepts only part of it). Other descriptors, such as a TAP
+//! device, have no batched write call, so the packets are queued as linked writes on this thread's IoUring
+//! and submitted with one [io_uring_enter(2)](\ref man2::io_uring_enter) per IoUring-full of packets. The
+//! first ENOTSOCK is remembered, so such a descriptor is only tried with sendmmsg() once. Where io_uring
+//! is not available, each packet is one [writev(2)](\ref man2::writev).
+void FileDescriptor::write_packets(const vector<BufferViewList> &packets) {
+    if (packets.empty()) {
+        return;
+    }
+
+    thread_local WritePacketsScratch scratch;
+    scratch.iovecs.clear();
+    scratch.messages.assign(packets.size(), {});
+    for (size_t i = 0; i < packets.size(); i++) {
+        const auto pieces = packets[i].as_iovecs();
+        scratch.iovecs.insert(scratch.iovecs.end(), pieces.begin(), pieces.end());
+        scratch.messages[i].msg_hdr.msg_iovlen = pieces.size();
+    }
+    // point each message at its pieces only once `iovecs` has stopped growing (and moving)
+    iovec *next_iovec = scratch.iovecs.data();
+    for (auto &message : scratch.messages) {
+        message.msg_hdr.msg_iov = next_iovec;
+        next_iovec += message.msg_hdr.msg_iovlen;
+    }
+
+    if (not _internal_fd->_not_socket) {
+        size_t sent = 0;
+        while (sent < packets.size()) {
+            const int count = SystemCall(
+                "sendmmsg",
+                ::sendmmsg(fd_num(), scratch.messages.data() + sent, scratch.messages.size() - sent, 0),
+                ENOTSOCK);
+            if (count < 0) {
+                _internal_fd->_not_socket = true;
+                break;
+            }
+            for (size_t i = sent; i < sent + size_t(count); i++) {
+                if (scratch.messages[i].msg_len != packets[i].size()) {
+                    throw runtime_error("sendmmsg wrote part of a packet");
+                }
+            }
+            sent += count;
+        }
+        if (sent == packets.size()) {
+            register_write();
+            return;
+        }
+    }
+
+    IoUring *const ring = write_ring();
+    if (ring == nullptr) {
+        for (const auto &packet : packets) {
+            write(packet);
+        }
+        return;
+    }
+
+    for (size_t batch_start = 0; batch_start < packets.size();) {
+        size_t batch_end = batch_start;
+        for (; batch_end < packets.size(); batch_end++) {
+            const msghdr &packet = scratch.messages[batch_end].msg_hdr;
+            if (not ring->queue_writev(fd_num(), packet.msg_iov, packet.msg_iovlen)) {
+                break;
+            }
+        }
+        const vector<int> &results = ring->submit_and_wait();
+        for (size_t i = batch_start; i < batch_end; i++) {
+            const int result = results[i - batch_start];
+            if (result < 0) {
+                throw unix_error("writev", -result);
+            }
+            if (size_t(result) != packets[i].size()) {
+                throw runtime_error("writev wrote part of a packet");
+            }
+        }
+        batch_start = batch_end;
+    }
+    register_write();
+}
+
 void FileDescriptor::set_blocking(const bool blocking_state) {
     int flags = SystemCall("fcntl", fcntl(fd_num(), F_GETFL));
     if (blocking_state) {
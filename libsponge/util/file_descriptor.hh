@@ -7,6 +7,7 @@
 #include <cstddef>
 #include <limits>
 #include <memory>
+#include <vector>
 
 //! A reference-counted handle to a file descriptor
 class FileDescriptor {
@@ -19,6 +20,7 @@ class FileDescriptor {
         bool _closed = false;       //!< Flag indicating whether FDWrapper::_fd has been closed
         unsigned _read_count = 0;   //!< The number of times FDWrapper::_fd has been read
         unsigned _write_count = 0;  //!< The numberof times FDWrapper::_fd has been written
+        bool _not_socket = false;   //!< Flag indicating that FDWrapper::_fd turned out not to be a socket
 
         //! Construct from a file descriptor number returned by the kernel
         explicit FDWrapper(const int fd);
@@ -61,6 +63,9 @@ class FileDescriptor {
     //! Read up to `limit` bytes into `str` (caller can allocate storage)
     void read(std::string &str, const size_t limit = std::numeric_limits<size_t>::max());
 
+    //! Read up to `limit` bytes into a pool-backed Buffer
+    void read(Buffer &buffer, const size_t limit = BufferPool::LARGE_BLOCK_SIZE);
+
     //! Write a string, possibly blocking until all is written
     size_t write(const char *str, const bool write_all = true) { return write(BufferViewList(str), write_all); }
 
@@ -70,6 +75,9 @@ class FileDescriptor {
     //! Write a buffer (or list of buffers), possibly blocking until all is written
     size_t write(BufferViewList buffer, const bool write_all = true);
 
+    //! Write each buffer list as a packet of its own (e.g. a datagram, or a frame to a TAP device)
+    void write_packets(const std::vector<BufferViewList> &packets);
+
     //! Close the underlying file descriptor
     void close() { _internal_fd->close(); }
 
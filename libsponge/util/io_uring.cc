@@ -0,0 +1,153 @@
+#include "io_uring.hh"
+
+#include "util.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+int io_uring_setup(const unsigned entries, io_uring_params &params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+}
+
+int io_uring_enter(const int fd, const unsigned to_submit, const unsigned min_complete, const unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+char *map_ring(const int fd, const size_t size, const off_t offset) {
+    void *const map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+    if (map == MAP_FAILED) {
+        throw unix_error("mmap");
+    }
+    return static_cast<char *>(map);
+}
+
+template <typename T>
+T *at(char *base, const uint32_t offset) {
+    return reinterpret_cast<T *>(base + offset);
+}
+
+}  // namespace
+
+//! \param[in] entries the most writes to queue before each submit_and_wait()
+IoUring::Setup IoUring::setup(const unsigned entries) {
+    Setup ret{-1, {}};
+    ret.fd = SystemCall("io_uring_setup", io_uring_setup(entries, ret.params));
+    return ret;
+}
+
+//! \details Needs the IORING_FEAT_SINGLE_MMAP feature (Linux 5.4), which maps both rings at once.
+IoUring::IoUring(const Setup &setup)
+    : FileDescriptor(setup.fd)
+    , _rings(nullptr)
+    , _rings_size(max(setup.params.sq_off.array + setup.params.sq_entries * sizeof(unsigned),
+                      setup.params.cq_off.cqes + setup.params.cq_entries * sizeof(io_uring_cqe)))
+    , _sqes(nullptr)
+    , _sqes_size(setup.params.sq_entries * sizeof(io_uring_sqe))
+    , _sq_tail(nullptr)
+    , _sq_array(nullptr)
+    , _sq_mask(0)
+    , _cq_head(nullptr)
+    , _cq_tail(nullptr)
+    , _cqes(nullptr)
+    , _cq_mask(0)
+    , _entries(setup.params.sq_entries) {
+    const io_uring_params &params = setup.params;
+    if (not(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        throw runtime_error("io_uring: this kernel maps the submission and completion rings separately");
+    }
+
+    _rings = map_ring(fd_num(), _rings_size, IORING_OFF_SQ_RING);
+    try {
+        _sqes = reinterpret_cast<io_uring_sqe *>(map_ring(fd_num(), _sqes_size, IORING_OFF_SQES));
+    } catch (...) {
+        munmap(_rings, _rings_size);
+        throw;
+    }
+
+    _sq_tail = at<unsigned>(_rings, params.sq_off.tail);
+    _sq_array = at<unsigned>(_rings, params.sq_off.array);
+    _sq_mask = *at<unsigned>(_rings, params.sq_off.ring_mask);
+    _cq_head = at<unsigned>(_rings, params.cq_off.head);
+    _cq_tail = at<unsigned>(_rings, params.cq_off.tail);
+    _cqes = at<io_uring_cqe>(_rings, params.cq_off.cqes);
+    _cq_mask = *at<unsigned>(_rings, params.cq_off.ring_mask);
+    _results.reserve(_entries);
+}
+
+IoUring::~IoUring() {
+    munmap(_sqes, _sqes_size);
+    munmap(_rings, _rings_size);
+}
+
+//! \param[in] fd the descriptor to write to
+//! \param[in] iov the pieces to write, one after another
+//! \param[in] count the number of pieces
+bool IoUring::queue_writev(const int fd, const iovec *iov, const unsigned count) {
+    if (_queued == _entries) {
+        return false;
+    }
+    if (_queued == 0) {
+        _results.clear();
+    }
+
+    // the submission queue is empty between batches, so this batch's entries start at the tail
+    const unsigned tail = *_sq_tail + _queued;
+    const unsigned index = tail & _sq_mask;
+    io_uring_sqe &sqe = _sqes[index];
+    sqe = {};
+    sqe.opcode = IORING_OP_WRITEV;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uint64_t>(iov);
+    sqe.len = count;
+    sqe.user_data = _queued;
+    _sq_array[index] = index;
+
+    // keep the batch in order: each write waits for the one before it
+    if (_queued > 0) {
+        _sqes[(tail - 1) & _sq_mask].flags |= IOSQE_IO_LINK;
+    }
+    _queued++;
+    _results.push_back(0);
+    return true;
+}
+
+//! \details A completion that arrives before the kernel has consumed every submission (it may stop
+//! early, e.g. when interrupted) is collected on the next pass, so every queued write is accounted for.
+const vector<int> &IoUring::submit_and_wait() {
+    const unsigned count = _queued;
+    _queued = 0;
+    if (count > 0) {
+        __atomic_store_n(_sq_tail, *_sq_tail + count, __ATOMIC_RELEASE);
+    }
+
+    unsigned submitted = 0;
+    unsigned completed = 0;
+    while (completed < count) {
+        const int ret = SystemCall(
+            "io_uring_enter",
+            io_uring_enter(fd_num(), count - submitted, count - completed, IORING_ENTER_GETEVENTS),
+            EINTR);
+        if (ret > 0) {
+            submitted += ret;
+        }
+
+        unsigned head = *_cq_head;
+        const unsigned tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const io_uring_cqe &cqe = _cqes[head & _cq_mask];
+            _results.at(cqe.user_data) = cqe.res;
+            completed++;
+        }
+        __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+    }
+    register_write();
+    return _results;
+}
@@ -0,0 +1,79 @@
+#ifndef SPONGE_LIBSPONGE_IO_URING_HH
+#define SPONGE_LIBSPONGE_IO_URING_HH
+
+#include "file_descriptor.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+#include <vector>
+
+//! \brief An [io_uring(7)](\ref man7::io_uring) instance that batches writes, set up with raw system calls
+//! \details queue_writev() fills slots of the memory-mapped submission queue, without entering the kernel.
+//! submit_and_wait() then hands the kernel every queued write with one
+//! [io_uring_enter(2)](\ref man2::io_uring_enter) and waits for all of them to complete. The writes are
+//! linked (IOSQE_IO_LINK), so the kernel does them one after another, in the order they were queued; if
+//! one fails, the ones after it are cancelled.
+//!
+//! This is what gives descriptors without a batched write call of their own, such as a TAP device, one
+//! system call per batch of packets instead of one per packet.
+class IoUring : public FileDescriptor {
+  private:
+    char *_rings;               //!< the submission and completion rings, mapped together
+    size_t _rings_size;         //!< bytes mapped at `_rings`
+    io_uring_sqe *_sqes;        //!< the submission queue entries
+    size_t _sqes_size;          //!< bytes mapped at `_sqes`
+    unsigned *_sq_tail;         //!< next submission slot the kernel will see (written by us)
+    unsigned *_sq_array;        //!< indices into `_sqes`, one per submission slot
+    unsigned _sq_mask;          //!< slot index mask of the submission queue
+    unsigned *_cq_head;         //!< next completion to consume (written by us)
+    const unsigned *_cq_tail;   //!< one past the last completion posted (written by the kernel)
+    const io_uring_cqe *_cqes;  //!< the completion queue entries
+    unsigned _cq_mask;          //!< slot index mask of the completion queue
+    unsigned _entries;          //!< slots in the submission queue
+
+    unsigned _queued{0};          //!< writes queued since the last submit_and_wait()
+    std::vector<int> _results{};  //!< for each write of the current or last batch, its result
+
+    //! A new io_uring's descriptor, and the layout of its rings
+    struct Setup {
+        int fd;
+        io_uring_params params;
+    };
+
+    //! Create an io_uring (without mapping it)
+    static Setup setup(const unsigned entries);
+
+    //! Map the rings of a new io_uring
+    explicit IoUring(const Setup &setup);
+
+  public:
+    //! Set up a ring with room for `entries` queued writes (rounded up to a power of two by the kernel)
+    explicit IoUring(const unsigned entries) : IoUring(setup(entries)) {}
+    ~IoUring();
+
+    //! \name No copying or moving: the mappings belong to this object
+    //!@{
+    IoUring(const IoUring &other) = delete;
+    IoUring &operator=(const IoUring &other) = delete;
+    //!@}
+
+    //! Slots in the submission queue: how many writes can be queued before submit_and_wait()
+    unsigned capacity() const { return _entries; }
+
+    //! Writes queued since the last submit_and_wait()
+    unsigned queued() const { return _queued; }
+
+    //! \brief Queue a [writev(2)](\ref man2::writev) of `count` pieces to `fd`, after any writes already queued
+    //! \note `iov` and the memory it points to must stay valid until submit_and_wait() returns
+    //! \returns `false`, queueing nothing, if the submission queue is full
+    bool queue_writev(const int fd, const iovec *iov, const unsigned count);
+
+    //! \brief Submit the queued writes and wait for all of them to complete
+    //! \returns for each write, in the order queued, the bytes written or a negated errno value (valid
+    //! until the next write is queued)
+    const std::vector<int> &submit_and_wait();
+};
+
+#endif  // SPONGE_LIBSPONGE_IO_URING_HH
@@ -0,0 +1,138 @@
+#ifndef SPONGE_LIBSPONGE_IP_ADDRESS_MAP_HH
+#define SPONGE_LIBSPONGE_IP_ADDRESS_MAP_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+//! \brief Hash map from raw 32-bit IPv4 addresses to values, with open addressing
+//! \details Entries live in a single array of slots, probed linearly from the slot a Fibonacci hash of the
+//! address picks. The array is kept at most half full, so a lookup usually reads one slot. Erasing shifts
+//! later entries of the same probe run back into the hole instead of leaving a tombstone, so lookups
+//! never slow down as entries come and go. Inserting may move entries, so it invalidates pointers and
+//! references to values; erasing may move entries too.
+template <typename T>
+class IPAddressMap {
+  private:
+    struct Slot {
+        uint32_t key{};
+        bool occupied{false};
+        T value{};
+    };
+
+    std::vector<Slot> _slots;
+    unsigned _bits;  //!< the array has 2^_bits slots
+    size_t _size{0};
+
+    size_t _mask() const { return _slots.size() - 1; }
+
+    //! Fibonacci hash of the address: the slot its probe run starts from
+    size_t _home(const uint32_t key) const { return (key * 0x9e3779b9u) >> (32 - _bits); }
+
+    //! The slot holding `key`, or the empty slot where it would go
+    size_t _probe(const uint32_t key) const {
+        size_t i = _home(key);
+        while (_slots[i].occupied and _slots[i].key != key) {
+            i = (i + 1) & _mask();
+        }
+        return i;
+    }
+
+    //! Double the number of slots, rehashing every entry
+    void _grow() {
+        std::vector<Slot> old(size_t{1} << (_bits + 1));
+        std::swap(old, _slots);
+        _bits++;
+        for (Slot &slot : old) {
+            if (slot.occupied) {
+                _slots[_probe(slot.key)] = std::move(slot);
+            }
+        }
+    }
+
+    //! Empty a slot, then shift back any later entries of its probe run that may now sit closer to home
+    void _erase_slot(size_t hole) {
+        _slots[hole] = Slot{};
+        _size--;
+        for (size_t i = (hole + 1) & _mask(); _slots[i].occupied; i = (i + 1) & _mask()) {
+            // the entry may move into the hole only if its home is not between the hole and its slot
+            if (((i - _home(_slots[i].key)) & _mask()) >= ((i - hole) & _mask())) {
+                _slots[hole] = std::move(_slots[i]);
+                _slots[i] = Slot{};
+                hole = i;
+            }
+        }
+    }
+
+  public:
+    IPAddressMap() : _slots(16), _bits(4) {}
+
+    //! \returns the value for `key`, or `nullptr` if there is none
+    T *find(const uint32_t key) {
+        Slot &slot = _slots[_probe(key)];
+        return slot.occupied ? &slot.value : nullptr;
+    }
+
+    //! \returns the value for `key`, or `nullptr` if there is none
+    const T *find(const uint32_t key) const {
+        const Slot &slot = _slots[_probe(key)];
+        return slot.occupied ? &slot.value : nullptr;
+    }
+
+    //! \returns the value for `key`, inserting a default-constructed one if there is none
+    T &operator[](const uint32_t key) {
+        size_t i = _probe(key);
+        if (not _slots[i].occupied) {
+            if (2 * (_size + 1) > _slots.size()) {
+                _grow();
+                i = _probe(key);
+            }
+            _slots[i].key = key;
+            _slots[i].occupied = true;
+            _size++;
+        }
+        return _slots[i].value;
+    }
+
+    //! \returns `true` if there was a value for `key`
+    bool erase(const uint32_t key) {
+        const size_t i = _probe(key);
+        if (not _slots[i].occupied) {
+            return false;
+        }
+        _erase_slot(i);
+        return true;
+    }
+
+    //! Call `f(key, value)` for every entry, in no particular order
+    template <typename F>
+    void for_each(F &&f) {
+        for (Slot &slot : _slots) {
+            if (slot.occupied) {
+                f(slot.key, slot.value);
+            }
+        }
+    }
+
+    //! \brief Erase every entry for which `pred(key, value)` returns `true`
+    //! \note `pred` may be called more than once for an entry (when an erase shifts it), so it should not
+    //! modify the entry
+    template <typename F>
+    void erase_if(F &&pred) {
+        for (size_t i = 0; i < _slots.size();) {
+            if (_slots[i].occupied and pred(_slots[i].key, _slots[i].value)) {
+                _erase_slot(i);  // a later entry may have moved into slot i, so look at it again
+            } else {
+                i++;
+            }
+        }
+    }
+
+    //! Number of entries
+    size_t size() const { return _size; }
+
+    bool empty() const { return _size == 0; }
+};
+
+#endif  // SPONGE_LIBSPONGE_IP_ADDRESS_MAP_HH
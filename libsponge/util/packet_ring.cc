@@ -0,0 +1,289 @@
+#include "packet_ring.hh"
+
+#include "util.hh"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <cstring>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+//! Blocks in the transmit ring (TPACKET_V3 sends frame by frame, but the ring is still laid out in blocks)
+constexpr size_t TX_BLOCK_COUNT = 8;
+
+//! Bytes in each block of the transmit ring
+constexpr size_t TX_BLOCK_SIZE = PacketRingFD::TX_FRAME_SIZE * PacketRingFD::TX_FRAME_COUNT / TX_BLOCK_COUNT;
+
+//! Where a frame starts in a transmit slot, after the slot's header
+constexpr size_t TX_DATA_OFFSET = TPACKET_ALIGN(sizeof(tpacket3_hdr));
+
+//! \brief Free bytes the kernel leaves in front of each received frame (PACKET_RESERVE)
+//! \details The kernel aligns the network header, so an Ethernet frame starts 14 bytes before an aligned
+//! offset. Reserving 14 bytes more than the BufferBlock placement needs puts the frame on an aligned offset,
+//! with the placement's bytes free in front of it.
+constexpr int RX_RESERVE = BufferPool::PLACEMENT_OVERHEAD + ETH_HLEN;
+
+template <typename T>
+T load_acquire(const T &field) {
+    return __atomic_load_n(&field, __ATOMIC_ACQUIRE);
+}
+
+template <typename T>
+void store_release(T &field, const T value) {
+    __atomic_store_n(&field, value, __ATOMIC_RELEASE);
+}
+
+}  // namespace
+
+//! \brief The memory-mapped rings, which stay mapped until the PacketRingFD is gone and no Buffer refers to them
+//! \details PacketRxRing keeps track of the receive ring, and deletes this object when the last reference goes.
+class PacketRingFD::Rings : public PacketRxRing {
+  public:
+    char *const map;
+    const size_t map_size;
+
+    size_t tx_next{0};    //!< the next transmit slot to fill
+    size_t tx_queued{0};  //!< frames written since the last flush()
+
+    Rings(char *mapping, const size_t mapping_size)
+        : PacketRxRing(mapping, RX_BLOCK_SIZE, RX_BLOCK_COUNT), map(mapping), map_size(mapping_size) {}
+
+    ~Rings() override { munmap(map, map_size); }
+
+    Rings(const Rings &other) = delete;
+    Rings &operator=(const Rings &other) = delete;
+
+    tpacket3_hdr &tx_slot(const size_t index) {
+        char *const tx_ring = map + RX_BLOCK_SIZE * RX_BLOCK_COUNT;
+        const size_t per_block = TX_BLOCK_SIZE / TX_FRAME_SIZE;
+        return *reinterpret_cast<tpacket3_hdr *>(tx_ring + (index / per_block) * TX_BLOCK_SIZE +
+                                                 (index % per_block) * TX_FRAME_SIZE);
+    }
+};
+
+void PacketRingFD::RingsRelease::operator()(Rings *rings) const { rings->release(); }
+
+//! \param[in] devname is the name of the network interface, e.g. one end of a veth pair
+PacketRingFD::PacketRingFD(const string &devname)
+    : FileDescriptor(SystemCall("socket", socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL)))), _rings(nullptr) {
+    const int version = TPACKET_V3;
+    SystemCall("setsockopt", setsockopt(fd_num(), SOL_PACKET, PACKET_VERSION, &version, sizeof(version)));
+    SystemCall("setsockopt", setsockopt(fd_num(), SOL_PACKET, PACKET_RESERVE, &RX_RESERVE, sizeof(RX_RESERVE)));
+
+    tpacket_req3 rx_req{};
+    rx_req.tp_block_size = RX_BLOCK_SIZE;
+    rx_req.tp_block_nr = RX_BLOCK_COUNT;
+    rx_req.tp_frame_size = TX_FRAME_SIZE;
+    rx_req.tp_frame_nr = RX_BLOCK_SIZE / TX_FRAME_SIZE * RX_BLOCK_COUNT;
+    rx_req.tp_retire_blk_tov = RX_BLOCK_TIMEOUT_MS;
+    SystemCall("setsockopt", setsockopt(fd_num(), SOL_PACKET, PACKET_RX_RING, &rx_req, sizeof(rx_req)));
+
+    tpacket_req3 tx_req{};
+    tx_req.tp_block_size = TX_BLOCK_SIZE;
+    tx_req.tp_block_nr = TX_BLOCK_COUNT;
+    tx_req.tp_frame_size = TX_FRAME_SIZE;
+    tx_req.tp_frame_nr = TX_FRAME_COUNT;
+    SystemCall("setsockopt", setsockopt(fd_num(), SOL_PACKET, PACKET_TX_RING, &tx_req, sizeof(tx_req)));
+
+    // the transmit ring is mapped right after the receive ring
+    const size_t map_size = RX_BLOCK_SIZE * RX_BLOCK_COUNT + TX_BLOCK_SIZE * TX_BLOCK_COUNT;
+    void *const map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_num(), 0);
+    if (map == MAP_FAILED) {
+        throw unix_error("mmap");
+    }
+    _rings.reset(new Rings(static_cast<char *>(map), map_size));
+
+    const unsigned ifindex = if_nametoindex(devname.c_str());
+    if (ifindex == 0) {
+        throw unix_error("if_nametoindex");
+    }
+
+    // receive frames addressed to any Ethernet address, including ours
+    packet_mreq membership{};
+    membership.mr_ifindex = ifindex;
+    membership.mr_type = PACKET_MR_PROMISC;
+    SystemCall("setsockopt",
+               setsockopt(fd_num(), SOL_PACKET, PACKET_ADD_MEMBERSHIP, &membership, sizeof(membership)));
+
+    sockaddr_ll address{};
+    address.sll_family = AF_PACKET;
+    address.sll_protocol = htons(ETH_P_ALL);
+    address.sll_ifindex = ifindex;
+    SystemCall("bind", bind(fd_num(), reinterpret_cast<const sockaddr *>(&address), sizeof(address)));
+}
+
+optional<PacketRingFD::received_frame> PacketRingFD::read_frame() {
+    register_read();
+    return _rings->read_frame();
+}
+
+size_t PacketRingFD::buffered_frames() const { return _rings->buffered_frames(); }
+
+//! \param[in] frame is the whole Ethernet frame, header included
+void PacketRingFD::write_frame(const BufferViewList &frame) {
+    if (frame.size() > TX_FRAME_SIZE - TX_DATA_OFFSET) {
+        throw runtime_error("PacketRingFD: frame too long for the transmit ring");
+    }
+
+    Rings &rings = *_rings;
+    tpacket3_hdr &slot = rings.tx_slot(rings.tx_next);
+    const auto slot_free = [&] {
+        const uint32_t status = load_acquire(slot.tp_status);
+        return status == TP_STATUS_AVAILABLE or status == TP_STATUS_WRONG_FORMAT;
+    };
+    if (not slot_free()) {
+        // send what is queued, waiting until the kernel is done with it
+        rings.tx_queued = 0;
+        SystemCall("send", send(fd_num(), nullptr, 0, 0));
+        if (not slot_free()) {
+            throw runtime_error("PacketRingFD: transmit ring is full");
+        }
+    }
+
+    char *dest = reinterpret_cast<char *>(&slot) + TX_DATA_OFFSET;
+    for (const iovec &piece : frame.as_iovecs()) {
+        memcpy(dest, piece.iov_base, piece.iov_len);
+        dest += piece.iov_len;
+    }
+    slot.tp_next_offset = 0;
+    slot.tp_len = frame.size();
+    slot.tp_snaplen = frame.size();
+    store_release(slot.tp_status, uint32_t{TP_STATUS_SEND_REQUEST});
+
+    rings.tx_next = (rings.tx_next + 1) % TX_FRAME_COUNT;
+    rings.tx_queued++;
+    register_write();
+}
+
+void PacketRingFD::flush() {
+    if (_rings->tx_queued == 0) {
+        return;
+    }
+    _rings->tx_queued = 0;
+    SystemCall("send", send(fd_num(), nullptr, 0, MSG_DONTWAIT));
+}
+
+//! \param[in] ring is the first block, aligned as the kernel aligns a mapped ring
+//! \param[in] block_size is the number of bytes in each block
+//! \param[in] block_count is the number of blocks
+PacketRxRing::PacketRxRing(char *ring, const size_t block_size, const size_t block_count)
+    : _ring(ring), _block_size(block_size), _block_refs(block_count), _block_held(block_count) {}
+
+//! \details A block that is still held (by Buffers over its frames) keeps TP_STATUS_USER after the reader has
+//! moved past it, so the status alone does not say that the kernel has filled it again.
+bool PacketRxRing::open_block() {
+    auto &desc = *reinterpret_cast<tpacket_block_desc *>(_ring + _block * _block_size);
+    if (_block_held[_block].load(memory_order_acquire) or
+        not(load_acquire(desc.hdr.bh1.block_status) & TP_STATUS_USER)) {
+        return false;
+    }
+    _refs.fetch_add(1, memory_order_relaxed);
+    _block_held[_block].store(true, memory_order_relaxed);
+    _block_refs[_block].store(1, memory_order_relaxed);
+    _open = true;
+    _frames_left = desc.hdr.bh1.num_pkts;
+    _next_frame = reinterpret_cast<char *>(&desc) + desc.hdr.bh1.offset_to_first_pkt;
+    return true;
+}
+
+void PacketRxRing::close_block() {
+    const size_t done = _block;
+    _open = false;
+    _block = (_block + 1) % _block_refs.size();
+    unref_block(done);
+}
+
+//! \param[in] index the block
+//! \details The block is handed to the kernel before it stops counting as held, so that the reader (which
+//! may be on another thread) never sees it as free while its status is still the old TP_STATUS_USER.
+void PacketRxRing::unref_block(const size_t index) {
+    if (_block_refs[index].fetch_sub(1, memory_order_acq_rel) == 1) {
+        auto &desc = *reinterpret_cast<tpacket_block_desc *>(_ring + index * _block_size);
+        store_release(desc.hdr.bh1.block_status, uint32_t{TP_STATUS_KERNEL});
+        _block_held[index].store(false, memory_order_release);
+        unref();
+    }
+}
+
+void PacketRxRing::unref() {
+    if (_refs.fetch_sub(1, memory_order_acq_rel) == 1) {
+        delete this;
+    }
+}
+
+void PacketRxRing::release() {
+    if (_open) {
+        close_block();
+    }
+    unref();
+}
+
+//! \param[in] data the data() of the released frame's block, which lies within the receive block
+void PacketRxRing::release_block(const char *data) { unref_block((data - _ring) / _block_size); }
+
+//! \details A frame that has room in front of it for a BufferBlock is returned in place. Otherwise (if the
+//! kernel laid out the frame differently than expected) it is copied into a Buffer from the pool.
+optional<PacketRingFD::received_frame> PacketRxRing::read_frame() {
+    while (_open or open_block()) {
+        if (_frames_left == 0) {
+            close_block();
+            continue;
+        }
+
+        auto *const header = reinterpret_cast<tpacket3_hdr *>(_next_frame);
+        _next_frame += header->tp_next_offset;
+        _frames_left--;
+
+        // a packet socket also sees the frames this host sends
+        const auto &source = *reinterpret_cast<const sockaddr_ll *>(reinterpret_cast<char *>(header) +
+                                                                    TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+        char *const data = reinterpret_cast<char *>(header) + header->tp_mac;
+        const size_t size = header->tp_snaplen;
+        const bool placeable = header->tp_mac >= TPACKET3_HDRLEN + BufferPool::PLACEMENT_OVERHEAD and
+                               reinterpret_cast<uintptr_t>(data) % alignof(BufferBlock) == 0;
+
+        // a frame from another network namespace on this host (e.g. over a veth pair) may still have
+        // a partial checksum, for hardware that it never went through to finish
+        const bool checksum_verified = header->tp_status & (TP_STATUS_CSUM_VALID | TP_STATUS_CSUMNOTREADY);
+
+        optional<PacketRingFD::received_frame> frame;
+        if (source.sll_pkttype == PACKET_OUTGOING or size == 0) {
+            // skip it
+        } else if (placeable) {
+            _block_refs[_block].fetch_add(1, memory_order_relaxed);
+            frame = {Buffer::adopt(BlockRef(BufferPool::place(data, size, this)), size), checksum_verified};
+        } else {
+            frame = {Buffer::allocate(size), checksum_verified};
+            memcpy(frame->frame.mutable_data(), data, size);
+        }
+
+        // hand the block back as soon as the last of its frames has been read
+        if (_frames_left == 0) {
+            close_block();
+        }
+        if (frame.has_value()) {
+            return frame;
+        }
+    }
+    return {};
+}
+
+size_t PacketRxRing::buffered_frames() const {
+    if (_open) {
+        return _frames_left;
+    }
+    const auto &desc = *reinterpret_cast<const tpacket_block_desc *>(_ring + _block * _block_size);
+    if (_block_held[_block].load(memory_order_acquire)) {
+        return 0;
+    }
+    return (load_acquire(desc.hdr.bh1.block_status) & TP_STATUS_USER) ? desc.hdr.bh1.num_pkts : 0;
+}
@@ -0,0 +1,133 @@
+#ifndef SPONGE_LIBSPONGE_PACKET_RING_HH
+#define SPONGE_LIBSPONGE_PACKET_RING_HH
+
+#include "buffer.hh"
+#include "file_descriptor.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+//! \brief A [packet socket](\ref man7::packet) on one network interface, with memory-mapped
+//! [TPACKET_V3](https://www.kernel.org/doc/Documentation/networking/packet_mmap.txt) receive and transmit rings
+//! \details The kernel fills the receive ring a block of frames at a time. read_frame() returns each frame as a
+//! Buffer over the ring memory itself, with no copy; the block goes back to the kernel once the reader has
+//! moved past it and every Buffer over one of its frames has been released. write_frame() copies a frame
+//! into the transmit ring, and flush() has the kernel send every frame written so far with one system call.
+class PacketRingFD : public FileDescriptor {
+  public:
+    //! Bytes in each block of the receive ring (a multiple of the page size)
+    static constexpr size_t RX_BLOCK_SIZE = 1 << 18;
+
+    //! Blocks in the receive ring
+    static constexpr size_t RX_BLOCK_COUNT = 16;
+
+    //! Longest the kernel keeps a partly filled receive block before handing it over, in milliseconds
+    static constexpr unsigned RX_BLOCK_TIMEOUT_MS = 1;
+
+    //! Bytes in each slot of the transmit ring, enough for a full-sized Ethernet frame and the slot's header
+    static constexpr size_t TX_FRAME_SIZE = 2048;
+
+    //! Slots in the transmit ring
+    static constexpr size_t TX_FRAME_COUNT = 256;
+
+  private:
+    class Rings;
+
+    //! Drops the handle's reference to the Rings, which outlive it while Buffers over ring frames remain
+    struct RingsRelease {
+        void operator()(Rings *rings) const;
+    };
+
+    std::unique_ptr<Rings, RingsRelease> _rings;
+
+  public:
+    //! Open a packet socket bound to the network interface `devname`, in promiscuous mode, and map its rings
+    explicit PacketRingFD(const std::string &devname);
+
+    struct received_frame {
+        Buffer frame;            //!< The Ethernet frame, header included
+        bool checksum_verified;  //!< Has the kernel checked the transport checksum, or left it to be filled in?
+    };
+
+    //! \brief The next frame received on the interface (not frames sent from this host), without copying it
+    //! \returns an empty optional if the kernel has not handed over any more frames
+    std::optional<received_frame> read_frame();
+
+    //! Number of frames that read_frame() can return without waiting for the kernel (at least)
+    size_t buffered_frames() const;
+
+    //! \brief Copy a frame into the transmit ring, to be sent by the next flush()
+    //! \note If the ring is full, this first flushes and waits for the kernel to free a slot
+    void write_frame(const BufferViewList &frame);
+
+    //! Have the kernel send every frame written since the last flush()
+    void flush();
+};
+
+//! \brief The reader's side of a TPACKET_V3 receive ring: which blocks it may read, and when each goes back
+//! \details The kernel hands a block over by setting TP_STATUS_USER in its descriptor, and takes it back
+//! when the status is set to TP_STATUS_KERNEL again. A block is held by the reader until it has moved past
+//! the block, and by each Buffer over one of its frames. Only when the last of these is dropped does the
+//! block go back to the kernel; until then it is not opened again, even if the reader comes back round to it.
+//!
+//! The object is reference-counted: the owner (see release()) and each block that is held keep it alive, and
+//! it deletes itself when the last reference goes. So it must be allocated with `new`.
+class PacketRxRing : public BlockOwner {
+  private:
+    char *const _ring;                               //!< the first receive block
+    const size_t _block_size;                        //!< bytes in each block
+    std::vector<std::atomic<uint32_t>> _block_refs;  //!< references to each block: the reader's and Buffers'
+    std::vector<std::atomic<bool>> _block_held;      //!< is each block out of the kernel's hands?
+    std::atomic<size_t> _refs{1};                    //!< the owner, plus each block that is held
+
+    size_t _block{0};            //!< the block being read, or the next one to read
+    bool _open{false};           //!< has the reader opened `_block`?
+    uint32_t _frames_left{0};    //!< frames in `_block` not yet read
+    char *_next_frame{nullptr};  //!< the next frame to read in `_block`
+
+    //! Start reading `_block`, if the kernel has handed it over and nothing still holds it
+    bool open_block();
+
+    //! Move past `_block`, dropping the reader's reference to it
+    void close_block();
+
+    //! Drop a reference to block `index`, handing it back to the kernel if it was the last
+    void unref_block(const size_t index);
+
+    //! Drop a reference to this object
+    void unref();
+
+  protected:
+    ~PacketRxRing() override = default;
+
+  public:
+    //! \brief Read the `block_count` blocks of `block_size` bytes at `ring`
+    //! \details The ring memory must outlive this object (e.g. by belonging to a derived class).
+    PacketRxRing(char *ring, const size_t block_size, const size_t block_count);
+
+    //! \name No copying: Buffers refer to the object
+    //!@{
+    PacketRxRing(const PacketRxRing &other) = delete;
+    PacketRxRing &operator=(const PacketRxRing &other) = delete;
+    //!@}
+
+    //! \brief The next frame received (not frames sent from this host), as for PacketRingFD::read_frame()
+    std::optional<PacketRingFD::received_frame> read_frame();
+
+    //! Number of frames that read_frame() can return without waiting for the kernel (at least)
+    size_t buffered_frames() const;
+
+    //! \brief Drop the owner's reference, moving past the block being read
+    //! \details The object is deleted now, or when the last Buffer over one of its frames is released.
+    void release();
+
+    //! A Buffer over a received frame has been released
+    void release_block(const char *data) override;
+};
+
+#endif  // SPONGE_LIBSPONGE_PACKET_RING_HH
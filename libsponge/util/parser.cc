@@ -31,10 +31,11 @@ T NetParser::_parse_int() {
         return 0;
     }
 
+    const string_view bytes = _buffer.str();
     T ret = 0;
     for (size_t i = 0; i < len; i++) {
         ret <<= 8;
-        ret += uint8_t(_buffer.at(i));
+        ret += uint8_t(bytes[i]);
     }
 
     _buffer.remove_prefix(len);
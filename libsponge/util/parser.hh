@@ -5,7 +5,10 @@
 
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <endian.h>
 #include <string>
+#include <string_view>
 #include <utility>
 
 //! The result of parsing or unparsing an IP datagram, TCP segment, Ethernet frame, or ARP message
@@ -60,6 +63,33 @@ class NetParser {
 
     //! Remove n bytes from the buffer
     void remove_prefix(const size_t n);
+
+    //! \brief Look at the next `n` bytes without consuming them, checking the length once
+    //! \returns the bytes, or an empty view (without recording an error) if fewer than `n` remain
+    //! \details For fixed-layout headers: decode fields with the static u16()/u32() below, then remove_prefix().
+    std::string_view peek(const size_t n) const {
+        if (_buffer.size() < n) {
+            return {};
+        }
+        return _buffer.str().substr(0, n);
+    }
+
+    //! \name Decode an integer in network byte order at `offset` in a view returned by peek()
+    //!@{
+    static uint32_t u32(const std::string_view bytes, const size_t offset) {
+        uint32_t ret;
+        memcpy(&ret, bytes.data() + offset, sizeof(ret));
+        return be32toh(ret);
+    }
+
+    static uint16_t u16(const std::string_view bytes, const size_t offset) {
+        uint16_t ret;
+        memcpy(&ret, bytes.data() + offset, sizeof(ret));
+        return be16toh(ret);
+    }
+
+    static uint8_t u8(const std::string_view bytes, const size_t offset) { return bytes[offset]; }
+    //!@}
 };
 
 struct NetUnparser {
@@ -74,6 +104,21 @@ struct NetUnparser {
 
     //! Write an 8-bit integer into the data stream in network byte order
     static void u8(std::string &s, const uint8_t val);
+
+    //! \name Encode an integer in network byte order at `offset` in memory the caller has already bounds-checked
+    //!@{
+    static void u32(char *dest, const size_t offset, const uint32_t val) {
+        const uint32_t be = htobe32(val);
+        memcpy(dest + offset, &be, sizeof(be));
+    }
+
+    static void u16(char *dest, const size_t offset, const uint16_t val) {
+        const uint16_t be = htobe16(val);
+        memcpy(dest + offset, &be, sizeof(be));
+    }
+
+    static void u8(char *dest, const size_t offset, const uint8_t val) { dest[offset] = static_cast<char>(val); }
+    //!@}
 };
 
 #endif  // SPONGE_LIBSPONGE_PARSER_HH
@@ -0,0 +1,173 @@
+#include "prefix_trie.hh"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+//! The high `length` bits set
+static uint32_t prefix_mask(const uint8_t length) { return length == 0 ? 0 : ~uint32_t{0} << (32 - length); }
+
+//! Bit `position` of `address`, counting from the most significant bit
+static unsigned bit_at(const uint32_t address, const uint8_t position) { return (address >> (31 - position)) & 1; }
+
+//! Length of the common prefix of `a` and `b`, capped at `limit`
+static uint8_t common_length(const uint32_t a, const uint32_t b, const uint8_t limit) {
+    const uint32_t diff = a ^ b;
+    return min<uint8_t>(diff == 0 ? 32 : __builtin_clz(diff), limit);
+}
+
+uint32_t PrefixTrie::_new_node(const uint32_t prefix, const uint8_t length) {
+    uint32_t index;
+    if (_free.empty()) {
+        index = _nodes.size();
+        _nodes.emplace_back();
+    } else {
+        index = _free.back();
+        _free.pop_back();
+        _nodes[index] = Node{};
+    }
+    _nodes[index].prefix = prefix;
+    _nodes[index].length = length;
+    return index;
+}
+
+//! \details Walks down while the nodes are prefixes of the new one, then either sets the value of an exact
+//! match, hangs a new leaf off an empty branch, or splits the branch where the new prefix diverges from it.
+void PrefixTrie::insert(const uint32_t prefix, const uint8_t length, const size_t value) {
+    if (length > 32) {
+        throw runtime_error("PrefixTrie: prefix longer than 32 bits");
+    }
+    const uint32_t key = prefix & prefix_mask(length);
+
+    uint32_t current = 0;
+    while (_nodes[current].length != length) {
+        const unsigned branch = bit_at(key, _nodes[current].length);
+        const uint32_t child = _nodes[current].children[branch];
+
+        if (child == 0) {
+            const uint32_t leaf = _new_node(key, length);
+            _nodes[current].children[branch] = leaf;
+            current = leaf;
+            break;
+        }
+
+        const uint32_t child_prefix = _nodes[child].prefix;
+        const uint8_t common = common_length(key, child_prefix, min(length, _nodes[child].length));
+        if (common == _nodes[child].length) {
+            current = child;
+            continue;
+        }
+
+        // the new prefix diverges from (or ends inside) the child's path: put a node at the point of divergence
+        const uint32_t split = _new_node(key & prefix_mask(common), common);
+        _nodes[split].children[bit_at(child_prefix, common)] = child;
+        _nodes[current].children[branch] = split;
+        if (common == length) {
+            current = split;
+        } else {
+            const uint32_t leaf = _new_node(key, length);
+            _nodes[split].children[bit_at(key, common)] = leaf;
+            current = leaf;
+        }
+        break;
+    }
+
+    if (not _nodes[current].has_value) {
+        _size++;
+    }
+    _nodes[current].has_value = true;
+    _nodes[current].value = value;
+}
+
+//! \details Afterwards, a node left without a value is removed if it has no children, or replaced by its
+//! child if it has one, so that the trie stays path-compressed.
+bool PrefixTrie::erase(const uint32_t prefix, const uint8_t length) {
+    if (length > 32) {
+        return false;
+    }
+    const uint32_t key = prefix & prefix_mask(length);
+
+    uint32_t path[34];  // ancestors of `current`, at most one per prefix length
+    size_t depth = 0;
+    uint32_t current = 0;
+    while (_nodes[current].length != length) {
+        const uint32_t child = _nodes[current].children[bit_at(key, _nodes[current].length)];
+        if (child == 0 or _nodes[child].length > length or
+            (key & prefix_mask(_nodes[child].length)) != _nodes[child].prefix) {
+            return false;
+        }
+        path[depth++] = current;
+        current = child;
+    }
+    if (_nodes[current].prefix != key or not _nodes[current].has_value) {
+        return false;
+    }
+
+    _nodes[current].has_value = false;
+    _size--;
+
+    while (current != 0 and not _nodes[current].has_value) {
+        const uint32_t *const children = _nodes[current].children;
+        if (children[0] != 0 and children[1] != 0) {
+            break;
+        }
+
+        const uint32_t only_child = children[0] | children[1];
+        uint32_t *const parent_children = _nodes[path[depth - 1]].children;
+        parent_children[parent_children[0] == current ? 0 : 1] = only_child;
+        _free.push_back(current);
+
+        if (only_child != 0) {
+            break;
+        }
+        // the parent has lost a branch, so it may now be a fork with only one side
+        current = path[--depth];
+    }
+
+    return true;
+}
+
+optional<size_t> PrefixTrie::find(const uint32_t prefix, const uint8_t length) const {
+    if (length > 32) {
+        return nullopt;
+    }
+    const uint32_t key = prefix & prefix_mask(length);
+
+    uint32_t current = 0;
+    while (_nodes[current].length < length) {
+        current = _nodes[current].children[bit_at(key, _nodes[current].length)];
+        if (current == 0) {
+            return nullopt;
+        }
+    }
+
+    const Node &node = _nodes[current];
+    if (node.length != length or node.prefix != key or not node.has_value) {
+        return nullopt;
+    }
+    return node.value;
+}
+
+optional<size_t> PrefixTrie::lookup(const uint32_t address) const {
+    optional<size_t> best;
+
+    uint32_t current = 0;
+    while (true) {
+        const Node &node = _nodes[current];
+        if (node.has_value) {
+            best = node.value;
+        }
+        if (node.length == 32) {
+            break;
+        }
+
+        const uint32_t child = node.children[bit_at(address, node.length)];
+        if (child == 0 or (address & prefix_mask(_nodes[child].length)) != _nodes[child].prefix) {
+            break;
+        }
+        current = child;
+    }
+
+    return best;
+}
@@ -0,0 +1,48 @@
+#ifndef SPONGE_LIBSPONGE_PREFIX_TRIE_HH
+#define SPONGE_LIBSPONGE_PREFIX_TRIE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+//! \brief Longest-prefix-match table from IPv4 prefixes to values, stored as a path-compressed binary trie
+//! \details Every node is either a prefix that holds a value or a fork with two children, so a lookup visits
+//! at most one node per distinct prefix length along the address's path (never more than 33), whatever
+//! the number of prefixes. Nodes live in one vector and refer to each other by index; erased nodes are
+//! recycled by later inserts.
+class PrefixTrie {
+  private:
+    struct Node {
+        uint32_t prefix{};           //!< the prefix, with the bits past `length` cleared
+        uint8_t length{};            //!< prefix length in bits (0 to 32)
+        bool has_value{};            //!< does this node hold a prefix, or is it only a fork?
+        size_t value{};              //!< the prefix's value, if `has_value`
+        uint32_t children[2]{0, 0};  //!< subtrees for a next bit of 0 and 1 (0 means none: the root)
+    };
+
+    std::vector<Node> _nodes{Node{}};  //!< node 0 is the root, the zero-length prefix
+    std::vector<uint32_t> _free{};     //!< indices of erased nodes, available for reuse
+    size_t _size{0};                   //!< number of prefixes held
+
+    uint32_t _new_node(const uint32_t prefix, const uint8_t length);
+
+  public:
+    //! Add a prefix (bits past `length` are ignored), or replace the value of one already present
+    void insert(const uint32_t prefix, const uint8_t length, const size_t value);
+
+    //! \brief Remove a prefix
+    //! \returns `true` if the prefix was present
+    bool erase(const uint32_t prefix, const uint8_t length);
+
+    //! \returns the value of exactly this prefix, if present
+    std::optional<size_t> find(const uint32_t prefix, const uint8_t length) const;
+
+    //! \returns the value of the longest prefix that matches `address`, if any does
+    std::optional<size_t> lookup(const uint32_t address) const;
+
+    //! Number of prefixes in the table
+    size_t size() const { return _size; }
+};
+
+#endif  // SPONGE_LIBSPONGE_PREFIX_TRIE_HH
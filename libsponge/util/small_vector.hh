@@ -0,0 +1,91 @@
+#ifndef SPONGE_LIBSPONGE_SMALL_VECTOR_HH
+#define SPONGE_LIBSPONGE_SMALL_VECTOR_HH
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+//! \brief A sequence that keeps up to `N` elements inline and only allocates beyond that
+//! \details Inline slots past size() hold default-constructed elements. Once more than `N`
+//! elements have been stored, all of them move to the heap.
+template <typename T, size_t N>
+class SmallVector {
+  private:
+    std::array<T, N> _inline{};  //!< storage while at most `N` elements are held
+    std::vector<T> _heap{};      //!< storage after overflowing `_inline`
+    size_t _size{0};             //!< number of elements
+
+    bool _spilled() const { return not _heap.empty(); }
+
+    //! Move the inline elements to the heap, to make room for more than `N`
+    void _spill() {
+        _heap.reserve(2 * N);
+        for (size_t i = 0; i < _size; i++) {
+            _heap.push_back(std::move(_inline[i]));
+            _inline[i] = T{};
+        }
+    }
+
+  public:
+    //! \name Element access
+    //!@{
+    T *data() { return _spilled() ? _heap.data() : _inline.data(); }
+    const T *data() const { return _spilled() ? _heap.data() : _inline.data(); }
+    T *begin() { return data(); }
+    T *end() { return data() + _size; }
+    const T *begin() const { return data(); }
+    const T *end() const { return data() + _size; }
+    T &front() { return data()[0]; }
+    const T &front() const { return data()[0]; }
+    T &operator[](const size_t i) { return data()[i]; }
+    const T &operator[](const size_t i) const { return data()[i]; }
+    //!@}
+
+    //! \brief Number of elements
+    size_t size() const { return _size; }
+
+    //! \brief Are there no elements?
+    bool empty() const { return _size == 0; }
+
+    //! \brief Add an element at the end
+    void push_back(T value) {
+        if (not _spilled() and _size < N) {
+            _inline[_size] = std::move(value);
+        } else {
+            if (not _spilled()) {
+                _spill();
+            }
+            _heap.push_back(std::move(value));
+        }
+        _size++;
+    }
+
+    //! \brief Add an element at the front
+    void push_front(T value) {
+        if (not _spilled() and _size < N) {
+            std::move_backward(_inline.begin(), _inline.begin() + _size, _inline.begin() + _size + 1);
+            _inline[0] = std::move(value);
+        } else {
+            if (not _spilled()) {
+                _spill();
+            }
+            _heap.insert(_heap.begin(), std::move(value));
+        }
+        _size++;
+    }
+
+    //! \brief Remove the first `n` elements
+    void erase_front(const size_t n) {
+        if (_spilled()) {
+            _heap.erase(_heap.begin(), _heap.begin() + n);
+        } else {
+            std::move(_inline.begin() + n, _inline.begin() + _size, _inline.begin());
+            std::fill(_inline.begin() + _size - n, _inline.begin() + _size, T{});
+        }
+        _size -= n;
+    }
+};
+
+#endif  // SPONGE_LIBSPONGE_SMALL_VECTOR_HH
@@ -3,6 +3,8 @@
 #include "util.hh"
 
 #include <cstddef>
+#include <cstring>
+#include <netinet/udp.h>
 #include <stdexcept>
 #include <unistd.h>
 
@@ -112,6 +114,104 @@ UDPSocket::received_datagram UDPSocket::recv(const size_t mtu) {
     return ret;
 }
 
+//! Suitably aligned room for one control message carrying a UDP_GRO or UDP_SEGMENT segment size
+union ControlBuffer {
+    char buf[CMSG_SPACE(sizeof(int))];  //!< the control message itself
+    cmsghdr align;                      //!< forces alignment for CMSG_FIRSTHDR
+};
+
+//! Scratch space for recvmmsg(), reused by every UDPSocket::recv_batch call on the same thread
+struct RecvBatchScratch {
+    vector<Buffer> buffers{};          //!< one mtu-sized landing buffer per datagram, drawn from the BufferPool
+    vector<Address::Raw> addresses{};  //!< source address of each datagram
+    vector<iovec> iovecs{};            //!< one iovec per landing buffer
+    vector<ControlBuffer> controls{};  //!< ancillary data (the GRO segment size) for each datagram
+    vector<mmsghdr> headers{};         //!< the array handed to recvmmsg()
+
+    //! Make room for `count` datagrams of up to `mtu` bytes and reset the headers the kernel overwrites
+    void prepare(const size_t count, const size_t mtu) {
+        if (buffers.size() < count) {
+            buffers.resize(count);
+            addresses.resize(count);
+            iovecs.resize(count);
+            controls.resize(count);
+            headers.resize(count);
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (buffers[i].size() < mtu) {
+                buffers[i] = Buffer::allocate(mtu);
+            }
+            iovecs[i] = {buffers[i].mutable_data(), mtu};
+            headers[i] = {};
+            headers[i].msg_hdr.msg_name = static_cast<sockaddr *>(addresses[i]);
+            headers[i].msg_hdr.msg_namelen = sizeof(Address::Raw);
+            headers[i].msg_hdr.msg_iov = &iovecs[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+            headers[i].msg_hdr.msg_control = static_cast<char *>(controls[i].buf);
+            headers[i].msg_hdr.msg_controllen = sizeof(controls[i].buf);
+        }
+    }
+};
+
+//! \returns the segment size from a UDP_GRO control message, or 0 if the datagram was not coalesced
+static size_t gro_segment_size(msghdr &header) {
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(&header); cmsg != nullptr; cmsg = CMSG_NXTHDR(&header, cmsg)) {
+        if (cmsg->cmsg_level == SOL_UDP and cmsg->cmsg_type == UDP_GRO) {
+            int segment_size = 0;
+            memcpy(&segment_size, CMSG_DATA(cmsg), sizeof(segment_size));
+            return segment_size;
+        }
+    }
+    return 0;
+}
+
+//! \param[out] datagrams is cleared and then filled with the received datagrams (at least one)
+//! \param[in] max_datagrams is the most datagrams to receive in this call
+//! \param[in] mtu is the largest datagram payload accepted
+//! \details Blocks until at least one datagram is available, then collects whatever else is already
+//! queued on the socket (up to `max_datagrams`) without blocking again. The kernel writes each datagram
+//! into an mtu-sized landing buffer from the BufferPool. As with FileDescriptor::read, a datagram that fits
+//! a small block is copied into one, so that e.g. a 1 KB datagram does not pin a 64 KiB block for as long
+//! as its payload is kept, and the landing buffer is kept for the next call. Anything bigger (in practice
+//! a GRO train) is handed to the caller in its landing buffer, without a copy.
+//! \note If `mtu` is too small to hold a received datagram, this method throws a std::runtime_error
+void UDPSocket::recv_batch(vector<received_buffer> &datagrams, const size_t max_datagrams, const size_t mtu) {
+    thread_local RecvBatchScratch scratch;
+
+    datagrams.clear();
+    if (max_datagrams == 0) {
+        return;
+    }
+    scratch.prepare(max_datagrams, mtu);
+
+    const int count = SystemCall(
+        "recvmmsg",
+        ::recvmmsg(fd_num(), scratch.headers.data(), max_datagrams, MSG_WAITFORONE | MSG_TRUNC, nullptr));
+
+    register_read();
+    for (size_t i = 0; i < size_t(count); i++) {
+        auto &header = scratch.headers[i];
+        if (header.msg_len > mtu) {
+            throw runtime_error("recvmmsg (oversized datagram)");
+        }
+        const size_t segment_size = gro_segment_size(header.msg_hdr);
+        Buffer payload;
+        if (header.msg_len > BufferPool::SMALL_BLOCK_SIZE) {
+            payload = move(scratch.buffers[i]);
+            scratch.buffers[i] = {};
+            payload.remove_suffix(payload.size() - header.msg_len);
+        } else if (header.msg_len > 0) {
+            payload = Buffer::allocate(header.msg_len);
+            memcpy(payload.mutable_data(), scratch.buffers[i].str().data(), header.msg_len);
+        }
+        datagrams.push_back({{scratch.addresses[i], header.msg_hdr.msg_namelen}, move(payload), segment_size});
+    }
+}
+
+//! \details Once enabled, a datagram returned by recv_batch() may hold several wire datagrams back to back,
+//! each `segment_size` bytes long except possibly the last.
+void UDPSocket::set_gro() { setsockopt(SOL_UDP, UDP_GRO, int(true)); }
+
 void sendmsg_helper(const int fd_num,
                     const sockaddr *destination_address,
                     const socklen_t destination_address_len,
@@ -141,6 +241,85 @@ void UDPSocket::send(const BufferViewList &payload) {
     register_write();
 }
 
+//! Most segments the kernel accepts in one UDP_SEGMENT send
+static constexpr size_t MAX_GSO_SEGMENTS = 64;
+
+//! Largest UDP payload that fits in one IPv4 datagram
+static constexpr size_t MAX_GSO_BYTES = 65507;
+
+//! \param[in] destination is the Address every datagram is sent to
+//! \param[in] payloads are the datagram payloads, sent in order
+//! \param[in] segmentation_offload coalesces runs of equal-size payloads into UDP_SEGMENT sends
+//! \details [sendmmsg(2)](\ref man2::sendmmsg) may accept only part of the batch; the remainder is resubmitted.
+void UDPSocket::send_batch(const Address &destination,
+                           const vector<BufferViewList> &payloads,
+                           const bool segmentation_offload) {
+    //! One sendmmsg() entry: a single datagram, or a train of them for the kernel to segment
+    struct Message {
+        vector<iovec> iovecs;
+        size_t size;
+        uint16_t segment_size;
+    };
+
+    vector<Message> groups;
+    for (size_t i = 0; i < payloads.size();) {
+        const size_t segment_size = payloads[i].size();
+        const auto first = payloads[i].as_iovecs();
+        Message group{{first.begin(), first.end()}, segment_size, 0};
+        size_t next = i + 1;
+        if (segmentation_offload and segment_size > 0) {
+            // extend the run while every payload but the last is exactly `segment_size` bytes
+            while (next < payloads.size() and next - i < MAX_GSO_SEGMENTS and
+                   payloads[next - 1].size() == segment_size and payloads[next].size() > 0 and
+                   payloads[next].size() <= segment_size and group.size + payloads[next].size() <= MAX_GSO_BYTES) {
+                const auto more = payloads[next].as_iovecs();
+                group.iovecs.insert(group.iovecs.end(), more.begin(), more.end());
+                group.size += payloads[next].size();
+                next++;
+            }
+            if (next - i > 1) {
+                group.segment_size = segment_size;
+            }
+        }
+        groups.push_back(move(group));
+        i = next;
+    }
+
+    vector<ControlBuffer> controls(groups.size());
+    vector<mmsghdr> messages(groups.size());
+    for (size_t i = 0; i < groups.size(); i++) {
+        auto &message = messages[i].msg_hdr;
+        message.msg_name = const_cast<sockaddr *>(static_cast<const sockaddr *>(destination));
+        message.msg_namelen = destination.size();
+        message.msg_iov = groups[i].iovecs.data();
+        message.msg_iovlen = groups[i].iovecs.size();
+
+        if (groups[i].segment_size > 0) {
+            message.msg_control = static_cast<char *>(controls[i].buf);
+            message.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+            cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            memcpy(CMSG_DATA(cmsg), &groups[i].segment_size, sizeof(uint16_t));
+        }
+    }
+
+    size_t sent = 0;
+    while (sent < messages.size()) {
+        const int count =
+            SystemCall("sendmmsg", ::sendmmsg(fd_num(), messages.data() + sent, messages.size() - sent, 0));
+        for (size_t i = sent; i < sent + size_t(count); i++) {
+            if (messages[i].msg_len != groups[i].size) {
+                throw runtime_error("datagram payload too big for sendmmsg()");
+            }
+        }
+        sent += count;
+    }
+
+    register_write();
+}
+
 // mark the socket as listening for incoming connections
 //! \param[in] backlog is the number of waiting connections to queue (see [listen(2)](\ref man2::listen))
 void TCPSocket::listen(const int backlog) { SystemCall("listen", ::listen(fd_num(), backlog)); }
@@ -8,6 +8,7 @@
 #include <functional>
 #include <string>
 #include <sys/socket.h>
+#include <vector>
 
 //! \brief Base class for network sockets (TCP, UDP, etc.)
 //! \details Socket is generally used via a subclass. See TCPSocket and UDPSocket for usage examples.
@@ -70,11 +71,33 @@ class UDPSocket : public Socket {
     //! Receive a datagram and the Address of its sender (caller can allocate storage)
     void recv(received_datagram &datagram, const size_t mtu = 65536);
 
+    //! Returned by UDPSocket::recv_batch; carries received data as a Buffer that can be parsed without a copy
+    struct received_buffer {
+        Address source_address;  //!< Address from which this datagram was received
+        Buffer payload;          //!< UDP datagram payload
+        size_t segment_size;     //!< If nonzero, `payload` is a train of datagrams of this size coalesced by GRO
+    };
+
+    //! Receive up to `max_datagrams` datagrams with a single [recvmmsg(2)](\ref man2::recvmmsg)
+    void recv_batch(std::vector<received_buffer> &datagrams,
+                    const size_t max_datagrams = 32,
+                    const size_t mtu = 65536);
+
+    //! Let the kernel coalesce consecutive datagrams from the same flow ([UDP_GRO](\ref man7::udp))
+    void set_gro();
+
     //! Send a datagram to specified Address
     void sendto(const Address &destination, const BufferViewList &payload);
 
     //! Send datagram to the socket's connected address (must call connect() first)
     void send(const BufferViewList &payload);
+
+    //! Send several datagrams to the specified Address with as few [sendmmsg(2)](\ref man2::sendmmsg) calls as possible
+    //! \details With `segmentation_offload`, each run of equal-size datagrams (the last may be shorter)
+    //! is passed to the kernel as one message and split by [UDP_SEGMENT](\ref man7::udp).
+    void send_batch(const Address &destination,
+                    const std::vector<BufferViewList> &payloads,
+                    const bool segmentation_offload = false);
 };
 
 //! \class UDPSocket
@@ -83,6 +106,10 @@ class UDPSocket : public Socket {
 //! Example:
 //!
 //! \include socket_example_1.cc
+//!
+//! Batched example:
+//!
+//! \include socket_example_4.cc
 
 //! A wrapper around [TCP sockets](\ref man7::tcp)
 class TCPSocket : public Socket {
@@ -0,0 +1,75 @@
+#ifndef SPONGE_LIBSPONGE_SPSC_RING_HH
+#define SPONGE_LIBSPONGE_SPSC_RING_HH
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+//! \brief Bounded lock-free queue between exactly one producer thread and one consumer thread
+//! \details The producer only writes `_tail` and the consumer only writes `_head`, each with release
+//! ordering, so a slot's contents are visible before its index is. Each side also keeps a private copy of
+//! the other side's index and only re-reads the shared one when that copy says the ring is full (or
+//! empty), so in the common case neither side touches the other's cache line.
+template <typename T>
+class SpscRing {
+  private:
+    static constexpr size_t CACHE_LINE = 64;
+
+    std::vector<T> _slots;
+    const size_t _mask;
+
+    alignas(CACHE_LINE) std::atomic<size_t> _head{0};  //!< next slot to pop (written by the consumer)
+    size_t _cached_tail{0};                            //!< consumer's last view of `_tail`
+
+    alignas(CACHE_LINE) std::atomic<size_t> _tail{0};  //!< next slot to push (written by the producer)
+    size_t _cached_head{0};                            //!< producer's last view of `_head`
+
+  public:
+    //! \param[in] capacity the number of slots, which must be a power of two
+    explicit SpscRing(const size_t capacity) : _slots(capacity), _mask(capacity - 1) {
+        if (capacity == 0 or (capacity & _mask) != 0) {
+            throw std::invalid_argument("SpscRing: capacity must be a power of two");
+        }
+    }
+
+    //! \brief Add an item (producer only)
+    //! \returns `false`, leaving `item` untouched, if the ring is full
+    bool push(T &&item) {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _cached_head == _slots.size()) {
+            _cached_head = _head.load(std::memory_order_acquire);
+            if (tail - _cached_head == _slots.size()) {
+                return false;
+            }
+        }
+        _slots[tail & _mask] = std::move(item);
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    //! \brief Remove the oldest item (consumer only)
+    //! \returns `false` if the ring is empty
+    bool pop(T &item) {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _cached_tail) {
+            _cached_tail = _tail.load(std::memory_order_acquire);
+            if (head == _cached_tail) {
+                return false;
+            }
+        }
+        // leave the slot empty, so it does not hold on to resources (e.g. packet buffers) until it is reused
+        item = std::exchange(_slots[head & _mask], T{});
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    //! Number of items (exact for the consumer, which is the only side that removes them)
+    size_t size() const { return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_relaxed); }
+
+    //! Number of slots
+    size_t capacity() const { return _slots.size(); }
+};
+
+#endif  // SPONGE_LIBSPONGE_SPSC_RING_HH
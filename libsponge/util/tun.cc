@@ -2,35 +2,66 @@
 
 #include "util.hh"
 
+#include <cerrno>
 #include <cstring>
 #include <fcntl.h>
 #include <linux/if.h>
 #include <linux/if_tun.h>
 #include <sys/ioctl.h>
+#include <unistd.h>
 
 static constexpr const char *CLONEDEV = "/dev/net/tun";
 
+static_assert(sizeof(VirtioNetHeader) == 10, "VirtioNetHeader must match struct virtio_net_hdr");
+
 using namespace std;
 
 //! \param[in] devname is the name of the TUN or TAP device, specified at its creation.
 //! \param[in] is_tun is `true` for a TUN device (expects IP datagrams), or `false` for a TAP device (expects Ethernet frames)
+//! \param[in] multi_queue is `true` to open a new queue of a device created with `multi_queue`. If the device
+//! was created without it, this opens the device's only queue instead.
+//! \param[in] vnet_hdr is `true` to prefix every packet with a VirtioNetHeader and turn on checksum
+//! offload and TSO, so the kernel may pass up partially checksummed and GRO-coalesced packets. The setting
+//! belongs to the device, not the queue, so every queue of a device should be opened with the same value.
 //!
 //! To create a TUN device, you should already have run
 //!
-//!     ip tuntap add mode tun user `username` name `devname`
+//!     ip tuntap add mode tun multi_queue user `username` name `devname`
 //!
 //! as root before calling this function.
 
-TunTapFD::TunTapFD(const string &devname, const bool is_tun)
-    : FileDescriptor(SystemCall("open", open(CLONEDEV, O_RDWR))) {
+TunTapFD::TunTapFD(const string &devname, const bool is_tun, const bool multi_queue, const bool vnet_hdr)
+    : FileDescriptor(SystemCall("open", open(CLONEDEV, O_RDWR))), _vnet_hdr(vnet_hdr), _multi_queue(false) {
     struct ifreq tun_req {};
 
-    tun_req.ifr_flags = (is_tun ? IFF_TUN : IFF_TAP) | IFF_NO_PI;  // tun device with no packetinfo
+    const short flags = (is_tun ? IFF_TUN : IFF_TAP) | IFF_NO_PI | (vnet_hdr ? IFF_VNET_HDR : 0);
+    tun_req.ifr_flags = flags;  // tun device with no packetinfo
+    if (multi_queue) {
+        tun_req.ifr_flags |= IFF_MULTI_QUEUE;
+    }
 
     // copy devname to ifr_name, making sure to null terminate
 
     strncpy(static_cast<char *>(tun_req.ifr_name), devname.data(), IFNAMSIZ - 1);
     tun_req.ifr_name[IFNAMSIZ - 1] = '\0';
 
-    SystemCall("ioctl", ioctl(fd_num(), TUNSETIFF, static_cast<void *>(&tun_req)));
+    // the kernel refuses IFF_MULTI_QUEUE (with EINVAL) for a device created without it
+    _multi_queue =
+        multi_queue and SystemCall("ioctl", ioctl(fd_num(), TUNSETIFF, static_cast<void *>(&tun_req)), EINVAL) == 0;
+    if (not _multi_queue) {
+        tun_req.ifr_flags = flags;
+        SystemCall("ioctl", ioctl(fd_num(), TUNSETIFF, static_cast<void *>(&tun_req)));
+    }
+
+    if (vnet_hdr) {
+        int hdr_size = sizeof(VirtioNetHeader);
+        SystemCall("ioctl", ioctl(fd_num(), TUNSETVNETHDRSZ, &hdr_size));
+    }
+
+    // offloads outlive the fd, so turn them off again unless this user asked for them
+    SystemCall("ioctl", ioctl(fd_num(), TUNSETOFFLOAD, vnet_hdr ? TUN_F_CSUM | TUN_F_TSO4 : 0));
+}
+
+TunTapFD TunTapFD::dup() const {
+    return TunTapFD(SystemCall("dup", ::dup(fd_num())), _vnet_hdr, _multi_queue);
 }
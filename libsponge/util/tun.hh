@@ -3,27 +3,73 @@
 
 #include "file_descriptor.hh"
 
+#include <cstdint>
 #include <string>
 
-//! A FileDescriptor to a [Linux TUN/TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
+//! \brief The `struct virtio_net_hdr` that starts each packet on a TUN/TAP device opened with `vnet_hdr`
+//! \details Declared here because `<linux/virtio_net.h>` is not valid C++. Fields are in host byte order.
+struct VirtioNetHeader {
+    static constexpr uint8_t F_NEEDS_CSUM = 1;  //!< checksum is partial: sum from csum_start, store at csum_offset
+    static constexpr uint8_t F_DATA_VALID = 2;  //!< checksum has already been verified
+    static constexpr uint8_t GSO_NONE = 0;      //!< an ordinary packet
+    static constexpr uint8_t GSO_TCPV4 = 1;     //!< a TCP-over-IPv4 super-segment, cut up (TSO) or merged (GRO)
+
+    uint8_t flags = 0;        //!< F_NEEDS_CSUM or F_DATA_VALID
+    uint8_t gso_type = GSO_NONE;
+    uint16_t hdr_len = 0;      //!< length of the headers repeated on each segment
+    uint16_t gso_size = 0;     //!< payload bytes in each segment but the last
+    uint16_t csum_start = 0;   //!< where checksumming starts (the TCP header)
+    uint16_t csum_offset = 0;  //!< where the checksum goes, from `csum_start`
+};
+
+//! \brief A FileDescriptor to a [Linux TUN/TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
+//! \details A device created with `multi_queue` can be opened many times at once (up to 256), and each
+//! TunTapFD opened with `multi_queue` is then a queue of its own. The kernel spreads inbound packets over
+//! the queues by a hash of each flow's addresses and ports, preferring the queue that last sent a packet
+//! of the flow (for a few seconds afterwards). That is not a guarantee that a flow reaches any particular
+//! queue: a new flow's first packet, or a packet after a pause, may go to any of them. So the queues of a
+//! device should be read by one owner that sorts out the packets itself (see TunDispatcher).
 class TunTapFD : public FileDescriptor {
+    bool _vnet_hdr;     //!< Does every packet start with a VirtioNetHeader?
+    bool _multi_queue;  //!< Is this one of several queues of the device?
+
+    //! Wrap another descriptor for the same queue
+    TunTapFD(const int fd, const bool vnet_hdr, const bool multi_queue)
+        : FileDescriptor(fd), _vnet_hdr(vnet_hdr), _multi_queue(multi_queue) {}
+
   public:
     //! Open an existing persistent [TUN or TAP device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-    explicit TunTapFD(const std::string &devname, const bool is_tun);
+    explicit TunTapFD(const std::string &devname,
+                      const bool is_tun,
+                      const bool multi_queue = false,
+                      const bool vnet_hdr = false);
+
+    //! Does every packet read or written start with a VirtioNetHeader (offloads enabled)?
+    bool vnet_hdr() const { return _vnet_hdr; }
+
+    //! Was this opened as a queue of a `multi_queue` device (so that the device can have other queues)?
+    bool multi_queue() const { return _multi_queue; }
+
+    //! \brief Another descriptor for the same queue, from [dup(2)](\ref man2::dup)
+    //! \details Unlike FileDescriptor::duplicate(), the copy has read and write counts of its own, so another
+    //! thread can use it (e.g. to write) while this one is in use.
+    TunTapFD dup() const;
 };
 
 //! A FileDescriptor to a [Linux TUN](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
 class TunFD : public TunTapFD {
   public:
     //! Open an existing persistent [TUN device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-    explicit TunFD(const std::string &devname) : TunTapFD(devname, true) {}
+    explicit TunFD(const std::string &devname, const bool multi_queue = false, const bool vnet_hdr = false)
+        : TunTapFD(devname, true, multi_queue, vnet_hdr) {}
 };
 
 //! A FileDescriptor to a [Linux TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
 class TapFD : public TunTapFD {
   public:
     //! Open an existing persistent [TAP device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-    explicit TapFD(const std::string &devname) : TunTapFD(devname, false) {}
+    explicit TapFD(const std::string &devname, const bool multi_queue = false)
+        : TunTapFD(devname, false, multi_queue) {}
 };
 
 #endif  // SPONGE_LIBSPONGE_TUN_HH
@@ -1,13 +1,20 @@
 #include "util.hh"
 
+#include <arpa/inet.h>
 #include <array>
 #include <cctype>
 #include <chrono>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <sys/socket.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SPONGE_CHECKSUM_X86 1
+#endif
+
 using namespace std;
 
 //! \returns the number of milliseconds since the program started
@@ -69,6 +76,140 @@ mt19937 get_random_generator() {
     return mt19937(seed);
 }
 
+namespace {
+
+//! Add `x` to `sum`, wrapping the carry around (ones' complement addition)
+uint64_t add_with_carry(uint64_t sum, const uint64_t x) {
+    sum += x;
+    return sum + (sum < x);
+}
+
+//! Reduce a ones' complement sum to 16 bits
+uint16_t fold(uint64_t sum) {
+    while (sum > 0xffff) {
+        sum = (sum >> 16) + (sum & 0xffff);
+    }
+    return sum;
+}
+
+// The routines below compute the ones' complement sum of `data` read as 16-bit words in *host* byte
+// order, with a trailing odd byte padded by a zero. Such a sum is congruent (mod 0xffff) to the sum of
+// wider words, so they can work on 8-, 16- or 32-byte chunks; it only needs a byte swap afterwards to
+// become the network-order sum (RFC 1071, section 2(B)). With `COPY`, they also store each chunk they
+// load to `dest`, so copying and summing take a single pass over the data.
+
+//! Portable version: 64-bit words
+template <bool COPY>
+uint64_t sum_words_portable(const char *data, size_t len, char *dest) {
+    uint64_t sum = 0;
+    for (; len >= 8; data += 8, dest += COPY ? 8 : 0, len -= 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        if constexpr (COPY) {
+            memcpy(dest, &word, 8);
+        }
+        sum = add_with_carry(sum, word);
+    }
+    if (len == 0) {
+        return sum;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, data, len);
+    if constexpr (COPY) {
+        memcpy(dest, data, len);
+    }
+    return add_with_carry(sum, tail);
+}
+
+#ifdef SPONGE_CHECKSUM_X86
+//! SSE2 version: 32-bit words, zero-extended into 64-bit lanes so the lanes never overflow
+template <bool COPY>
+__attribute__((target("sse2"))) uint64_t sum_words_sse2(const char *data, size_t len, char *dest) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc0 = zero, acc1 = zero;
+    for (; len >= 32; data += 32, dest += COPY ? 32 : 0, len -= 32) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16));
+        if constexpr (COPY) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), a);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + 16), b);
+        }
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(a, zero));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(a, zero));
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(b, zero));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(b, zero));
+    }
+
+    array<uint64_t, 4> lanes{};
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&lanes[0]), acc0);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&lanes[2]), acc1);
+    uint64_t sum = 0;
+    for (const auto lane : lanes) {
+        sum = add_with_carry(sum, lane);
+    }
+    return add_with_carry(sum, sum_words_portable<COPY>(data, len, dest));
+}
+
+//! AVX2 version: as for SSE2, with twice the width
+//! \note The tail is left to the portable routine rather than the SSE2 one: mixing VEX and legacy SSE
+//! code costs far more than the few scalar additions it would save.
+template <bool COPY>
+__attribute__((target("avx2"))) uint64_t sum_words_avx2(const char *data, size_t len, char *dest) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc0 = zero, acc1 = zero;
+    for (; len >= 64; data += 64, dest += COPY ? 64 : 0, len -= 64) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + 32));
+        if constexpr (COPY) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest), a);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + 32), b);
+        }
+        acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(a, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(a, zero));
+        acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(b, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(b, zero));
+    }
+
+    array<uint64_t, 8> lanes{};
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(&lanes[0]), acc0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(&lanes[4]), acc1);
+    _mm256_zeroupper();
+    uint64_t sum = 0;
+    for (const auto lane : lanes) {
+        sum = add_with_carry(sum, lane);
+    }
+    return add_with_carry(sum, sum_words_portable<COPY>(data, len, dest));
+}
+#endif
+
+//! A pair of summing routines (with and without copying) and their name
+struct SumImplementation {
+    uint64_t (*sum_words)(const char *data, size_t len, char *dest);
+    uint64_t (*copy_and_sum_words)(const char *data, size_t len, char *dest);
+    const char *name;
+};
+
+//! Pick the widest routines this CPU supports
+SumImplementation select_implementation() {
+#ifdef SPONGE_CHECKSUM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {sum_words_avx2<false>, sum_words_avx2<true>, "avx2"};
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return {sum_words_sse2<false>, sum_words_sse2<true>, "sse2"};
+    }
+#endif
+    return {sum_words_portable<false>, sum_words_portable<true>, "portable"};
+}
+
+const SumImplementation &selected_implementation() {
+    static const SumImplementation selected = select_implementation();
+    return selected;
+}
+
+}  // namespace
+
 //! \note This class returns the checksum in host byte order.
 //!       See https://commandcenter.blogspot.com/2012/04/byte-order-fallacy.html for rationale
 //! \details This class can be used to either check or compute an Internet checksum
@@ -86,25 +227,42 @@ mt19937 get_random_generator() {
 //! on the Internet checksum, and consult the [IP](\ref rfc::rfc791) and [TCP](\ref rfc::rfc793) RFCs.
 InternetChecksum::InternetChecksum(const uint32_t initial_sum) : _sum(initial_sum) {}
 
+//! \details `data` may have any length and alignment; successive calls checksum the concatenation
+//! of their arguments. The bytes are summed with the widest vector instructions the CPU supports.
 void InternetChecksum::add(std::string_view data) {
-    for (size_t i = 0; i < data.size(); i++) {
-        uint16_t val = uint8_t(data[i]);
-        if (not _parity) {
-            val <<= 8;
-        }
-        _sum += val;
-        _parity = !_parity;
-    }
+    _add_host_order_sum(selected_implementation().sum_words(data.data(), data.size(), nullptr), data.size());
 }
 
-uint16_t InternetChecksum::value() const {
-    uint32_t ret = _sum;
+//! \details Equivalent to `memcpy(dest, data.data(), data.size())` followed by `add(data)`, but reads
+//! the bytes only once. `dest` must not overlap `data`.
+void InternetChecksum::copy_and_add(char *dest, std::string_view data) {
+    _add_host_order_sum(selected_implementation().copy_and_sum_words(data.data(), data.size(), dest), data.size());
+}
 
-    while (ret > 0xffff) {
-        ret = (ret >> 16) + (ret & 0xffff);
+void InternetChecksum::_add_host_order_sum(const uint64_t sum, const size_t len) {
+    uint16_t partial = ntohs(fold(sum));
+    if (_parity) {
+        // the chunk starts halfway through a 16-bit word, so each of its bytes belongs in the other half
+        partial = (partial << 8) | (partial >> 8);
     }
+    _sum += partial;
+    _parity ^= len % 2;
+}
+
+uint16_t InternetChecksum::value() const { return ~fold(_sum); }
+
+const char *InternetChecksum::implementation() { return selected_implementation().name; }
 
-    return ~ret;
+//! \param[in] checksum is the current checksum field
+//! \param[in] old_sum is the ones' complement sum of the changed 16-bit words before the change (e.g. just one word)
+//! \param[in] new_sum is the same sum after the change
+//! \returns the checksum field for the changed data, computed without re-summing any of it
+//! \details Uses equation 3 of RFC 1624, `HC' = ~(~HC + ~m + m')`, which never produces a -0 checksum.
+uint16_t InternetChecksum::adjust(const uint16_t checksum, const uint32_t old_sum, const uint32_t new_sum) {
+    uint64_t sum = uint16_t(~checksum);
+    sum += uint16_t(~fold(old_sum));
+    sum += fold(new_sum);
+    return ~fold(sum);
 }
 
 //! \param[in] data is a pointer to the bytes to show
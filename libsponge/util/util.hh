@@ -54,13 +54,26 @@ uint64_t timestamp_ms();
 //! The internet checksum algorithm
 class InternetChecksum {
   private:
-    uint32_t _sum;
+    uint64_t _sum;
     bool _parity{};
 
+    //! Fold in the sum of `len` bytes, computed over 16-bit words in host byte order
+    void _add_host_order_sum(const uint64_t sum, const size_t len);
+
   public:
     InternetChecksum(const uint32_t initial_sum = 0);
     void add(std::string_view data);
+
+    //! Copy `data` to `dest` and add it to the checksum, in a single pass over the bytes
+    void copy_and_add(char *dest, std::string_view data);
     uint16_t value() const;
+
+    //! Name of the summing routine selected for this CPU (e.g. "avx2")
+    static const char *implementation();
+
+    //! \brief Update `checksum` after data it covers changed from `old_sum` to `new_sum`
+    //! ([RFC 1624](\ref rfc::rfc1624))
+    static uint16_t adjust(const uint16_t checksum, const uint32_t old_sum, const uint32_t new_sum);
 };
 
 //! Hexdump the contents of a packet (or any other sequence of bytes)
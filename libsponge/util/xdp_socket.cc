@@ -0,0 +1,386 @@
+#include "xdp_socket.hh"
+
+#include "util.hh"
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <mutex>
+#include <net/if.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+//! Bytes the kernel leaves free in front of each received frame, on top of its own XDP_PACKET_HEADROOM
+constexpr uint32_t UMEM_HEADROOM = BufferPool::PLACEMENT_OVERHEAD;
+
+template <typename T>
+T load_acquire(const T &field) {
+    return __atomic_load_n(&field, __ATOMIC_ACQUIRE);
+}
+
+template <typename T>
+void store_release(T &field, const T value) {
+    __atomic_store_n(&field, value, __ATOMIC_RELEASE);
+}
+
+//! \brief One of the four rings of an AF_XDP socket, as mapped from the kernel
+//! \details The producer and consumer indices run freely and wrap; the descriptors are indexed modulo the
+//! ring's size. Each side keeps cached copies of both indices so that it reads the other side's index
+//! only when the cached one says the ring is empty (or full).
+template <typename Desc>
+struct XskRing {
+    char *map{nullptr};
+    size_t map_size{0};
+    uint32_t *producer{nullptr};
+    uint32_t *consumer{nullptr};
+    uint32_t *flags{nullptr};
+    Desc *descs{nullptr};
+    uint32_t cached_producer{0};
+    uint32_t cached_consumer{0};
+
+    //! Map the ring at page offset `pgoff` of `fd`, with the kernel's layout `offsets`
+    void map_ring(const int fd, const xdp_ring_offset &offsets, const off_t pgoff) {
+        map_size = offsets.desc + XDPSocketFD::RING_SIZE * sizeof(Desc);
+        void *const ring = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, pgoff);
+        if (ring == MAP_FAILED) {
+            throw unix_error("mmap");
+        }
+        map = static_cast<char *>(ring);
+        producer = reinterpret_cast<uint32_t *>(map + offsets.producer);
+        consumer = reinterpret_cast<uint32_t *>(map + offsets.consumer);
+        flags = reinterpret_cast<uint32_t *>(map + offsets.flags);
+        descs = reinterpret_cast<Desc *>(map + offsets.desc);
+        cached_producer = *producer;
+        cached_consumer = *consumer;
+    }
+
+    void unmap() {
+        if (map) {
+            munmap(map, map_size);
+        }
+    }
+
+    Desc &at(const uint32_t index) { return descs[index & (XDPSocketFD::RING_SIZE - 1)]; }
+
+    //! (consumer side) Descriptors ready to be consumed
+    uint32_t ready() {
+        if (cached_producer == cached_consumer) {
+            cached_producer = load_acquire(*producer);
+        }
+        return cached_producer - cached_consumer;
+    }
+
+    //! (producer side) Descriptors free to be produced
+    uint32_t space() {
+        if (cached_producer - cached_consumer == XDPSocketFD::RING_SIZE) {
+            cached_consumer = load_acquire(*consumer);
+        }
+        return XDPSocketFD::RING_SIZE - (cached_producer - cached_consumer);
+    }
+
+    bool needs_wakeup() const { return load_acquire(*flags) & XDP_RING_NEED_WAKEUP; }
+};
+
+//! \brief Call [bpf(2)](\ref man2::bpf)
+//! \returns the new file descriptor, for commands that create one
+int bpf(const bpf_cmd cmd, bpf_attr &attr) {
+    return SystemCall("bpf", static_cast<int>(syscall(SYS_bpf, cmd, &attr, sizeof(attr))));
+}
+
+//! \brief Load an XDP program that redirects every frame to the socket in `xsk_map` for the frame's queue
+//! \details Frames on queues with no socket in the map are passed on to the kernel's own stack.
+FileDescriptor load_redirect_program(const FileDescriptor &xsk_map) {
+    const array<bpf_insn, 6> program{{
+        // r2 = ctx->rx_queue_index
+        {BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_1, static_cast<int16_t>(offsetof(xdp_md, rx_queue_index)), 0},
+        // r1 = xsk_map (a 64-bit immediate, in two instructions)
+        {BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, xsk_map.fd_num()},
+        {0, 0, 0, 0, 0},
+        // r3 = XDP_PASS, the action if the map has no socket for the queue
+        {BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS},
+        // return bpf_redirect_map(r1, r2, r3)
+        {BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map},
+        {BPF_JMP | BPF_EXIT, 0, 0, 0, 0},
+    }};
+    static constexpr char license[] = "GPL";
+
+    bpf_attr attr{};
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = reinterpret_cast<uintptr_t>(program.data());
+    attr.insn_cnt = program.size();
+    attr.license = reinterpret_cast<uintptr_t>(license);
+    return FileDescriptor(bpf(BPF_PROG_LOAD, attr));
+}
+
+}  // namespace
+
+//! \brief The UMEM and the socket's rings, which stay mapped until the XDPSocketFD is gone and no Buffer
+//! refers to a UMEM frame
+//! \details Frames not owned by the kernel or by a Buffer are kept on a free list, from which the fill
+//! ring is refilled and frames to send are taken. Buffers may be released on any thread, so the free list
+//! is guarded by a mutex.
+class XDPSocketFD::Umem : public BlockOwner {
+  public:
+    char *const memory;
+
+    XskRing<xdp_desc> rx{};
+    XskRing<xdp_desc> tx{};
+    XskRing<uint64_t> fill{};
+    XskRing<uint64_t> completion{};
+
+    std::mutex free_mutex{};
+    std::vector<uint64_t> free_frames{};  //!< UMEM offsets of the free frames
+
+    std::atomic<size_t> refs{1};  //!< the XDPSocketFD, plus each Buffer over a UMEM frame
+
+    explicit Umem(char *umem_memory) : memory(umem_memory) {
+        free_frames.reserve(FRAME_COUNT);
+        for (size_t i = 0; i < FRAME_COUNT; i++) {
+            free_frames.push_back(i * FRAME_SIZE);
+        }
+    }
+
+    ~Umem() override {
+        rx.unmap();
+        tx.unmap();
+        fill.unmap();
+        completion.unmap();
+        munmap(memory, FRAME_SIZE * FRAME_COUNT);
+    }
+
+    Umem(const Umem &other) = delete;
+    Umem &operator=(const Umem &other) = delete;
+
+    //! Hand free frames to the kernel, to receive into
+    void refill() {
+        lock_guard<mutex> lock(free_mutex);
+        const uint32_t count = min<size_t>(fill.space(), free_frames.size());
+        for (uint32_t i = 0; i < count; i++) {
+            fill.at(fill.cached_producer++) = free_frames.back();
+            free_frames.pop_back();
+        }
+        if (count > 0) {
+            store_release(*fill.producer, fill.cached_producer);
+        }
+    }
+
+    //! Take back the frames the kernel has finished sending
+    void reap_completions() {
+        const uint32_t count = completion.ready();
+        if (count == 0) {
+            return;
+        }
+        lock_guard<mutex> lock(free_mutex);
+        for (uint32_t i = 0; i < count; i++) {
+            free_frames.push_back(completion.at(completion.cached_consumer++));
+        }
+        store_release(*completion.consumer, completion.cached_consumer);
+    }
+
+    //! \returns the UMEM offset of a free frame, if any
+    optional<uint64_t> take_free_frame() {
+        lock_guard<mutex> lock(free_mutex);
+        if (free_frames.empty()) {
+            return {};
+        }
+        const uint64_t frame = free_frames.back();
+        free_frames.pop_back();
+        return frame;
+    }
+
+    void free_frame(const uint64_t frame) {
+        lock_guard<mutex> lock(free_mutex);
+        free_frames.push_back(frame);
+    }
+
+    void unref() {
+        if (refs.fetch_sub(1, memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    //! A Buffer over a received frame has been released
+    void release_block(const char *data) override {
+        free_frame((data - memory) & ~uint64_t{FRAME_SIZE - 1});
+        unref();
+    }
+};
+
+void XDPSocketFD::UmemRelease::operator()(Umem *umem) const { umem->unref(); }
+
+XDPSocketFD::XDPSocketFD(const string &devname, const unsigned queue_id, const bool generic_xdp)
+    : FileDescriptor(SystemCall("socket", socket(AF_XDP, SOCK_RAW, 0))), _umem(nullptr) {
+    const unsigned ifindex = if_nametoindex(devname.c_str());
+    if (ifindex == 0) {
+        throw unix_error("if_nametoindex");
+    }
+
+    // register the UMEM, aligned to a page and so to FRAME_SIZE
+    void *const memory =
+        mmap(nullptr, FRAME_SIZE * FRAME_COUNT, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        throw unix_error("mmap");
+    }
+    _umem.reset(new Umem(static_cast<char *>(memory)));
+
+    xdp_umem_reg umem_reg{};
+    umem_reg.addr = reinterpret_cast<uintptr_t>(memory);
+    umem_reg.len = FRAME_SIZE * FRAME_COUNT;
+    umem_reg.chunk_size = FRAME_SIZE;
+    umem_reg.headroom = UMEM_HEADROOM;
+    SystemCall("setsockopt", setsockopt(fd_num(), SOL_XDP, XDP_UMEM_REG, &umem_reg, sizeof(umem_reg)));
+
+    // size and map the rings
+    const int ring_size = RING_SIZE;
+    for (const int ring : {XDP_UMEM_FILL_RING, XDP_UMEM_COMPLETION_RING, XDP_RX_RING, XDP_TX_RING}) {
+        SystemCall("setsockopt", setsockopt(fd_num(), SOL_XDP, ring, &ring_size, sizeof(ring_size)));
+    }
+    xdp_mmap_offsets offsets{};
+    socklen_t offsets_len = sizeof(offsets);
+    SystemCall("getsockopt", getsockopt(fd_num(), SOL_XDP, XDP_MMAP_OFFSETS, &offsets, &offsets_len));
+    _umem->rx.map_ring(fd_num(), offsets.rx, XDP_PGOFF_RX_RING);
+    _umem->tx.map_ring(fd_num(), offsets.tx, XDP_PGOFF_TX_RING);
+    _umem->fill.map_ring(fd_num(), offsets.fr, XDP_UMEM_PGOFF_FILL_RING);
+    _umem->completion.map_ring(fd_num(), offsets.cr, XDP_UMEM_PGOFF_COMPLETION_RING);
+
+    // give the kernel half of the frames to receive into, keeping the rest for sending
+    {
+        lock_guard<mutex> lock(_umem->free_mutex);
+        for (size_t i = 0; i < FRAME_COUNT / 2; i++) {
+            _umem->fill.at(_umem->fill.cached_producer++) = _umem->free_frames.back();
+            _umem->free_frames.pop_back();
+        }
+        store_release(*_umem->fill.producer, _umem->fill.cached_producer);
+    }
+
+    sockaddr_xdp address{};
+    address.sxdp_family = AF_XDP;
+    address.sxdp_flags = XDP_USE_NEED_WAKEUP | (generic_xdp ? XDP_COPY : 0);
+    address.sxdp_ifindex = ifindex;
+    address.sxdp_queue_id = queue_id;
+    SystemCall("bind", bind(fd_num(), reinterpret_cast<const sockaddr *>(&address), sizeof(address)));
+
+    // steer the queue's frames to this socket
+    bpf_attr map_attr{};
+    map_attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    map_attr.key_size = sizeof(uint32_t);
+    map_attr.value_size = sizeof(uint32_t);
+    map_attr.max_entries = queue_id + 1;
+    const FileDescriptor xsk_map(bpf(BPF_MAP_CREATE, map_attr));
+
+    const uint32_t key = queue_id;
+    const uint32_t value = fd_num();
+    bpf_attr update_attr{};
+    update_attr.map_fd = xsk_map.fd_num();
+    update_attr.key = reinterpret_cast<uintptr_t>(&key);
+    update_attr.value = reinterpret_cast<uintptr_t>(&value);
+    bpf(BPF_MAP_UPDATE_ELEM, update_attr);
+
+    const FileDescriptor program = load_redirect_program(xsk_map);
+    bpf_attr link_attr{};
+    link_attr.link_create.prog_fd = program.fd_num();
+    link_attr.link_create.target_ifindex = ifindex;
+    link_attr.link_create.attach_type = BPF_XDP;
+    link_attr.link_create.flags = generic_xdp ? XDP_FLAGS_SKB_MODE : 0;
+    _xdp_link.emplace(bpf(BPF_LINK_CREATE, link_attr));
+}
+
+//! \details A frame that has room in front of it for a BufferBlock is returned in place. Otherwise (if the
+//! kernel laid out the frame differently than expected) it is copied into a Buffer from the pool.
+optional<Buffer> XDPSocketFD::read_frame() {
+    register_read();
+    Umem &umem = *_umem;
+    umem.refill();
+    if (umem.rx.ready() == 0) {
+        return {};
+    }
+
+    const xdp_desc desc = umem.rx.at(umem.rx.cached_consumer++);
+    store_release(*umem.rx.consumer, umem.rx.cached_consumer);
+
+    char *const data = umem.memory + desc.addr;
+    const uint64_t frame = desc.addr & ~uint64_t{FRAME_SIZE - 1};
+    const bool placeable = desc.addr - frame >= BufferPool::PLACEMENT_OVERHEAD and
+                           reinterpret_cast<uintptr_t>(data) % alignof(BufferBlock) == 0;
+    if (placeable and desc.len > 0) {
+        umem.refs.fetch_add(1, memory_order_relaxed);
+        return Buffer::adopt(BlockRef(BufferPool::place(data, desc.len, &umem)), desc.len);
+    }
+
+    Buffer copy = Buffer::allocate(desc.len);
+    memcpy(copy.mutable_data(), data, desc.len);
+    umem.free_frame(frame);
+    return copy;
+}
+
+size_t XDPSocketFD::buffered_frames() const { return _umem->rx.ready(); }
+
+//! \param[in] frame is the whole Ethernet frame, header included
+void XDPSocketFD::write_frame(const BufferViewList &frame) {
+    if (frame.size() > FRAME_SIZE) {
+        throw runtime_error("XDPSocketFD: frame too long for a UMEM frame");
+    }
+
+    Umem &umem = *_umem;
+    umem.reap_completions();
+    if (umem.tx.space() == 0) {
+        _kick_tx();
+        umem.reap_completions();
+        if (umem.tx.space() == 0) {
+            throw runtime_error("XDPSocketFD: transmit ring is full");
+        }
+    }
+    optional<uint64_t> slot = umem.take_free_frame();
+    if (not slot.has_value()) {
+        _kick_tx();
+        umem.reap_completions();
+        slot = umem.take_free_frame();
+        if (not slot.has_value()) {
+            throw runtime_error("XDPSocketFD: no free UMEM frame to send from");
+        }
+    }
+
+    char *dest = umem.memory + slot.value();
+    for (const iovec &piece : frame.as_iovecs()) {
+        memcpy(dest, piece.iov_base, piece.iov_len);
+        dest += piece.iov_len;
+    }
+    xdp_desc &desc = umem.tx.at(umem.tx.cached_producer++);
+    desc.addr = slot.value();
+    desc.len = frame.size();
+    desc.options = 0;
+    store_release(*umem.tx.producer, umem.tx.cached_producer);
+    register_write();
+}
+
+//! \details Frames the kernel could not take on an earlier flush() are offered again.
+void XDPSocketFD::flush() {
+    if (load_acquire(*_umem->tx.consumer) != _umem->tx.cached_producer) {
+        _kick_tx();
+    }
+}
+
+void XDPSocketFD::_kick_tx() {
+    if (not _umem->tx.needs_wakeup()) {
+        return;
+    }
+    // the kernel leaves frames it is momentarily unable to send on the ring, for the next flush()
+    if (sendto(fd_num(), nullptr, 0, MSG_DONTWAIT, nullptr, 0) < 0 and errno != EAGAIN and errno != EBUSY and
+        errno != ENOBUFS) {
+        throw unix_error("sendto");
+    }
+}
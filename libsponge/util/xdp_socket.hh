@@ -0,0 +1,72 @@
+#ifndef SPONGE_LIBSPONGE_XDP_SOCKET_HH
+#define SPONGE_LIBSPONGE_XDP_SOCKET_HH
+
+#include "buffer.hh"
+#include "file_descriptor.hh"
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+
+//! \brief An [AF_XDP](https://www.kernel.org/doc/html/latest/networking/af_xdp.html) socket on one queue of a
+//! network interface, with an XDP program that redirects every frame arriving on that queue to it
+//! \details Frames live in a UMEM, an area of memory shared with the kernel and divided into fixed-size
+//! frames. read_frame() returns each received frame as a Buffer over the UMEM itself, with no copy; the
+//! frame goes back to the kernel's fill ring once the Buffer is released. write_frame() copies a frame into
+//! a free UMEM frame and queues it on the transmit ring, and flush() has the kernel send every frame
+//! queued so far. The XDP program is detached when the socket is closed.
+//! \note Unlike a packet socket, an AF_XDP socket is not told whether a frame's checksums are complete. A
+//! peer on the same host (such as the other end of a veth pair) must have transmit checksum offload turned
+//! off (`ethtool -K <peer> tx off`), or its TCP segments arrive with unfinished checksums and are dropped.
+class XDPSocketFD : public FileDescriptor {
+  public:
+    //! Bytes in each UMEM frame (the smallest the kernel allows, and enough for a full-sized Ethernet frame)
+    static constexpr size_t FRAME_SIZE = 2048;
+
+    //! Frames in the UMEM, shared between receiving and sending
+    static constexpr size_t FRAME_COUNT = 4096;
+
+    //! Descriptors in each of the socket's four rings
+    static constexpr size_t RING_SIZE = 2048;
+
+  private:
+    class Umem;
+
+    //! Drops the handle's reference to the Umem, which outlives it while Buffers over UMEM frames remain
+    struct UmemRelease {
+        void operator()(Umem *umem) const;
+    };
+
+    std::unique_ptr<Umem, UmemRelease> _umem;
+
+    std::optional<FileDescriptor> _xdp_link{};  //!< keeps the XDP program attached to the interface
+
+    //! Have the kernel look at the transmit ring, if it has asked to be told
+    void _kick_tx();
+
+  public:
+    //! \brief Open an AF_XDP socket on queue `queue_id` of the network interface `devname`
+    //! \param[in] devname is the name of the network interface, e.g. one end of a veth pair
+    //! \param[in] queue_id is the receive queue to take frames from
+    //! \param[in] generic_xdp runs the XDP program in the kernel's generic (SKB) mode, which works with any
+    //! interface, instead of letting the driver run it natively
+    explicit XDPSocketFD(const std::string &devname, const unsigned queue_id = 0, const bool generic_xdp = false);
+
+    //! \brief The next frame received on the queue, without copying it
+    //! \returns an empty optional if the kernel has not handed over any more frames
+    std::optional<Buffer> read_frame();
+
+    //! Number of frames that read_frame() can return without waiting for the kernel (at least)
+    size_t buffered_frames() const;
+
+    //! \brief Copy a frame into the UMEM and queue it for sending by the next flush()
+    //! \note If no UMEM frame or transmit descriptor is free, this first flushes and takes back the frames
+    //! the kernel has finished sending
+    void write_frame(const BufferViewList &frame);
+
+    //! Have the kernel send every frame written so far
+    void flush();
+};
+
+#endif  // SPONGE_LIBSPONGE_XDP_SOCKET_HH
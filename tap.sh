@@ -7,7 +7,7 @@ show_usage () {
 
 start_tap () {
     local TAPNUM="$1" TAPDEV="tap$1" LLADDR="02:B0:1D:FA:CE:"`printf "%02x" $1`
-    ip tuntap add mode tap user "${SUDO_USER}" name "${TAPDEV}"
+    ip tuntap add mode tap multi_queue user "${SUDO_USER}" name "${TAPDEV}"
     ip link set "${TAPDEV}" address "${LLADDR}"
 
     ip addr add "${TUN_IP_PREFIX}.${TAPNUM}.1/24" dev "${TAPDEV}"
@@ -24,7 +24,7 @@ stop_tap () {
     local TAPDEV="tap$1"
     iptables -t nat -D PREROUTING -s ${TUN_IP_PREFIX}.${1}.0/24 -j CONNMARK --set-mark ${1}
     iptables -t nat -D POSTROUTING -j MASQUERADE -m connmark --mark ${1}
-    ip tuntap del mode tap name "$TAPDEV"
+    ip tuntap del mode tap multi_queue name "$TAPDEV"
 }
 
 start_all () {
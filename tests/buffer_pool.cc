@@ -0,0 +1,410 @@
+#include "arp_message.hh"
+#include "buffer.hh"
+#include "buffer_pool.hh"
+#include "ethernet_frame.hh"
+#include "file_descriptor.hh"
+#include "ipv4_datagram.hh"
+#include "socket.hh"
+#include "tcp_segment.hh"
+#include "test_should_be.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+//! Records every placed block given back to it, as a packet ring would
+class RecordingOwner : public BlockOwner {
+  public:
+    vector<const char *> released{};  //!< the data() of each block released, in order
+
+    void release_block(const char *data) override { released.push_back(data); }
+};
+
+//! A pool-backed Buffer holding `str`, with headroom in front (as TCPSender builds payloads)
+Buffer pool_buffer(const string &str) {
+    Buffer ret = Buffer::allocate(str.size(), Buffer::DEFAULT_HEADROOM);
+    str.copy(ret.mutable_data(), str.size());
+    return ret;
+}
+
+int main() {
+    try {
+        // a released block is handed out again, and counted as a hit
+        {
+            const char *first_data = nullptr;
+            {
+                Buffer first = pool_buffer("hello");
+                first_data = first.str().data();
+            }
+            const auto before = BufferPool::stats();
+            Buffer second = pool_buffer("world");
+            const auto after = BufferPool::stats();
+            test_should_be(second.str().data() == first_data, true);
+            test_should_be(after.hits, before.hits + 1);
+            test_should_be(after.misses, before.misses);
+        }
+
+        // copies share storage; the block is recycled only when the last copy goes away
+        {
+            Buffer original = pool_buffer(string(1500, 'x'));
+            const char *data = original.str().data();
+            Buffer copy = original;
+            copy.remove_prefix(100);
+            copy.remove_suffix(100);
+            test_should_be(copy.size(), size_t(1300));
+            test_should_be(copy.str().data() == data + 100, true);
+
+            original = Buffer{};
+            Buffer other = pool_buffer("other");
+            test_should_be(other.str().data() != data, true);
+            test_should_be(copy.copy() == string(1300, 'x'), true);
+        }
+
+        // requests too big for a small block come from the large class, and beyond that from the heap
+        {
+            const auto before = BufferPool::stats();
+            Buffer large = Buffer::allocate(BufferPool::SMALL_BLOCK_SIZE + 1);
+            Buffer huge = Buffer::allocate(BufferPool::LARGE_BLOCK_SIZE + 1);
+            test_should_be(large.size(), BufferPool::SMALL_BLOCK_SIZE + 1);
+            test_should_be(huge.size(), BufferPool::LARGE_BLOCK_SIZE + 1);
+            test_should_be(BufferPool::stats().misses >= before.misses + 1, true);
+        }
+
+        // a read never asks for more than a large block, however high its limit
+        {
+            int fds[2];
+            test_should_be(pipe(fds), 0);
+            FileDescriptor read_end{fds[0]};
+            FileDescriptor write_end{fds[1]};
+            const string contents(BufferPool::SMALL_BLOCK_SIZE + 1000, 'r');
+
+            Buffer warm_up;
+            write_end.write(contents);
+            read_end.read(warm_up, numeric_limits<size_t>::max());
+            warm_up = Buffer{};
+
+            const auto before = BufferPool::stats();
+            Buffer buffer;
+            write_end.write(contents);
+            read_end.read(buffer, numeric_limits<size_t>::max());
+            test_should_be(buffer.copy() == contents, true);
+            test_should_be(BufferPool::stats().misses, before.misses);
+        }
+
+        // small datagrams from recv_batch are copied out, so they do not pin the large landing buffers
+        {
+            UDPSocket receiver;
+            receiver.bind(Address("127.0.0.1", 0));
+            UDPSocket sender;
+            const string payload(1000, 'u');
+            constexpr size_t BATCH_SIZE = 8;
+            constexpr size_t DATAGRAM_COUNT = 96;
+
+            const auto before = BufferPool::stats();
+            vector<UDPSocket::received_buffer> datagrams;
+            vector<UDPSocket::received_buffer> batch;
+            while (datagrams.size() < DATAGRAM_COUNT) {
+                for (size_t i = 0; i < BATCH_SIZE; i++) {
+                    sender.sendto(receiver.local_address(), payload);
+                }
+                for (size_t received = 0; received < BATCH_SIZE; received += batch.size()) {
+                    receiver.recv_batch(batch, BATCH_SIZE);
+                    move(batch.begin(), batch.end(), back_inserter(datagrams));
+                }
+            }
+            for (const auto &datagram : datagrams) {
+                test_should_be(datagram.payload.copy() == payload, true);
+                test_should_be(datagram.segment_size, size_t(0));
+            }
+            // held in their landing buffers, the payloads would take several new slabs of large blocks
+            test_should_be(BufferPool::stats().slabs <= before.slabs + 1, true);
+        }
+
+        // a block can be released on a different thread than the one that allocated it
+        {
+            vector<Buffer> buffers;
+            for (unsigned i = 0; i < 1000; i++) {
+                buffers.push_back(pool_buffer(to_string(i)));
+            }
+            thread releaser([&] { buffers.clear(); });
+            releaser.join();
+
+            thread allocator([] {
+                for (unsigned i = 0; i < 1000; i++) {
+                    Buffer b = pool_buffer(to_string(i));
+                    if (b.copy() != to_string(i)) {
+                        throw runtime_error("wrong contents");
+                    }
+                }
+            });
+            allocator.join();
+        }
+
+        // headers prepended layer by layer land in the payload's headroom, so the result stays contiguous
+        {
+            BufferList packet{pool_buffer("payload")};
+            memcpy(packet.prepend(3), "tcp", 3);
+            memcpy(packet.prepend(2), "ip", 2);
+            test_should_be(packet.buffers().size(), size_t(1));
+            test_should_be(packet.concatenate() == "iptcppayload", true);
+
+            // a second copy cannot claim headroom that has already been used
+            Buffer payload = pool_buffer("data");
+            Buffer first = payload;
+            Buffer second = payload;
+            test_should_be(first.expand_front(4) != nullptr, true);
+            test_should_be(second.expand_front(4) == nullptr, true);
+            test_should_be(payload.size(), size_t(4));
+
+            BufferList fallback{second};
+            memcpy(fallback.prepend(2), "hd", 2);
+            test_should_be(fallback.buffers().size(), size_t(2));
+            test_should_be(fallback.concatenate() == "hddata", true);
+        }
+
+        // a whole Ethernet/IPv4/TCP frame is serialized into the payload's headroom, with valid checksums
+        {
+            TCPSegment seg;
+            seg.header().sport = 1234;
+            seg.header().dport = 80;
+            seg.header().seqno = WrappingInt32{0xdeadbeef};
+            seg.header().syn = true;
+            seg.payload() = pool_buffer("hello");
+
+            IPv4Datagram dgram;
+            dgram.header().src = 0x0a000001;
+            dgram.header().dst = 0x0a000002;
+            dgram.header().len = IPv4Header::LENGTH + TCPHeader::LENGTH + 5;
+            dgram.payload() = seg.serialize(dgram.header().pseudo_cksum());
+
+            EthernetFrame frame;
+            frame.header().src = {1, 2, 3, 4, 5, 6};
+            frame.header().dst = ETHERNET_BROADCAST;
+            frame.header().type = EthernetHeader::TYPE_IPv4;
+            frame.payload() = dgram.serialize();
+
+            const BufferList wire = frame.serialize();
+            test_should_be(wire.buffers().size(), size_t(1));
+            test_should_be(wire.size(), EthernetHeader::LENGTH + IPv4Header::LENGTH + TCPHeader::LENGTH + 5);
+
+            EthernetFrame frame_in;
+            test_should_be(frame_in.parse(wire.concatenate()) == ParseResult::NoError, true);
+            test_should_be(frame_in.header().serialize() == frame.header().serialize(), true);
+            IPv4Datagram dgram_in;
+            test_should_be(dgram_in.parse(frame_in.payload().concatenate()) == ParseResult::NoError, true);
+            TCPSegment seg_in;
+            test_should_be(seg_in.parse(dgram_in.payload().concatenate(), dgram_in.header().pseudo_cksum()) ==
+                               ParseResult::NoError,
+                           true);
+            test_should_be(seg_in.header() == seg.header(), true);
+            test_should_be(seg_in.payload().copy() == "hello", true);
+
+            // serialize_into() writes exactly what serialize() returns, and checks the room first
+            ARPMessage arp;
+            arp.opcode = ARPMessage::OPCODE_REQUEST;
+            arp.sender_ip_address = 0x0a000001;
+            arp.target_ip_address = 0x0a000002;
+            arp.sender_ethernet_address = {1, 2, 3, 4, 5, 6};
+            string arp_out(ARPMessage::LENGTH, 0);
+            test_should_be(arp.serialize_into(arp_out.data(), arp_out.size()), ARPMessage::LENGTH);
+            test_should_be(arp_out == arp.serialize(), true);
+
+            string tcp_out(TCPHeader::LENGTH - 1, 0);
+            bool threw = false;
+            try {
+                seg_in.header().serialize_into(tcp_out.data(), tcp_out.size());
+            } catch (const runtime_error &) {
+                threw = true;
+            }
+            test_should_be(threw, true);
+        }
+
+        // a header too short to serialize is refused before it takes any of the payload's headroom
+        {
+            TCPSegment seg;
+            seg.payload() = pool_buffer("hello");
+            seg.header().doff = 4;
+            bool threw = false;
+            try {
+                seg.serialize();
+            } catch (const runtime_error &) {
+                threw = true;
+            }
+            test_should_be(threw, true);
+
+            IPv4Datagram dgram;
+            dgram.header().hlen = 4;
+            dgram.header().len = 4 * 4 + TCPHeader::LENGTH + 5;
+            seg.header().doff = 5;
+            dgram.payload() = seg.serialize(dgram.header().pseudo_cksum());
+            threw = false;
+            try {
+                dgram.serialize();
+            } catch (const runtime_error &) {
+                threw = true;
+            }
+            test_should_be(threw, true);
+
+            dgram.header().hlen = 5;
+            dgram.header().len = IPv4Header::LENGTH + TCPHeader::LENGTH + 5;
+            test_should_be(dgram.serialize().buffers().size(), size_t(1));
+        }
+
+        // lists keep their cached size through appends, prepends and partial removals, inline or spilled
+        {
+            BufferList list;
+            string expected;
+            for (unsigned i = 0; i < 2 * INLINE_BUFFER_COUNT; i++) {
+                list.append(BufferList{to_string(i) + "-"});
+                expected += to_string(i) + "-";
+                test_should_be(list.size(), expected.size());
+            }
+            test_should_be(list.buffers().size(), 2 * INLINE_BUFFER_COUNT);
+
+            BufferViewList views{list};
+            views.remove_prefix(3);
+            test_should_be(views.size(), expected.size() - 3);
+            test_should_be(views.as_iovecs().size(), 2 * INLINE_BUFFER_COUNT - 1);
+
+            list.remove_prefix(5);
+            expected.erase(0, 5);
+            test_should_be(list.size(), expected.size());
+            test_should_be(list.concatenate() == expected, true);
+
+            memcpy(list.prepend(2), "hd", 2);
+            test_should_be(list.size(), expected.size() + 2);
+            test_should_be(list.concatenate() == "hd" + expected, true);
+
+            list.remove_prefix(list.size());
+            test_should_be(list.buffers().empty(), true);
+        }
+
+        // a Buffer constructed from a string takes the string's bytes over instead of copying them
+        {
+            string str(3000, 'y');
+            const char *const str_data = str.data();
+            const auto before = BufferPool::stats();
+            Buffer adopted{move(str)};
+            test_should_be(adopted.str().data() == str_data, true);
+            test_should_be(adopted.size(), size_t(3000));
+            test_should_be(BufferPool::stats().hits + BufferPool::stats().misses, before.hits + before.misses);
+
+            Buffer slice = adopted;
+            adopted = Buffer{};
+            slice.remove_prefix(1000);
+            test_should_be(slice.copy() == string(2000, 'y'), true);
+
+            // it has no headroom, so a header goes in a Buffer of its own
+            BufferList packet{slice};
+            memcpy(packet.prepend(2), "hd", 2);
+            test_should_be(packet.buffers().size(), size_t(2));
+            test_should_be(packet.concatenate() == "hd" + string(2000, 'y'), true);
+
+            Buffer short_string{string("sso")};
+            test_should_be(short_string.copy() == "sso", true);
+        }
+
+        // a block placed over the caller's memory is shared without copying, and given back to its owner
+        // exactly once, when the last Buffer (or BufferList) referring to it goes away
+        {
+            alignas(16) char memory[2 * BufferPool::PLACEMENT_OVERHEAD + 512];
+            char *const first_data = memory + BufferPool::PLACEMENT_OVERHEAD;
+            char *const second_data = first_data + 256 + BufferPool::PLACEMENT_OVERHEAD;
+            memset(memory, 0, sizeof(memory));
+            memcpy(first_data, "placed packet", 13);
+            memcpy(second_data, "second packet", 13);
+
+            RecordingOwner owner;
+            const auto before = BufferPool::stats();
+            BlockRef first_block{BufferPool::place(first_data, 256, &owner)};
+            test_should_be(first_block->data() == first_data, true);
+            test_should_be(first_block->capacity(), size_t(256));
+            test_should_be(first_block->unique(), true);
+            Buffer first = Buffer::adopt(move(first_block), 13);
+            test_should_be(bool(first_block), false);
+            test_should_be(first.str().data() == first_data, true);
+            test_should_be(first.copy() == "placed packet", true);
+
+            Buffer second = Buffer::adopt(BlockRef{BufferPool::place(second_data, 256, &owner)}, 13);
+            test_should_be(second.copy() == "second packet", true);
+            const auto after = BufferPool::stats();
+            test_should_be(after.hits + after.misses, before.hits + before.misses);
+
+            // copies and lists share the caller's bytes
+            Buffer copy = first;
+            copy.remove_prefix(7);
+            test_should_be(copy.str().data() == first_data + 7, true);
+            BufferList list{first};
+            list.append(second);
+            test_should_be(list.buffers().front().str().data() == first_data, true);
+            test_should_be(list.concatenate() == "placed packetsecond packet", true);
+
+            // headers cannot go in front: the bytes there belong to the placement
+            test_should_be(first.expand_front(1) == nullptr, true);
+
+            first = Buffer{};
+            list = BufferList{};
+            test_should_be(owner.released.empty(), true);
+            second = Buffer{};
+            test_should_be(owner.released.size(), size_t(1));
+            test_should_be(owner.released.at(0) == second_data, true);
+
+            // emptying the last copy drops it too
+            copy.remove_prefix(copy.size());
+            test_should_be(owner.released.size(), size_t(2));
+            test_should_be(owner.released.at(1) == first_data, true);
+
+            // the last reference may be dropped on another thread
+            Buffer moved = Buffer::adopt(BlockRef{BufferPool::place(first_data, 256, &owner)}, 6);
+            thread releaser([buffer = move(moved)]() mutable { buffer = Buffer{}; });
+            releaser.join();
+            test_should_be(owner.released.size(), size_t(3));
+            test_should_be(owner.released.at(2) == first_data, true);
+
+            // adopting no bytes keeps no reference, so the block goes straight back
+            Buffer empty = Buffer::adopt(BlockRef{BufferPool::place(second_data, 256, &owner)}, 0);
+            test_should_be(empty.size(), size_t(0));
+            test_should_be(owner.released.size(), size_t(4));
+            test_should_be(owner.released.at(3) == second_data, true);
+        }
+
+        // Buffer::adopt wraps a pool block too, taking over its reference
+        {
+            BlockRef block{BufferPool::allocate(100)};
+            memcpy(block->data(), "abcdef", 6);
+            const char *const data = block->data();
+            Buffer adopted = Buffer::adopt(move(block), 6);
+            test_should_be(adopted.copy() == "abcdef", true);
+            test_should_be(adopted.str().data() == data, true);
+
+            Buffer shared = adopted;
+            adopted = Buffer{};
+            test_should_be(shared.copy() == "abcdef", true);
+        }
+
+        // an emptied Buffer drops its storage
+        {
+            Buffer b{string("abc")};
+            b.remove_prefix(1);
+            b.remove_suffix(2);
+            test_should_be(b.size(), size_t(0));
+            test_should_be(b.str().data() == nullptr, true);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return EXIT_SUCCESS;
+}
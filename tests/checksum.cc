@@ -0,0 +1,237 @@
+#include "byte_stream.hh"
+#include "ipv4_datagram.hh"
+#include "parser.hh"
+#include "tcp_segment.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+using namespace std;
+
+//! The Internet checksum one byte at a time, straight from the definition
+uint16_t reference_checksum(const string_view data, const uint32_t initial_sum = 0) {
+    uint64_t sum = initial_sum;
+    for (size_t i = 0; i < data.size(); i++) {
+        sum += i % 2 ? uint8_t(data[i]) : uint8_t(data[i]) << 8;
+    }
+    while (sum > 0xffff) {
+        sum = (sum >> 16) + (sum & 0xffff);
+    }
+    return ~sum;
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+
+        string bytes(200000, 0);
+        for (auto &ch : bytes) {
+            ch = rd();
+        }
+
+        // every length and alignment around the vector widths, in one piece
+        for (size_t offset = 0; offset < 8; offset++) {
+            for (size_t len = 0; len < 300; len++) {
+                const string_view data{bytes.data() + offset, len};
+                InternetChecksum check;
+                check.add(data);
+                test_should_be(check.value(), reference_checksum(data));
+            }
+        }
+
+        // random pieces (many of odd length, so later pieces start at odd offsets), with a pseudo-header sum
+        for (unsigned trial = 0; trial < 2000; trial++) {
+            const size_t offset = rd() % 64;
+            const size_t len = rd() % (trial % 10 ? 3000 : bytes.size() - offset);
+            const uint32_t initial_sum = rd() % 0x40000;
+            const string_view data{bytes.data() + offset, len};
+
+            InternetChecksum check{initial_sum};
+            for (size_t done = 0; done < len;) {
+                const size_t piece = min<size_t>(len - done, rd() % 200);
+                check.add(data.substr(done, piece));
+                done += piece;
+            }
+            test_should_be(check.value(), reference_checksum(data, initial_sum));
+        }
+
+        // a correct checksum verifies to zero
+        {
+            string header = bytes.substr(0, 20);
+            header[10] = header[11] = 0;
+            InternetChecksum compute;
+            compute.add(header);
+            const uint16_t sum = compute.value();
+            header[10] = sum >> 8;
+            header[11] = sum & 0xff;
+            InternetChecksum verify;
+            verify.add(string_view(header).substr(0, 7));
+            verify.add(string_view(header).substr(7));
+            test_should_be(verify.value(), uint16_t(0));
+        }
+
+        // incremental updates agree with recomputing from scratch
+        for (unsigned trial = 0; trial < 1000; trial++) {
+            string data = bytes.substr(rd() % 1000, 2 * (1 + rd() % 100));
+            InternetChecksum before;
+            before.add(data);
+
+            const size_t word = 2 * (rd() % (data.size() / 2));
+            const uint16_t old_word = (uint8_t(data[word]) << 8) | uint8_t(data[word + 1]);
+            const uint16_t new_word = rd();
+            data[word] = new_word >> 8;
+            data[word + 1] = new_word & 0xff;
+            InternetChecksum after;
+            after.add(data);
+
+            test_should_be(InternetChecksum::adjust(before.value(), old_word, new_word), after.value());
+        }
+
+        // a forwarded datagram gets a valid header checksum without re-summing the header
+        {
+            IPv4Datagram original;
+            original.header().ttl = 64;
+            original.header().src = 0x0a000001;
+            original.header().dst = 0xc0a80102;
+            original.payload() = string("payload");
+            original.header().len = original.header().hlen * 4 + original.payload().size();
+
+            IPv4Datagram forwarded;
+            test_should_be(forwarded.parse(original.serialize().concatenate()) == ParseResult::NoError, true);
+            for (unsigned hop = 0; hop < 63; hop++) {
+                forwarded.decrement_ttl();
+                const Buffer wire{forwarded.serialize().concatenate()};
+                IPv4Header reparsed;
+                NetParser p{wire};
+                test_should_be(reparsed.parse(p) == ParseResult::NoError, true);
+                test_should_be(reparsed.ttl, uint8_t(63 - hop));
+                test_should_be(forwarded.parse(wire) == ParseResult::NoError, true);
+            }
+
+            // the same, forwarding through a view that never decodes the whole header
+            IPv4DatagramView view;
+            test_should_be(view.parse(original.serialize().concatenate()) == ParseResult::NoError, true);
+            test_should_be(view.dst(), original.header().dst);
+            for (unsigned hop = 0; hop < 63; hop++) {
+                view.decrement_ttl();
+                const Buffer wire{view.serialize().concatenate()};
+                IPv4Header reparsed;
+                NetParser p{wire};
+                test_should_be(reparsed.parse(p) == ParseResult::NoError, true);
+                test_should_be(reparsed.ttl, uint8_t(63 - hop));
+                test_should_be(view.ttl(), uint8_t(63 - hop));
+                test_should_be(wire.str().substr(IPv4Header::LENGTH) == "payload", true);
+            }
+
+            // and a view refuses a datagram whose header checksum is bad
+            string corrupted = original.serialize().concatenate();
+            corrupted[IPv4Header::CKSUM_OFFSET] ^= 1;
+            test_should_be(view.parse(move(corrupted)) == ParseResult::BadChecksum, true);
+        }
+
+        // rewriting a parsed segment's ports and pseudo-header keeps its checksum valid
+        {
+            TCPSegment original;
+            original.header().sport = 1234;
+            original.header().dport = 80;
+            original.header().seqno = WrappingInt32{uint32_t(rd())};
+            original.payload() = Buffer{bytes.substr(0, 999)};
+            const uint32_t old_pseudo = rd() % 0x40000, new_pseudo = rd() % 0x40000;
+
+            TCPSegment relayed;
+            test_should_be(relayed.parse(original.serialize(old_pseudo).concatenate(), old_pseudo) ==
+                               ParseResult::NoError,
+                           true);
+            relayed.set_ports(40000, 8080);
+
+            TCPSegment reparsed;
+            test_should_be(reparsed.parse(relayed.serialize(new_pseudo).concatenate(), new_pseudo) ==
+                               ParseResult::NoError,
+                           true);
+            test_should_be(reparsed.header().sport, uint16_t(40000));
+            test_should_be(reparsed.header().dport, uint16_t(8080));
+        }
+
+        // copying while summing gives the same checksum, and an exact copy
+        for (unsigned trial = 0; trial < 2000; trial++) {
+            const size_t offset = rd() % 64;
+            const size_t len = rd() % 3000;
+            const string_view data{bytes.data() + offset, len};
+            string copy(len + 64, 0);
+            const size_t dest_offset = rd() % 64;
+
+            InternetChecksum check{uint32_t(rd() % 0x40000)};
+            InternetChecksum fused{check};
+            check.add(data.substr(0, len / 3));
+            fused.add(data.substr(0, len / 3));
+            check.add(data.substr(len / 3));
+            fused.copy_and_add(copy.data() + dest_offset, data.substr(len / 3));
+            test_should_be(fused.value(), check.value());
+            test_should_be(string_view(copy).substr(dest_offset, len - len / 3) == data.substr(len / 3), true);
+        }
+
+        // deferred verification happens while the payload is copied out
+        {
+            TCPSegment original;
+            original.header().sport = 1234;
+            original.header().dport = 80;
+            original.payload() = Buffer{bytes.substr(0, 1459)};
+            const uint32_t pseudo = rd() % 0x40000;
+            string wire = original.serialize(pseudo).concatenate();
+
+            TCPSegment deferred;
+            test_should_be(deferred.parse(string(wire), pseudo, true) == ParseResult::NoError, true);
+            test_should_be(deferred.checksum_pending(), true);
+            string payload(deferred.payload().size(), 0);
+            test_should_be(deferred.copy_payload(payload.data()), true);
+            test_should_be(payload == bytes.substr(0, 1459), true);
+
+            wire[wire.size() / 2] ^= 1;
+            test_should_be(deferred.parse(string(wire), pseudo, true) == ParseResult::NoError, true);
+            test_should_be(deferred.copy_payload(payload.data()), false);
+
+            TCPSegment verified;
+            test_should_be(verified.parse(string(wire), pseudo) == ParseResult::BadChecksum, true);
+        }
+
+        // ... or straight into a ByteStream's free space that wraps around, skipping bytes it already has
+        for (unsigned trial = 0; trial < 200; trial++) {
+            const size_t len = 1 + rd() % 1459;
+            TCPSegment original;
+            original.payload() = Buffer{bytes.substr(0, len)};
+            const uint32_t pseudo = rd() % 0x40000;
+            string wire = original.serialize(pseudo).concatenate();
+
+            // one byte left unread, so the free space starts anywhere and wraps around
+            ByteStream stream{2000};
+            stream.write(string(1 + rd() % 2000, 'x'));
+            stream.pop_output(stream.buffer_size() - 1);
+            const size_t offset = rd() % (len + 1);
+
+            TCPSegment deferred;
+            test_should_be(deferred.parse(string(wire), pseudo, true) == ParseResult::NoError, true);
+            const auto space = stream.free_space();
+            test_should_be(space[0].iov_len + space[1].iov_len, size_t(1999));
+            test_should_be(deferred.copy_payload(space.data(), space.size(), offset), true);
+            stream.commit_write(len - offset);
+            test_should_be(stream.read(stream.buffer_size()) == "x" + bytes.substr(offset, len - offset), true);
+
+            wire[TCPHeader::LENGTH + rd() % len] ^= 1 << (rd() % 8);
+            test_should_be(deferred.parse(string(wire), pseudo, true) == ParseResult::NoError, true);
+            test_should_be(deferred.copy_payload(space.data(), space.size(), offset), false);
+            test_should_be(deferred.verify_payload(), false);
+        }
+    } catch (const exception &e) {
+        cerr << "Checksum test failed (implementation: " << InternetChecksum::implementation() << "): " << e.what()
+             << endl;
+        return 1;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+#include "io_uring.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+
+#include <cerrno>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+//! The two ends of a new pipe
+pair<FileDescriptor, FileDescriptor> make_pipe() {
+    int fds[2];
+    SystemCall("pipe", ::pipe(fds));
+    return {FileDescriptor(fds[0]), FileDescriptor(fds[1])};
+}
+
+int main() {
+    try {
+        bool have_io_uring = true;
+        try {
+            IoUring probe{1};
+        } catch (const unix_error &e) {
+            // e.g. ENOSYS on an old kernel, or EPERM under a seccomp filter
+            cerr << "io_uring unavailable (" << e.what() << "), testing only the fallback" << endl;
+            have_io_uring = false;
+        }
+
+        // queued writes happen in order, with one result each; a failed write cancels the ones linked after it
+        if (have_io_uring) {
+            auto [reader, writer] = make_pipe();
+            IoUring ring{4};
+            test_should_be(ring.capacity(), 4u);
+
+            const string pieces[] = {"abc", "defg", "hi"};
+            const iovec first[] = {{const_cast<char *>(pieces[0].data()), pieces[0].size()},
+                                   {const_cast<char *>(pieces[1].data()), pieces[1].size()}};
+            const iovec second{const_cast<char *>(pieces[2].data()), pieces[2].size()};
+            test_should_be(ring.queue_writev(writer.fd_num(), first, 2), true);
+            test_should_be(ring.queue_writev(writer.fd_num(), &second, 1), true);
+            test_should_be(ring.queued(), 2u);
+            const vector<int> results = ring.submit_and_wait();
+            test_should_be(ring.queued(), 0u);
+            test_should_be(results.size(), size_t(2));
+            test_should_be(results[0], 7);
+            test_should_be(results[1], 2);
+            test_should_be(reader.read(100) == "abcdefghi", true);
+
+            for (unsigned i = 0; i < 4; i++) {
+                test_should_be(ring.queue_writev(i == 1 ? reader.fd_num() : writer.fd_num(), &second, 1), true);
+            }
+            test_should_be(ring.queue_writev(writer.fd_num(), &second, 1), false);
+            const vector<int> failed = ring.submit_and_wait();
+            test_should_be(failed.size(), size_t(4));
+            test_should_be(failed[0], 2);
+            test_should_be(failed[1], -EBADF);
+            test_should_be(failed[2], -ECANCELED);
+            test_should_be(failed[3], -ECANCELED);
+            test_should_be(reader.read(100) == "hi", true);
+        }
+
+        // packets written to a descriptor that is not a socket arrive whole and in order, across several batches
+        {
+            auto [reader, writer] = make_pipe();
+            vector<string> storage;
+            string expected;
+            for (unsigned i = 0; i < 150; i++) {
+                storage.push_back("packet " + to_string(i) + ";");
+                expected += storage.back();
+            }
+            vector<BufferViewList> packets;
+            for (const auto &packet : storage) {
+                packets.emplace_back(packet);
+            }
+            writer.write_packets(packets);
+            writer.write_packets(packets);
+
+            string received;
+            while (received.size() < 2 * expected.size()) {
+                received += reader.read(65536);
+            }
+            test_should_be(received == expected + expected, true);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,80 @@
+#include "ip_address_map.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <string>
+
+using namespace std;
+
+//! The map holds exactly the entries of `reference`
+void check_same(IPAddressMap<uint32_t> &map, const std::map<uint32_t, uint32_t> &reference) {
+    test_should_be(map.size(), reference.size());
+    for (const auto &[key, value] : reference) {
+        const uint32_t *found = map.find(key);
+        test_should_be(found != nullptr, true);
+        test_should_be(*found, value);
+    }
+    size_t visited = 0;
+    map.for_each([&](const uint32_t key, uint32_t &value) {
+        visited++;
+        test_should_be(reference.at(key), value);
+    });
+    test_should_be(visited, reference.size());
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+
+        {
+            IPAddressMap<string> map;
+            test_should_be(map.empty(), true);
+            test_should_be(map.find(0x0a000001) == nullptr, true);
+            map[0x0a000001] = "a";
+            map[0] = "zero";
+            test_should_be(map.size(), size_t(2));
+            test_should_be(*map.find(0x0a000001) == "a", true);
+            test_should_be(*map.find(0) == "zero", true);
+            map[0x0a000001] += "b";
+            test_should_be(*map.find(0x0a000001) == "ab", true);
+            test_should_be(map.erase(0x0a000001), true);
+            test_should_be(map.erase(0x0a000001), false);
+            test_should_be(map.find(0x0a000001) == nullptr, true);
+            test_should_be(map.size(), size_t(1));
+        }
+
+        // random inserts and erases, from a small key space so that probe runs are long and keys recur
+        for (unsigned round = 0; round < 20; round++) {
+            IPAddressMap<uint32_t> map;
+            std::map<uint32_t, uint32_t> reference;
+            const uint32_t base = rd();
+            for (unsigned step = 0; step < 5000; step++) {
+                const uint32_t key = base + rd() % 512;
+                if (rd() % 3 == 0) {
+                    test_should_be(map.erase(key), reference.erase(key) == 1);
+                } else {
+                    map[key] = step;
+                    reference[key] = step;
+                }
+            }
+            check_same(map, reference);
+
+            // erase_if sees every entry, including those shifted back by its own erases
+            const uint32_t modulus = 2 + rd() % 5;
+            map.erase_if([&](const uint32_t, const uint32_t value) { return value % modulus == 0; });
+            for (auto iter = reference.begin(); iter != reference.end();) {
+                iter = iter->second % modulus == 0 ? reference.erase(iter) : next(iter);
+            }
+            check_same(map, reference);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+#include "loopback_adapter.hh"
+#include "tcp_sponge_socket.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+//! A segment from `a` to `b` (as configured below) carrying `payload`
+TCPSegment make_segment(const string &payload) {
+    TCPSegment seg;
+    seg.header().sport = 1234;
+    seg.header().dport = 5678;
+    seg.header().ack = true;
+    seg.payload() = Buffer(string(payload));
+    return seg;
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+
+        FdAdapterConfig a_config, b_config;
+        a_config.source = b_config.destination = {"10.0.0.1", "1234"};
+        a_config.destination = b_config.source = {"10.0.0.2", "5678"};
+
+        // datagrams written while corked ring the doorbell once, and those that find the ring full are dropped
+        {
+            auto [a, b] = TCPOverIPv4OverLoopbackAdapter::make_pair(4);
+            a.config_mut() = a_config;
+            b.config_mut() = b_config;
+
+            a.cork();
+            for (unsigned i = 0; i < 6; i++) {
+                TCPSegment seg = make_segment("segment " + to_string(i));
+                a.write(seg);
+            }
+            test_should_be(a.dropped(), size_t(2));
+            test_should_be(b.buffered_reads(), size_t(4));
+            test_should_be(static_cast<EventFD &>(b).clear(), false);
+
+            a.uncork();
+            for (unsigned i = 0; i < 4; i++) {
+                const auto seg = b.read();
+                test_should_be(seg.has_value(), true);
+                test_should_be(seg->payload().copy() == "segment " + to_string(i), true);
+            }
+            test_should_be(b.read().has_value(), false);
+            test_should_be(b.buffered_reads(), size_t(0));
+
+            // read() reset the doorbell once the ring was empty
+            test_should_be(static_cast<EventFD &>(b).clear(), false);
+
+            TCPSegment seg = make_segment("uncorked");
+            a.write(seg);
+            test_should_be(static_cast<EventFD &>(b).clear(), true);
+            test_should_be(b.read()->payload().copy() == "uncorked", true);
+        }
+
+        // two TCPSpongeSockets send to each other at once through a pair
+        {
+            auto [a_adapter, b_adapter] = TCPOverIPv4OverLoopbackAdapter::make_pair();
+            TCPOverIPv4OverLoopbackSpongeSocket a{move(a_adapter)}, b{move(b_adapter)};
+
+            TCPConfig config;
+            config.rt_timeout = 50;
+            thread accepter([&] { b.listen_and_accept(config, b_config); });
+            a.connect(config, a_config);
+            accepter.join();
+
+            string a_to_b(1 << 20, 0), b_to_a(1 << 20, 0);
+            for (auto &ch : a_to_b) {
+                ch = rd();
+            }
+            for (auto &ch : b_to_a) {
+                ch = rd();
+            }
+
+            string b_received;
+            thread b_side([&] {
+                thread b_writer([&] {
+                    b.write(b_to_a);
+                    b.shutdown(SHUT_WR);
+                });
+                while (not b.eof()) {
+                    b_received.append(b.read());
+                }
+                b_writer.join();
+            });
+
+            a.write(a_to_b);
+            a.shutdown(SHUT_WR);
+            string a_received;
+            while (not a.eof()) {
+                a_received.append(a.read());
+            }
+            b_side.join();
+
+            test_should_be(a_received == b_to_a, true);
+            test_should_be(b_received == a_to_b, true);
+
+            a.wait_until_closed();
+            b.wait_until_closed();
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
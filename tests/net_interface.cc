@@ -5,6 +5,11 @@
 
 #include <cstdlib>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
 
 using namespace std;
 
@@ -313,6 +318,228 @@ int main() {
                            make_arp(ARPMessage::OPCODE_REQUEST, local_eth, "10.0.0.1", {}, "10.0.0.5").serialize())});
             test.execute(ExpectNoFrame{});
         }
+
+        {
+            const EthernetAddress local_eth = random_private_ethernet_address();
+            const EthernetAddress remote_eth = random_private_ethernet_address();
+            ARPQueueLimits limits;
+            limits.max_datagrams_per_hop = 2;
+            NetworkInterfaceTestHarness test{
+                "bounded queue for one next hop", local_eth, Address("4.3.2.1", 0), limits};
+
+            const auto datagram1 = make_datagram("5.6.7.8", "13.12.11.10");
+            const auto datagram2 = make_datagram("5.6.7.9", "13.12.11.10");
+            const auto datagram3 = make_datagram("5.6.7.10", "13.12.11.10");
+            test.execute(SendDatagram{datagram1, Address("192.168.0.1", 0)});
+            test.execute(ExpectFrame{
+                make_frame(local_eth,
+                           ETHERNET_BROADCAST,
+                           EthernetHeader::TYPE_ARP,
+                           make_arp(ARPMessage::OPCODE_REQUEST, local_eth, "4.3.2.1", {}, "192.168.0.1").serialize())});
+            test.execute(SendDatagram{datagram2, Address("192.168.0.1", 0)});
+            test.execute(SendDatagram{datagram3, Address("192.168.0.1", 0)});
+            test.execute(ExpectNoFrame{});
+            test.execute(ExpectARPQueueDrops{1});
+
+            // the oldest datagram made room for the newest
+            test.execute(ReceiveFrame{
+                make_frame(
+                    remote_eth,
+                    local_eth,
+                    EthernetHeader::TYPE_ARP,
+                    make_arp(ARPMessage::OPCODE_REPLY, remote_eth, "192.168.0.1", local_eth, "4.3.2.1").serialize()),
+                {}});
+            test.execute(
+                ExpectFrame{make_frame(local_eth, remote_eth, EthernetHeader::TYPE_IPv4, datagram2.serialize())});
+            test.execute(
+                ExpectFrame{make_frame(local_eth, remote_eth, EthernetHeader::TYPE_IPv4, datagram3.serialize())});
+            test.execute(ExpectNoFrame{});
+        }
+
+        {
+            const EthernetAddress local_eth = random_private_ethernet_address();
+            const EthernetAddress remote_eth = random_private_ethernet_address();
+            ARPQueueLimits limits;
+            limits.max_datagrams = 2;
+            limits.policy = ARPQueueLimits::DropPolicy::DropNewest;
+            NetworkInterfaceTestHarness test{
+                "bounded queue for all next hops", local_eth, Address("4.3.2.1", 0), limits};
+
+            const auto datagram1 = make_datagram("5.6.7.8", "13.12.11.10");
+            const auto datagram2 = make_datagram("5.6.7.9", "13.12.11.10");
+            const auto datagram3 = make_datagram("5.6.7.10", "13.12.11.10");
+            test.execute(SendDatagram{datagram1, Address("192.168.0.1", 0)});
+            test.execute(SendDatagram{datagram2, Address("192.168.0.2", 0)});
+            test.execute(ExpectFrame{
+                make_frame(local_eth,
+                           ETHERNET_BROADCAST,
+                           EthernetHeader::TYPE_ARP,
+                           make_arp(ARPMessage::OPCODE_REQUEST, local_eth, "4.3.2.1", {}, "192.168.0.1").serialize())});
+            test.execute(ExpectFrame{
+                make_frame(local_eth,
+                           ETHERNET_BROADCAST,
+                           EthernetHeader::TYPE_ARP,
+                           make_arp(ARPMessage::OPCODE_REQUEST, local_eth, "4.3.2.1", {}, "192.168.0.2").serialize())});
+
+            // the queue is full, so the newest datagram is the one dropped
+            test.execute(SendDatagram{datagram3, Address("192.168.0.1", 0)});
+            test.execute(ExpectNoFrame{});
+            test.execute(ExpectARPQueueDrops{1});
+
+            test.execute(ReceiveFrame{
+                make_frame(
+                    remote_eth,
+                    local_eth,
+                    EthernetHeader::TYPE_ARP,
+                    make_arp(ARPMessage::OPCODE_REPLY, remote_eth, "192.168.0.1", local_eth, "4.3.2.1").serialize()),
+                {}});
+            test.execute(
+                ExpectFrame{make_frame(local_eth, remote_eth, EthernetHeader::TYPE_IPv4, datagram1.serialize())});
+            test.execute(ExpectNoFrame{});
+        }
+
+        {
+            const EthernetAddress local_eth = random_private_ethernet_address();
+            const EthernetAddress target_eth = random_private_ethernet_address();
+            NetworkInterfaceTestHarness test{"mappings in use are refreshed", local_eth, Address("4.3.2.1", 0)};
+
+            const auto datagram = make_datagram("5.6.7.8", "13.12.11.10");
+            const auto datagram2 = make_datagram("5.6.7.8", "13.12.11.11");
+            const auto datagram3 = make_datagram("5.6.7.8", "13.12.11.12");
+            const auto datagram4 = make_datagram("5.6.7.8", "13.12.11.13");
+            const auto arp_reply = make_frame(
+                target_eth,
+                local_eth,
+                EthernetHeader::TYPE_ARP,
+                make_arp(ARPMessage::OPCODE_REPLY, target_eth, "192.168.0.1", local_eth, "4.3.2.1").serialize());
+
+            test.execute(ReceiveFrame{arp_reply, {}});
+            test.execute(Tick{26000});
+            test.execute(SendDatagram{datagram, Address("192.168.0.1", 0)});
+            test.execute(
+                ExpectFrame{make_frame(local_eth, target_eth, EthernetHeader::TYPE_IPv4, datagram.serialize())});
+            test.execute(ExpectNoFrame{});
+
+            // shortly before the mapping expires, it is refreshed with a request to the known Ethernet address
+            test.execute(Tick{1500});
+            test.execute(ExpectFrame{
+                make_frame(local_eth,
+                           target_eth,
+                           EthernetHeader::TYPE_ARP,
+                           make_arp(ARPMessage::OPCODE_REQUEST, local_eth, "4.3.2.1", {}, "192.168.0.1").serialize())});
+            test.execute(ExpectNoFrame{});
+
+            // past its 30 seconds, the mapping is still used while the refresh is outstanding
+            test.execute(Tick{3000});
+            test.execute(SendDatagram{datagram2, Address("192.168.0.1", 0)});
+            test.execute(
+                ExpectFrame{make_frame(local_eth, target_eth, EthernetHeader::TYPE_IPv4, datagram2.serialize())});
+            test.execute(ExpectNoFrame{});
+
+            // the reply renews the mapping for another 30 seconds, near the end of which it is refreshed again
+            test.execute(ReceiveFrame{arp_reply, {}});
+            test.execute(ExpectNoFrame{});
+            test.execute(Tick{20000});
+            test.execute(SendDatagram{datagram3, Address("192.168.0.1", 0)});
+            test.execute(
+                ExpectFrame{make_frame(local_eth, target_eth, EthernetHeader::TYPE_IPv4, datagram3.serialize())});
+            test.execute(ExpectNoFrame{});
+            test.execute(Tick{9000});
+            test.execute(ExpectFrame{
+                make_frame(local_eth,
+                           target_eth,
+                           EthernetHeader::TYPE_ARP,
+                           make_arp(ARPMessage::OPCODE_REQUEST, local_eth, "4.3.2.1", {}, "192.168.0.1").serialize())});
+
+            // an unanswered refresh lets the mapping expire
+            test.execute(Tick{6000});
+            test.execute(SendDatagram{datagram4, Address("192.168.0.1", 0)});
+            test.execute(ExpectFrame{
+                make_frame(local_eth,
+                           ETHERNET_BROADCAST,
+                           EthernetHeader::TYPE_ARP,
+                           make_arp(ARPMessage::OPCODE_REQUEST, local_eth, "4.3.2.1", {}, "192.168.0.1").serialize())});
+            test.execute(ExpectNoFrame{});
+        }
+
+        {
+            const EthernetAddress local_eth = random_private_ethernet_address();
+            const EthernetAddress target_eth = random_private_ethernet_address();
+            NetworkInterfaceTestHarness test{"datagrams handed over by move", local_eth, Address("4.3.2.1", 0)};
+
+            // a moved datagram waits for ARP unserialized, alongside one that was serialized when sent
+            const auto datagram = make_datagram("5.6.7.8", "13.12.11.10");
+            const auto datagram2 = make_datagram("5.6.7.8", "13.12.11.11");
+            const auto datagram3 = make_datagram("5.6.7.8", "13.12.11.12");
+            test.execute(SendDatagramByMove{datagram, Address("192.168.0.1", 0)});
+            test.execute(ExpectFrame{
+                make_frame(local_eth,
+                           ETHERNET_BROADCAST,
+                           EthernetHeader::TYPE_ARP,
+                           make_arp(ARPMessage::OPCODE_REQUEST, local_eth, "4.3.2.1", {}, "192.168.0.1").serialize())});
+            test.execute(SendDatagram{datagram2, Address("192.168.0.1", 0)});
+            test.execute(ExpectNoFrame{});
+
+            test.execute(ReceiveFrame{
+                make_frame(
+                    target_eth,
+                    local_eth,
+                    EthernetHeader::TYPE_ARP,
+                    make_arp(ARPMessage::OPCODE_REPLY, target_eth, "192.168.0.1", local_eth, "4.3.2.1").serialize()),
+                {}});
+            test.execute(
+                ExpectFrame{make_frame(local_eth, target_eth, EthernetHeader::TYPE_IPv4, datagram.serialize())});
+            test.execute(
+                ExpectFrame{make_frame(local_eth, target_eth, EthernetHeader::TYPE_IPv4, datagram2.serialize())});
+            test.execute(ExpectNoFrame{});
+
+            test.execute(SendDatagramByMove{datagram3, Address("192.168.0.1", 0)});
+            test.execute(
+                ExpectFrame{make_frame(local_eth, target_eth, EthernetHeader::TYPE_IPv4, datagram3.serialize())});
+            test.execute(ExpectNoFrame{});
+        }
+
+        // frames are written out in a batch, one packet per frame on a socket and back to back on a pipe
+        for (const bool use_socket : {true, false}) {
+            const EthernetAddress local_eth = random_private_ethernet_address();
+            const EthernetAddress target_eth = random_private_ethernet_address();
+            NetworkInterface interface{local_eth, Address("4.3.2.1", 0)};
+            interface.recv_frame(make_frame(
+                target_eth,
+                local_eth,
+                EthernetHeader::TYPE_ARP,
+                make_arp(ARPMessage::OPCODE_REPLY, target_eth, "192.168.0.1", local_eth, "4.3.2.1").serialize()));
+
+            // a Unix datagram socket only queues a few datagrams, so the pipe is the one to span several batches
+            vector<string> expected;
+            for (unsigned i = 0; i < (use_socket ? 8 : 200); i++) {
+                const auto datagram = make_datagram("5.6.7.8", "13.12.11." + to_string(i));
+                interface.send_datagram(datagram, Address("192.168.0.1", 0));
+                const auto frame = make_frame(local_eth, target_eth, EthernetHeader::TYPE_IPv4, datagram.serialize());
+                expected.push_back(frame.serialize().concatenate());
+            }
+
+            int fds[2];
+            if ((use_socket ? socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) : pipe(fds)) != 0) {
+                throw runtime_error("could not create descriptor pair");
+            }
+            FileDescriptor writer{fds[1]}, reader{fds[0]};
+            if (interface.drain_to(writer) != expected.size() or not interface.frames_out().empty()) {
+                throw runtime_error("drain_to did not write every frame");
+            }
+            writer.close();
+
+            string all_expected;
+            for (const auto &frame : expected) {
+                all_expected += frame;
+                if (use_socket and reader.read() != frame) {
+                    throw runtime_error("drain_to wrote the wrong frame to a socket");
+                }
+            }
+            if (not use_socket and reader.read() != all_expected) {
+                throw runtime_error("drain_to wrote the wrong bytes to a pipe");
+            }
+        }
     } catch (const exception &e) {
         cerr << e.what() << endl;
         return EXIT_FAILURE;
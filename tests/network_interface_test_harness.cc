@@ -51,8 +51,9 @@ NetworkInterfaceAction::~NetworkInterfaceAction() {}
 
 NetworkInterfaceTestHarness::NetworkInterfaceTestHarness(const std::string &test_name,
                                                          const EthernetAddress &ethernet_address,
-                                                         const Address &ip_address)
-    : _test_name(test_name), _interface(ethernet_address, ip_address) {
+                                                         const Address &ip_address,
+                                                         const ARPQueueLimits &arp_queue_limits)
+    : _test_name(test_name), _interface(ethernet_address, ip_address, arp_queue_limits) {
     std::ostringstream ss;
     ss << "Initialized with ("
        << "ethernet_address=" << to_string(ethernet_address) << ", "
@@ -120,6 +121,12 @@ string SendDatagram::description() const {
 
 void SendDatagram::execute(NetworkInterface &interface) const { interface.send_datagram(dgram, next_hop); }
 
+string SendDatagramByMove::description() const { return SendDatagram::description() + " (handed over by move)"; }
+
+void SendDatagramByMove::execute(NetworkInterface &interface) const {
+    interface.send_datagram(InternetDatagram{dgram}, next_hop);
+}
+
 string ReceiveFrame::description() const { return "frame arrives (" + summary(frame) + ")"; }
 
 void ReceiveFrame::execute(NetworkInterface &interface) const {
@@ -167,6 +174,16 @@ void ExpectNoFrame::execute(NetworkInterface &interface) const {
     }
 }
 
+string ExpectARPQueueDrops::description() const {
+    return to_string(drops) + " datagrams dropped while waiting for ARP replies";
+}
+
+void ExpectARPQueueDrops::execute(NetworkInterface &interface) const {
+    if (interface.arp_queue_drops() != drops) {
+        throw NetworkInterfaceExpectationViolation::property("arp_queue_drops", drops, interface.arp_queue_drops());
+    }
+}
+
 string Tick::description() const { return to_string(_ms) + " ms pass"; }
 
 void Tick::execute(NetworkInterface &interface) const { interface.tick(_ms); }
@@ -45,6 +45,13 @@ struct SendDatagram : public NetworkInterfaceAction {
     SendDatagram(InternetDatagram d, Address n) : dgram(d), next_hop(n) {}
 };
 
+struct SendDatagramByMove : public SendDatagram {
+    using SendDatagram::SendDatagram;
+
+    std::string description() const override;
+    void execute(NetworkInterface &interface) const override;
+};
+
 struct ReceiveFrame : public NetworkInterfaceAction {
     EthernetFrame frame;
     std::optional<InternetDatagram> expected;
@@ -69,6 +76,15 @@ struct ExpectNoFrame : public NetworkInterfaceExpectation {
     void execute(NetworkInterface &interface) const override;
 };
 
+struct ExpectARPQueueDrops : public NetworkInterfaceExpectation {
+    uint64_t drops;
+
+    std::string description() const override;
+    void execute(NetworkInterface &interface) const override;
+
+    ExpectARPQueueDrops(const uint64_t d) : drops(d) {}
+};
+
 struct Tick : public NetworkInterfaceAction {
     size_t _ms;
 
@@ -86,7 +102,8 @@ class NetworkInterfaceTestHarness {
   public:
     NetworkInterfaceTestHarness(const std::string &test_name,
                                 const EthernetAddress &ethernet_address,
-                                const Address &ip_address);
+                                const Address &ip_address,
+                                const ARPQueueLimits &arp_queue_limits = {});
 
     void execute(const NetworkInterfaceTestStep &step);
 };
@@ -0,0 +1,171 @@
+#include "packet_ring.hh"
+#include "test_should_be.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <linux/if_packet.h>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+constexpr size_t BLOCK_SIZE = 4096;
+constexpr size_t BLOCK_COUNT = 2;
+
+//! Where the kernel would put each frame's header in a block, and the frame after it
+constexpr size_t FIRST_FRAME_OFFSET = 64;
+constexpr size_t FRAME_STRIDE = 512;
+constexpr size_t MAC_OFFSET = 128;
+
+//! A PacketRxRing over memory of its own, standing in for the kernel's mapping
+class FakeRing : public PacketRxRing {
+  public:
+    bool *const destroyed;
+
+    FakeRing(char *memory, bool *destroyed_flag)
+        : PacketRxRing(memory, BLOCK_SIZE, BLOCK_COUNT), destroyed(destroyed_flag) {}
+
+    ~FakeRing() override { *destroyed = true; }
+
+    FakeRing(const FakeRing &other) = delete;
+    FakeRing &operator=(const FakeRing &other) = delete;
+};
+
+tpacket_block_desc &block_desc(char *memory, const size_t index) {
+    return *reinterpret_cast<tpacket_block_desc *>(memory + index * BLOCK_SIZE);
+}
+
+uint32_t block_status(char *memory, const size_t index) {
+    return __atomic_load_n(&block_desc(memory, index).hdr.bh1.block_status, __ATOMIC_ACQUIRE);
+}
+
+//! Do as the kernel does: fill block `index` with `frames` and hand it to user space
+void fill_block(char *memory, const size_t index, const vector<string> &frames, const bool outgoing = false) {
+    char *const block = memory + index * BLOCK_SIZE;
+    memset(block, 0, BLOCK_SIZE);
+    for (size_t i = 0; i < frames.size(); i++) {
+        char *const slot = block + FIRST_FRAME_OFFSET + i * FRAME_STRIDE;
+        auto &header = *reinterpret_cast<tpacket3_hdr *>(slot);
+        header.tp_next_offset = FRAME_STRIDE;
+        header.tp_mac = MAC_OFFSET;
+        header.tp_snaplen = frames[i].size();
+        header.tp_len = frames[i].size();
+        auto &source = *reinterpret_cast<sockaddr_ll *>(slot + TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+        source.sll_pkttype = outgoing ? PACKET_OUTGOING : PACKET_HOST;
+        memcpy(slot + MAC_OFFSET, frames[i].data(), frames[i].size());
+    }
+    tpacket_block_desc &desc = block_desc(memory, index);
+    desc.hdr.bh1.num_pkts = frames.size();
+    desc.hdr.bh1.offset_to_first_pkt = FIRST_FRAME_OFFSET;
+    __atomic_store_n(&desc.hdr.bh1.block_status, uint32_t{TP_STATUS_USER}, __ATOMIC_RELEASE);
+}
+
+string read_contents(PacketRxRing &ring) {
+    const optional<PacketRingFD::received_frame> frame = ring.read_frame();
+    return frame.has_value() ? frame->frame.copy() : "(none)";
+}
+
+int main() {
+    try {
+        alignas(4096) static char memory[BLOCK_SIZE * BLOCK_COUNT];
+
+        // frames are read in place; a block goes back to the kernel once read and released
+        {
+            bool destroyed = false;
+            auto *ring = new FakeRing(memory, &destroyed);
+            test_should_be(ring->read_frame().has_value(), false);
+
+            fill_block(memory, 0, {"first", "second"});
+            test_should_be(ring->buffered_frames(), size_t(2));
+            optional<PacketRingFD::received_frame> first = ring->read_frame();
+            test_should_be(first.has_value(), true);
+            test_should_be(first->frame.copy() == "first", true);
+            test_should_be(first->frame.str().data() == memory + FIRST_FRAME_OFFSET + MAC_OFFSET, true);
+            test_should_be(read_contents(*ring) == "second", true);
+
+            // the reader has moved on, but a Buffer still holds the block
+            test_should_be(block_status(memory, 0), uint32_t{TP_STATUS_USER});
+            first.reset();
+            test_should_be(block_status(memory, 0), uint32_t{TP_STATUS_KERNEL});
+
+            ring->release();
+            test_should_be(destroyed, true);
+        }
+
+        // coming back round to a block that Buffers still hold does not replay its old frames
+        {
+            bool destroyed = false;
+            auto *ring = new FakeRing(memory, &destroyed);
+
+            fill_block(memory, 0, {"old"});
+            optional<PacketRingFD::received_frame> old_frame = ring->read_frame();
+            test_should_be(old_frame->frame.copy() == "old", true);
+
+            fill_block(memory, 1, {"next"});
+            test_should_be(read_contents(*ring) == "next", true);
+            test_should_be(block_status(memory, 1), uint32_t{TP_STATUS_KERNEL});
+
+            // block 0 still says TP_STATUS_USER, but it has not been handed back and refilled
+            test_should_be(block_status(memory, 0), uint32_t{TP_STATUS_USER});
+            test_should_be(ring->buffered_frames(), size_t(0));
+            test_should_be(ring->read_frame().has_value(), false);
+            test_should_be(ring->read_frame().has_value(), false);
+            test_should_be(old_frame->frame.copy() == "old", true);
+
+            // the owner goes away first: the ring lives on for the Buffer
+            ring->release();
+            test_should_be(destroyed, false);
+            Buffer copy = old_frame->frame;
+            old_frame.reset();
+            test_should_be(destroyed, false);
+            test_should_be(block_status(memory, 0), uint32_t{TP_STATUS_USER});
+            copy = Buffer{};
+            test_should_be(block_status(memory, 0), uint32_t{TP_STATUS_KERNEL});
+            test_should_be(destroyed, true);
+        }
+
+        // once handed back and refilled, the block is read again
+        {
+            bool destroyed = false;
+            auto *ring = new FakeRing(memory, &destroyed);
+
+            fill_block(memory, 0, {"one"});
+            optional<PacketRingFD::received_frame> one = ring->read_frame();
+            fill_block(memory, 1, {"two"});
+            test_should_be(read_contents(*ring) == "two", true);
+            one.reset();
+
+            fill_block(memory, 0, {"three"});
+            test_should_be(ring->buffered_frames(), size_t(1));
+            test_should_be(read_contents(*ring) == "three", true);
+            test_should_be(block_status(memory, 0), uint32_t{TP_STATUS_KERNEL});
+
+            ring->release();
+            test_should_be(destroyed, true);
+        }
+
+        // frames this host sent are skipped, and their block handed straight back
+        {
+            bool destroyed = false;
+            auto *ring = new FakeRing(memory, &destroyed);
+
+            fill_block(memory, 0, {"sent"}, true);
+            test_should_be(ring->read_frame().has_value(), false);
+            test_should_be(block_status(memory, 0), uint32_t{TP_STATUS_KERNEL});
+            fill_block(memory, 1, {"received"});
+            test_should_be(read_contents(*ring) == "received", true);
+
+            ring->release();
+            test_should_be(destroyed, true);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
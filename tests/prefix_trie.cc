@@ -0,0 +1,92 @@
+#include "prefix_trie.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <utility>
+
+using namespace std;
+
+//! Longest-prefix match by scanning every route, as the router used to
+optional<size_t> reference_lookup(const map<pair<uint32_t, uint8_t>, size_t> &routes, const uint32_t address) {
+    optional<size_t> best;
+    int best_length = -1;
+    for (const auto &[key, value] : routes) {
+        const auto [prefix, length] = key;
+        const bool matches = length == 0 or (prefix ^ address) >> (32 - length) == 0;
+        if (matches and length > best_length) {
+            best = value;
+            best_length = length;
+        }
+    }
+    return best;
+}
+
+int main() {
+    try {
+        auto rd = get_random_generator();
+
+        // prefixes are matched by their high bits only, and the longest match wins
+        {
+            PrefixTrie trie;
+            test_should_be(trie.lookup(0x0a000001).has_value(), false);
+            trie.insert(0x0a000000, 8, 1);
+            trie.insert(0x0a0100ff, 16, 2);  // bits past the length are ignored
+            trie.insert(0, 0, 3);
+            test_should_be(trie.size(), size_t(3));
+            test_should_be(trie.lookup(0x0a010203).value(), size_t(2));
+            test_should_be(trie.lookup(0x0a020203).value(), size_t(1));
+            test_should_be(trie.lookup(0x0b000000).value(), size_t(3));
+            test_should_be(trie.find(0x0a010000, 16).value(), size_t(2));
+            test_should_be(trie.find(0x0a010000, 17).has_value(), false);
+
+            trie.insert(0x0a010000, 16, 4);
+            test_should_be(trie.size(), size_t(3));
+            test_should_be(trie.lookup(0x0a010203).value(), size_t(4));
+
+            test_should_be(trie.erase(0x0a000000, 8), true);
+            test_should_be(trie.erase(0x0a000000, 8), false);
+            test_should_be(trie.lookup(0x0a020203).value(), size_t(3));
+            test_should_be(trie.erase(0, 0), true);
+            test_should_be(trie.lookup(0x0a020203).has_value(), false);
+            test_should_be(trie.lookup(0x0a010203).value(), size_t(4));
+        }
+
+        // random inserts and erases, clustered so that prefixes nest and share paths, agree with a linear scan
+        for (unsigned round = 0; round < 20; round++) {
+            PrefixTrie trie;
+            map<pair<uint32_t, uint8_t>, size_t> routes;
+            const uint32_t base = rd();
+
+            for (unsigned op = 0; op < 600; op++) {
+                const uint8_t length = rd() % 33;
+                const uint32_t prefix = (base ^ (rd() % 256) << (rd() % 25)) & (length ? ~0u << (32 - length) : 0);
+                if (rd() % 3) {
+                    trie.insert(prefix, length, op);
+                    routes[{prefix, length}] = op;
+                } else {
+                    test_should_be(trie.erase(prefix, length), routes.erase({prefix, length}) == 1);
+                }
+                test_should_be(trie.size(), routes.size());
+
+                for (unsigned probe = 0; probe < 10; probe++) {
+                    const uint32_t address = probe % 2 ? uint32_t(rd()) : base ^ (rd() % 256) << (rd() % 25);
+                    test_should_be(trie.lookup(address) == reference_lookup(routes, address), true);
+                }
+            }
+
+            for (const auto &[key, value] : routes) {
+                test_should_be(trie.find(key.first, key.second) == value, true);
+            }
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return EXIT_SUCCESS;
+}
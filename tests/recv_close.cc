@@ -45,6 +45,25 @@ int main() {
             test.execute(ExpectState{TCPReceiverStateSummary::FIN_RECV});
         }
 
+        // bytes at or beyond an assembled FIN are not part of the stream, whether they start right after
+        // the FIN or overlap the stream's last bytes
+        {
+            uint32_t isn = uniform_int_distribution<uint32_t>{0, UINT32_MAX}(rd);
+            TCPReceiverTestHarness test{4000};
+            test.execute(SegmentArrives{}.with_syn().with_seqno(isn + 0).with_result(SegmentArrives::Result::OK));
+            test.execute(
+                SegmentArrives{}.with_fin().with_seqno(isn + 1).with_data("a").with_result(SegmentArrives::Result::OK));
+            test.execute(ExpectAckno{WrappingInt32{isn + 3}});
+            test.execute(SegmentArrives{}.with_seqno(isn + 2).with_data("bc"));
+            test.execute(ExpectAckno{WrappingInt32{isn + 3}});
+            test.execute(ExpectTotalAssembledBytes{1});
+            test.execute(SegmentArrives{}.with_seqno(isn + 1).with_data("ab"));
+            test.execute(ExpectAckno{WrappingInt32{isn + 3}});
+            test.execute(ExpectTotalAssembledBytes{1});
+            test.execute(ExpectBytes{"a"});
+            test.execute(ExpectState{TCPReceiverStateSummary::FIN_RECV});
+        }
+
     } catch (const exception &e) {
         cerr << e.what() << endl;
         return 1;
@@ -0,0 +1,247 @@
+#include "arp_message.hh"
+#include "ethernet_frame.hh"
+#include "ipv4_datagram.hh"
+#include "router.hh"
+#include "test_should_be.hh"
+
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+uint32_t ip(const string &str) { return Address(str, 0).ipv4_numeric(); }
+
+EthernetFrame make_ipv4_frame(const EthernetAddress &dst,
+                              const string &dst_ip,
+                              const string &payload = "hello",
+                              const uint8_t ttl = 64) {
+    InternetDatagram dgram;
+    dgram.header().src = ip("10.0.0.2");
+    dgram.header().dst = ip(dst_ip);
+    dgram.header().ttl = ttl;
+    dgram.payload() = string(payload);
+    dgram.header().len = dgram.header().hlen * 4 + dgram.payload().size();
+
+    EthernetFrame frame;
+    frame.header().src = {0x02, 0, 0, 0, 0, 0x99};
+    frame.header().dst = dst;
+    frame.header().type = EthernetHeader::TYPE_IPv4;
+    frame.payload() = dgram.serialize().concatenate();
+    return frame;
+}
+
+EthernetFrame make_arp_frame(const uint16_t opcode,
+                             const EthernetAddress &sender_eth,
+                             const string &sender_ip,
+                             const EthernetAddress &target_eth,
+                             const string &target_ip) {
+    ARPMessage arp;
+    arp.opcode = opcode;
+    arp.sender_ethernet_address = sender_eth;
+    arp.sender_ip_address = ip(sender_ip);
+    arp.target_ethernet_address = target_eth;
+    arp.target_ip_address = ip(target_ip);
+
+    EthernetFrame frame;
+    frame.header().src = sender_eth;
+    frame.header().dst = opcode == ARPMessage::OPCODE_REQUEST ? ETHERNET_BROADCAST : target_eth;
+    frame.header().type = EthernetHeader::TYPE_ARP;
+    frame.payload() = arp.serialize();
+    return frame;
+}
+
+//! Have an interface learn a neighbor's Ethernet address, from an ARP request the neighbor sends it
+void learn_neighbor(AsyncNetworkInterface &interface,
+                    const string &interface_ip,
+                    const EthernetAddress &neighbor_eth,
+                    const string &neighbor_ip) {
+    interface.recv_frame(make_arp_frame(ARPMessage::OPCODE_REQUEST, neighbor_eth, neighbor_ip, {}, interface_ip));
+
+    // the reply
+    test_should_be(interface.frames_out().size(), size_t(1));
+    interface.frames_out().pop();
+}
+
+//! Take the next frame an interface sent, which must be a broadcast ARP request for `target_ip`
+void expect_arp_request(AsyncNetworkInterface &interface, const string &target_ip) {
+    test_should_be(interface.frames_out().empty(), false);
+    const EthernetFrame frame = interface.frames_out().front();
+    interface.frames_out().pop();
+    test_should_be(frame.header().type, EthernetHeader::TYPE_ARP);
+    test_should_be(frame.header().dst == ETHERNET_BROADCAST, true);
+    ARPMessage arp;
+    test_should_be(arp.parse(frame.payload().concatenate()) == ParseResult::NoError, true);
+    test_should_be(arp.opcode, ARPMessage::OPCODE_REQUEST);
+    test_should_be(arp.target_ip_address, ip(target_ip));
+}
+
+//! Take the next frame an interface sent, which must be an IPv4 datagram to `dst`, and return the datagram
+InternetDatagram expect_ipv4(AsyncNetworkInterface &interface, const EthernetAddress &dst) {
+    test_should_be(interface.frames_out().empty(), false);
+    const EthernetFrame frame = interface.frames_out().front();
+    interface.frames_out().pop();
+    test_should_be(frame.header().type, EthernetHeader::TYPE_IPv4);
+    test_should_be(frame.header().dst == dst, true);
+    InternetDatagram dgram;
+    test_should_be(dgram.parse(frame.payload().concatenate()) == ParseResult::NoError, true);
+    return dgram;
+}
+
+int main() {
+    try {
+        // route lookups are cached per destination, and any change to the routes empties the cache
+        {
+            const EthernetAddress eth0{0x02, 0, 0, 0, 0, 0x10};
+            const EthernetAddress eth1{0x02, 0, 0, 0, 0, 0x11};
+            const EthernetAddress eth2{0x02, 0, 0, 0, 0, 0x12};
+            const EthernetAddress gateway1{0x02, 0, 0, 0, 0, 0x21};
+            const EthernetAddress gateway2{0x02, 0, 0, 0, 0, 0x22};
+
+            Router router;
+            const size_t if0 = router.add_interface({eth0, Address("10.0.0.1", 0)});
+            const size_t if1 = router.add_interface({eth1, Address("192.168.0.1", 0)});
+            const size_t if2 = router.add_interface({eth2, Address("172.16.0.1", 0)});
+            learn_neighbor(router.interface(if1), "192.168.0.1", gateway1, "192.168.0.254");
+            learn_neighbor(router.interface(if2), "172.16.0.1", gateway2, "172.16.0.254");
+            router.add_route(ip("192.168.0.0"), 16, Address("192.168.0.254", 0), if1);
+
+            // the first datagram to a destination misses, and the rest hit
+            for (unsigned i = 0; i < 3; i++) {
+                router.interface(if0).recv_frame(make_ipv4_frame(eth0, "192.168.5.9"));
+            }
+            router.route();
+            test_should_be(router.flow_cache_misses(), uint64_t(1));
+            test_should_be(router.flow_cache_hits(), uint64_t(2));
+            for (unsigned i = 0; i < 3; i++) {
+                test_should_be(expect_ipv4(router.interface(if1), gateway1).header().ttl, uint8_t(63));
+            }
+
+            // a new, longer route takes over the destination at once
+            router.add_route(ip("192.168.5.0"), 24, Address("172.16.0.254", 0), if2);
+            router.interface(if0).recv_frame(make_ipv4_frame(eth0, "192.168.5.9"));
+            router.route();
+            test_should_be(router.flow_cache_misses(), uint64_t(2));
+            expect_ipv4(router.interface(if2), gateway2);
+            test_should_be(router.interface(if1).frames_out().empty(), true);
+
+            // ... and so does the route it replaced, once it is removed again
+            test_should_be(router.remove_route(ip("192.168.5.0"), 24), true);
+            test_should_be(router.remove_route(ip("192.168.5.0"), 24), false);
+            router.interface(if0).recv_frame(make_ipv4_frame(eth0, "192.168.5.9"));
+            router.route();
+            test_should_be(router.flow_cache_misses(), uint64_t(3));
+            expect_ipv4(router.interface(if1), gateway1);
+            test_should_be(router.interface(if2).frames_out().empty(), true);
+
+            // replacing the route for a prefix changes the next hop too
+            router.add_route(ip("192.168.0.0"), 16, Address("172.16.0.254", 0), if2);
+            router.interface(if0).recv_frame(make_ipv4_frame(eth0, "192.168.5.9"));
+            router.route();
+            expect_ipv4(router.interface(if2), gateway2);
+            test_should_be(router.interface(if1).frames_out().empty(), true);
+
+            // a destination with no route is cached as such, until a route covers it
+            const uint64_t hits = router.flow_cache_hits();
+            const uint64_t misses = router.flow_cache_misses();
+            router.interface(if0).recv_frame(make_ipv4_frame(eth0, "8.8.8.8"));
+            router.interface(if0).recv_frame(make_ipv4_frame(eth0, "8.8.8.8"));
+            router.route();
+            test_should_be(router.flow_cache_misses(), misses + 1);
+            test_should_be(router.flow_cache_hits(), hits + 1);
+            for (const size_t n : {if0, if1, if2}) {
+                test_should_be(router.interface(n).frames_out().empty(), true);
+            }
+
+            router.add_route(0, 0, Address("192.168.0.254", 0), if1);
+            router.interface(if0).recv_frame(make_ipv4_frame(eth0, "8.8.8.8"));
+            router.route();
+            test_should_be(router.flow_cache_misses(), misses + 2);
+            test_should_be(expect_ipv4(router.interface(if1), gateway1).header().dst, ip("8.8.8.8"));
+        }
+
+        // a batch is split by outbound interface, keeping each interface's datagrams in arrival order; a next hop
+        // that is not resolved yet gets one ARP request, and its datagrams wait without holding up the others
+        {
+            const EthernetAddress eth0{0x02, 0, 0, 0, 0, 0x10};
+            const EthernetAddress eth1{0x02, 0, 0, 0, 0, 0x11};
+            const EthernetAddress eth2{0x02, 0, 0, 0, 0, 0x12};
+            const EthernetAddress gateway_a{0x02, 0, 0, 0, 0, 0x21};
+            const EthernetAddress gateway_b{0x02, 0, 0, 0, 0, 0x22};
+            const EthernetAddress host_c{0x02, 0, 0, 0, 0, 0x23};
+            const EthernetAddress host_d{0x02, 0, 0, 0, 0, 0x24};
+
+            Router router;
+            const size_t if0 = router.add_interface({eth0, Address("10.0.0.1", 0)});
+            const size_t if1 = router.add_interface({eth1, Address("192.168.0.1", 0)});
+            const size_t if2 = router.add_interface({eth2, Address("172.16.0.1", 0)});
+            learn_neighbor(router.interface(if1), "192.168.0.1", gateway_a, "192.168.0.254");
+            learn_neighbor(router.interface(if1), "192.168.0.1", host_c, "192.168.0.7");
+            learn_neighbor(router.interface(if2), "172.16.0.1", host_d, "172.16.0.9");
+            router.add_route(ip("192.168.1.0"), 24, Address("192.168.0.254", 0), if1);  // via A
+            router.add_route(ip("192.168.2.0"), 24, Address("192.168.0.253", 0), if1);  // via B (unresolved)
+            router.add_route(ip("192.168.0.0"), 24, {}, if1);                           // direct (C)
+            router.add_route(ip("172.16.0.0"), 16, {}, if2);                            // direct (D)
+
+            const vector<pair<string, string>> batch{{"192.168.1.1", "a1"},
+                                                     {"192.168.1.2", "a2"},
+                                                     {"192.168.2.1", "b1"},
+                                                     {"172.16.0.9", "d1"},
+                                                     {"192.168.1.3", "a3"},
+                                                     {"192.168.0.7", "c1"},
+                                                     {"192.168.2.2", "b2"},
+                                                     {"192.168.0.7", "c2"},
+                                                     {"172.16.0.9", "d2"},
+                                                     {"192.168.1.4", "a4"}};
+            for (const auto &[dst_ip, payload] : batch) {
+                router.interface(if0).recv_frame(make_ipv4_frame(eth0, dst_ip, payload));
+            }
+            // an expired datagram in the middle is dropped without disturbing the rest
+            router.interface(if0).recv_frame(make_ipv4_frame(eth0, "192.168.1.9", "expired", 1));
+            router.interface(if0).recv_frame(make_ipv4_frame(eth0, "192.168.1.5", "a5"));
+            router.route();
+
+            AsyncNetworkInterface &out1 = router.interface(if1);
+            test_should_be(expect_ipv4(out1, gateway_a).payload().concatenate() == "a1", true);
+            test_should_be(expect_ipv4(out1, gateway_a).payload().concatenate() == "a2", true);
+            expect_arp_request(out1, "192.168.0.253");
+            test_should_be(expect_ipv4(out1, gateway_a).payload().concatenate() == "a3", true);
+            test_should_be(expect_ipv4(out1, host_c).payload().concatenate() == "c1", true);
+            test_should_be(expect_ipv4(out1, host_c).payload().concatenate() == "c2", true);
+            test_should_be(expect_ipv4(out1, gateway_a).payload().concatenate() == "a4", true);
+            test_should_be(expect_ipv4(out1, gateway_a).payload().concatenate() == "a5", true);
+            test_should_be(out1.frames_out().empty(), true);
+
+            AsyncNetworkInterface &out2 = router.interface(if2);
+            test_should_be(expect_ipv4(out2, host_d).payload().concatenate() == "d1", true);
+            test_should_be(expect_ipv4(out2, host_d).payload().concatenate() == "d2", true);
+            test_should_be(out2.frames_out().empty(), true);
+
+            // the reply releases the waiting datagrams, in order
+            out1.recv_frame(make_arp_frame(ARPMessage::OPCODE_REPLY, gateway_b, "192.168.0.253", eth1, "192.168.0.1"));
+            test_should_be(expect_ipv4(out1, gateway_b).payload().concatenate() == "b1", true);
+            test_should_be(expect_ipv4(out1, gateway_b).payload().concatenate() == "b2", true);
+            test_should_be(out1.frames_out().empty(), true);
+
+            // more datagrams than one routing batch holds keep their order across batches
+            for (unsigned i = 0; i < 100; i++) {
+                router.interface(if0).recv_frame(
+                    make_ipv4_frame(eth0, i % 3 ? "192.168.1.1" : "192.168.2.1", to_string(i)));
+            }
+            router.route();
+            for (unsigned i = 0; i < 100; i++) {
+                const InternetDatagram dgram = expect_ipv4(out1, i % 3 ? gateway_a : gateway_b);
+                test_should_be(dgram.payload().concatenate() == to_string(i), true);
+            }
+            test_should_be(out1.frames_out().empty(), true);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,242 @@
+#include "address.hh"
+#include "ipv4_datagram.hh"
+#include "tcp_segment.hh"
+#include "tcp_super_segment.hh"
+#include "test_should_be.hh"
+#include "util.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+//! A segment of the established connection, acknowledging the same data with the same window
+TCPSegment make_segment(const uint32_t seqno, const string &payload) {
+    TCPSegment seg;
+    seg.header().seqno = WrappingInt32{seqno};
+    seg.header().ack = true;
+    seg.header().ackno = WrappingInt32{7000};
+    seg.header().win = 5000;
+    seg.payload() = string(payload);
+    return seg;
+}
+
+//! Whether a super-segment of `first` (full-size) followed by `next` can be built
+bool extends(const TCPSegment &first, const TCPSegment &next) {
+    TCPSuperSegment super_segment;
+    super_segment.append(first);
+    return super_segment.can_append(next);
+}
+
+int main() {
+    try {
+        const string full(100, 'x');
+
+        // any segment can start a super-segment; the next must continue it in sequence space
+        {
+            TCPSuperSegment super_segment;
+            TCPSegment syn = make_segment(0, "");
+            syn.header().syn = true;
+            test_should_be(super_segment.can_append(syn), true);
+            test_should_be(super_segment.empty(), true);
+
+            super_segment.append(make_segment(1000, full));
+            test_should_be(super_segment.can_append(make_segment(1100, full)), true);
+            test_should_be(super_segment.can_append(make_segment(1101, full)), false);
+            test_should_be(super_segment.can_append(make_segment(1099, full)), false);
+            test_should_be(super_segment.can_append(make_segment(1000, full)), false);
+
+            super_segment.append(make_segment(1100, full));
+            super_segment.append(make_segment(1200, "tail"));
+            test_should_be(super_segment.size(), size_t(3));
+            test_should_be(super_segment.payload_size(), size_t(204));
+
+            // only the last segment may be short
+            test_should_be(super_segment.can_append(make_segment(1204, "more")), false);
+
+            super_segment.clear();
+            test_should_be(super_segment.empty(), true);
+            test_should_be(super_segment.payload_size(), size_t(0));
+            test_should_be(super_segment.can_append(syn), true);
+        }
+
+        // every segment but the last must be full-size: as long as the first, which sets gso_size
+        {
+            test_should_be(extends(make_segment(0, full), make_segment(100, string(99, 'y'))), true);
+            test_should_be(extends(make_segment(0, full), make_segment(100, string(101, 'y'))), false);
+            test_should_be(extends(make_segment(0, full), make_segment(100, "")), false);
+            test_should_be(extends(make_segment(0, ""), make_segment(0, full)), false);
+        }
+
+        // the kernel repeats the first header, so acknowledgment, window and options must match
+        {
+            TCPSegment next = make_segment(100, full);
+            next.header().ackno = WrappingInt32{7001};
+            test_should_be(extends(make_segment(0, full), next), false);
+
+            next = make_segment(100, full);
+            next.header().win = 4999;
+            test_should_be(extends(make_segment(0, full), next), false);
+
+            next = make_segment(100, full);
+            next.header().ack = false;
+            test_should_be(extends(make_segment(0, full), next), false);
+
+            next = make_segment(100, full);
+            next.header().doff = 6;
+            test_should_be(extends(make_segment(0, full), next), false);
+        }
+
+        // SYN, RST and URG are never coalesced, and nothing follows a FIN
+        {
+            for (const auto set_flag : {+[](TCPHeader &h) { h.syn = true; },
+                                        +[](TCPHeader &h) { h.rst = true; },
+                                        +[](TCPHeader &h) { h.urg = true; }}) {
+                TCPSegment first = make_segment(0, full);
+                set_flag(first.header());
+                test_should_be(extends(first, make_segment(100, full)), false);
+
+                TCPSegment next = make_segment(100, full);
+                set_flag(next.header());
+                test_should_be(extends(make_segment(0, full), next), false);
+            }
+
+            TCPSegment fin = make_segment(0, full);
+            fin.header().fin = true;
+            test_should_be(extends(fin, make_segment(100, full)), false);
+
+            TCPSegment last = make_segment(100, full);
+            last.header().fin = true;
+            test_should_be(extends(make_segment(0, full), last), true);
+        }
+
+        // the whole payload must fit in one IPv4 datagram
+        {
+            const string segment_payload(1000, 'z');
+            TCPSuperSegment super_segment;
+            uint32_t seqno = 0;
+            for (unsigned i = 0; i < 65; i++) {
+                test_should_be(super_segment.can_append(make_segment(seqno, segment_payload)), true);
+                super_segment.append(make_segment(seqno, segment_payload));
+                seqno += segment_payload.size();
+            }
+            test_should_be(super_segment.payload_size(), size_t(65000));
+            test_should_be(super_segment.can_append(make_segment(seqno, segment_payload)), false);
+
+            const TCPHeader header = make_segment(0, "").header();
+            const size_t room = TCPSuperSegment::max_payload(header) - super_segment.payload_size();
+            test_should_be(room, size_t(495));
+            test_should_be(super_segment.can_append(make_segment(seqno, string(room, 'z'))), true);
+            test_should_be(super_segment.can_append(make_segment(seqno, string(room + 1, 'z'))), false);
+        }
+
+        // TCP options take their share of the 64 KiB too
+        {
+            const string segment_payload(1000, 'o');
+            TCPSuperSegment super_segment;
+            uint32_t seqno = 0;
+            TCPSegment seg;
+            for (unsigned i = 0; i < 65; i++) {
+                seg = make_segment(seqno, segment_payload);
+                seg.header().doff = 15;
+                super_segment.append(seg);
+                seqno += segment_payload.size();
+            }
+
+            const size_t room = TCPSuperSegment::max_payload(seg.header()) - super_segment.payload_size();
+            test_should_be(room, size_t(455));
+            seg = make_segment(seqno, string(room, 'o'));
+            seg.header().doff = 15;
+            test_should_be(super_segment.can_append(seg), true);
+            seg = make_segment(seqno, string(room + 1, 'o'));
+            seg.header().doff = 15;
+            test_should_be(super_segment.can_append(seg), false);
+
+            // at the limit, the IPv4 length is exactly the largest there is
+            seg = make_segment(seqno, string(room, 'o'));
+            seg.header().doff = 15;
+            super_segment.append(seg);
+            const string packet = super_segment.serialize({"169.254.144.9", 5000}, {"10.0.0.2", 443}).concatenate();
+            test_should_be(packet.size(), sizeof(VirtioNetHeader) + 65535);
+            InternetDatagram ip_dgram;
+            const ParseResult result = ip_dgram.parse(Buffer(packet.substr(sizeof(VirtioNetHeader))));
+            test_should_be(result == ParseResult::NoError, true);
+            test_should_be(ip_dgram.header().len, uint16_t(65535));
+        }
+
+        // a single segment asks only for the checksum to be finished
+        {
+            TCPSuperSegment super_segment;
+            super_segment.append(make_segment(0, "hello"));
+            const VirtioNetHeader vnet = super_segment.vnet_header();
+            test_should_be(vnet.flags, VirtioNetHeader::F_NEEDS_CSUM);
+            test_should_be(vnet.gso_type, VirtioNetHeader::GSO_NONE);
+            test_should_be(vnet.gso_size, uint16_t(0));
+            test_should_be(vnet.hdr_len, uint16_t(IPv4Header::LENGTH + TCPHeader::LENGTH));
+            test_should_be(vnet.csum_start, uint16_t(IPv4Header::LENGTH));
+            test_should_be(vnet.csum_offset, uint16_t(TCPHeader::CKSUM_OFFSET));
+        }
+
+        // several segments go out as one datagram, with the first header (and the last one's FIN and PSH)
+        {
+            TCPSuperSegment super_segment;
+            TCPSegment first = make_segment(1000, full);
+            first.header().psh = true;
+            TCPSegment last = make_segment(1200, "end");
+            last.header().fin = true;
+            super_segment.append(first);
+            super_segment.append(make_segment(1100, full));
+            super_segment.append(last);
+
+            const Address source{"169.254.144.9", 5000};
+            const Address destination{"10.0.0.2", 443};
+            string packet = super_segment.serialize(source, destination).concatenate();
+
+            VirtioNetHeader vnet{};
+            test_should_be(packet.size() >= sizeof(vnet), true);
+            memcpy(&vnet, packet.data(), sizeof(vnet));
+            test_should_be(vnet.flags, VirtioNetHeader::F_NEEDS_CSUM);
+            test_should_be(vnet.gso_type, VirtioNetHeader::GSO_TCPV4);
+            test_should_be(vnet.gso_size, uint16_t(100));
+            test_should_be(vnet.hdr_len, uint16_t(IPv4Header::LENGTH + TCPHeader::LENGTH));
+            test_should_be(vnet.csum_start, uint16_t(IPv4Header::LENGTH));
+            test_should_be(vnet.csum_offset, uint16_t(TCPHeader::CKSUM_OFFSET));
+
+            InternetDatagram ip_dgram;
+            test_should_be(ip_dgram.parse(Buffer(packet.substr(sizeof(vnet)))) == ParseResult::NoError, true);
+            test_should_be(ip_dgram.header().src, source.ipv4_numeric());
+            test_should_be(ip_dgram.header().dst, destination.ipv4_numeric());
+            test_should_be(ip_dgram.header().proto, IPv4Header::PROTO_TCP);
+            test_should_be(size_t(ip_dgram.header().len), IPv4Header::LENGTH + TCPHeader::LENGTH + 203);
+
+            // finish the checksum as the kernel would: sum from csum_start, store at csum_offset
+            string tcp = ip_dgram.payload().concatenate();
+            InternetChecksum check;
+            check.add(tcp);
+            const uint16_t cksum = check.value();
+            tcp[vnet.csum_offset] = char(cksum >> 8);
+            tcp[vnet.csum_offset + 1] = char(cksum & 0xff);
+
+            TCPSegment seg;
+            const ParseResult result = seg.parse(Buffer(move(tcp)), ip_dgram.header().pseudo_cksum());
+            test_should_be(result == ParseResult::NoError, true);
+            test_should_be(seg.header().sport, uint16_t(5000));
+            test_should_be(seg.header().dport, uint16_t(443));
+            test_should_be(seg.header().seqno, WrappingInt32{1000});
+            test_should_be(seg.header().ackno, WrappingInt32{7000});
+            test_should_be(seg.header().win, uint16_t(5000));
+            test_should_be(seg.header().fin, true);
+            test_should_be(seg.header().psh, false);
+            test_should_be(seg.payload().str() == full + full + "end", true);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,193 @@
+#include "arp_message.hh"
+#include "ethernet_frame.hh"
+#include "ipv4_datagram.hh"
+#include "spsc_ring.hh"
+#include "test_should_be.hh"
+#include "threaded_router.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+EthernetFrame make_frame(const EthernetAddress &src,
+                         const EthernetAddress &dst,
+                         const uint16_t type,
+                         const BufferList payload) {
+    EthernetFrame frame;
+    frame.header().src = src;
+    frame.header().dst = dst;
+    frame.header().type = type;
+    frame.payload() = payload.concatenate();
+    return frame;
+}
+
+EthernetFrame make_ipv4_frame(const EthernetAddress &src, const EthernetAddress &dst, const string &dst_ip) {
+    InternetDatagram dgram;
+    dgram.header().src = Address("10.0.0.2", 0).ipv4_numeric();
+    dgram.header().dst = Address(dst_ip, 0).ipv4_numeric();
+    dgram.header().ttl = 64;
+    dgram.payload() = string("hello");
+    dgram.header().len = dgram.header().hlen * 4 + dgram.payload().size();
+    return make_frame(src, dst, EthernetHeader::TYPE_IPv4, dgram.serialize());
+}
+
+//! The next frame the router sends on an interface, waiting for its worker if need be
+EthernetFrame wait_for_frame(ThreadedRouter &router, const size_t interface_num) {
+    const auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+    while (chrono::steady_clock::now() < deadline) {
+        auto frame = router.take_frame(interface_num);
+        if (frame.has_value()) {
+            return move(frame.value());
+        }
+        this_thread::yield();
+    }
+    throw runtime_error("timed out waiting for a frame on interface " + to_string(interface_num));
+}
+
+ARPMessage expect_arp_request(ThreadedRouter &router, const size_t interface_num, const string &target_ip) {
+    const EthernetFrame frame = wait_for_frame(router, interface_num);
+    test_should_be(frame.header().type, EthernetHeader::TYPE_ARP);
+    ARPMessage arp;
+    test_should_be(arp.parse(Buffer(frame.payload().concatenate())) == ParseResult::NoError, true);
+    test_should_be(arp.opcode, ARPMessage::OPCODE_REQUEST);
+    test_should_be(arp.target_ip_address, Address(target_ip, 0).ipv4_numeric());
+    return arp;
+}
+
+int main() {
+    try {
+        // items cross between threads intact and in order
+        {
+            bool threw = false;
+            try {
+                SpscRing<int> ring(3);
+            } catch (const invalid_argument &) {
+                threw = true;
+            }
+            test_should_be(threw, true);
+
+            constexpr int count = 200000;
+            SpscRing<int> ring(64);
+            test_should_be(ring.capacity(), size_t(64));
+            thread producer([&] {
+                for (int i = 0; i < count; i++) {
+                    int item = i;
+                    while (not ring.push(move(item))) {
+                        this_thread::yield();
+                    }
+                }
+            });
+            for (int expected = 0; expected < count; expected++) {
+                int item = -1;
+                while (not ring.pop(item)) {
+                    this_thread::yield();
+                }
+                test_should_be(item, expected);
+            }
+            producer.join();
+            int item = -1;
+            test_should_be(ring.pop(item), false);
+        }
+
+        // datagrams are forwarded across workers, and route updates reach running workers
+        {
+            const EthernetAddress eth0{0x02, 0, 0, 0, 0, 0x10};
+            const EthernetAddress eth1{0x02, 0, 0, 0, 0, 0x11};
+            const EthernetAddress host_eth{0x02, 0, 0, 0, 0, 0x20};
+            const EthernetAddress peer_eth{0x02, 0, 0, 0, 0, 0x21};
+
+            ThreadedRouter router;
+            const size_t if0 = router.add_interface({eth0, Address("10.0.0.1", 0)});
+            const size_t if1 = router.add_interface({eth1, Address("192.168.0.1", 0)});
+            router.add_route(Address("10.0.0.0", 0).ipv4_numeric(), 8, {}, if0);
+            router.add_route(Address("192.168.0.0", 0).ipv4_numeric(), 16, {}, if1);
+            router.start();
+
+            bool threw = false;
+            try {
+                router.add_interface({eth0, Address("172.16.0.1", 0)});
+            } catch (const runtime_error &) {
+                threw = true;
+            }
+            test_should_be(threw, true);
+
+            test_should_be(router.deliver_frame(if0, make_ipv4_frame(host_eth, eth0, "192.168.0.2")), true);
+            const ARPMessage request = expect_arp_request(router, if1, "192.168.0.2");
+            test_should_be(request.sender_ethernet_address == eth1, true);
+
+            ARPMessage reply;
+            reply.opcode = ARPMessage::OPCODE_REPLY;
+            reply.sender_ethernet_address = peer_eth;
+            reply.sender_ip_address = Address("192.168.0.2", 0).ipv4_numeric();
+            reply.target_ethernet_address = eth1;
+            reply.target_ip_address = Address("192.168.0.1", 0).ipv4_numeric();
+            router.deliver_frame(if1, make_frame(peer_eth, eth1, EthernetHeader::TYPE_ARP, reply.serialize()));
+
+            const EthernetFrame forwarded = wait_for_frame(router, if1);
+            test_should_be(forwarded.header().type, EthernetHeader::TYPE_IPv4);
+            test_should_be(forwarded.header().dst == peer_eth, true);
+            IPv4DatagramView view;
+            test_should_be(view.parse(Buffer(forwarded.payload().concatenate())) == ParseResult::NoError, true);
+            test_should_be(view.ttl(), uint8_t(63));
+            test_should_be(view.dst(), Address("192.168.0.2", 0).ipv4_numeric());
+
+            // a more specific route, added while running, overrides the cached lookup for this destination
+            router.add_route(Address("192.168.0.2", 0).ipv4_numeric(), 32, Address("10.0.0.9", 0), if0);
+            router.deliver_frame(if0, make_ipv4_frame(host_eth, eth0, "192.168.0.2"));
+            expect_arp_request(router, if0, "10.0.0.9");
+
+            test_should_be(router.remove_route(Address("192.168.0.2", 0).ipv4_numeric(), 32), true);
+            test_should_be(router.remove_route(Address("192.168.0.2", 0).ipv4_numeric(), 32), false);
+
+            router.stop();
+            test_should_be(router.dropped(if0), uint64_t(0));
+        }
+
+        // idle workers sleep, and wake up as soon as they are given work: without the doorbell, a datagram would
+        // wait out the idle timeout of the worker that receives it and then that of the worker that sends it on
+        {
+            const EthernetAddress eth0{0x02, 0, 0, 0, 0, 0x10};
+            const EthernetAddress eth1{0x02, 0, 0, 0, 0, 0x11};
+            const EthernetAddress host_eth{0x02, 0, 0, 0, 0, 0x20};
+
+            ThreadedRouter router;
+            const size_t if0 = router.add_interface({eth0, Address("10.0.0.1", 0)});
+            const size_t if1 = router.add_interface({eth1, Address("192.168.0.1", 0)});
+            router.add_route(Address("192.168.0.0", 0).ipv4_numeric(), 16, {}, if1);
+            router.start();
+
+            // each datagram goes to a new neighbor so that it makes if1 send an ARP request
+            constexpr size_t crossings = 11;
+            vector<chrono::steady_clock::duration> latencies;
+            for (unsigned i = 0; i < crossings; i++) {
+                // time for both workers to go back to sleep
+                this_thread::sleep_for(chrono::milliseconds(20));
+                const string dst_ip = "192.168.1." + to_string(i + 1);
+                const auto sent = chrono::steady_clock::now();
+                test_should_be(router.deliver_frame(if0, make_ipv4_frame(host_eth, eth0, dst_ip)), true);
+                expect_arp_request(router, if1, dst_ip);
+                latencies.push_back(chrono::steady_clock::now() - sent);
+            }
+
+            // the typical crossing takes well under one timeout (a busy machine may delay a few of them)
+            sort(latencies.begin(), latencies.end());
+            const auto median = latencies[crossings / 2];
+            test_should_be(median < chrono::milliseconds(ThreadedRouter::IDLE_TIMEOUT_MS / 2), true);
+
+            router.stop();
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
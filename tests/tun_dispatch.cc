@@ -0,0 +1,150 @@
+#include "address.hh"
+#include "arp_message.hh"
+#include "ethernet_frame.hh"
+#include "ipv4_datagram.hh"
+#include "test_should_be.hh"
+#include "tun_dispatcher.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+uint32_t ip(const string &str) { return Address(str, 0).ipv4_numeric(); }
+
+//! An IPv4 datagram from `src` to `dst` whose payload starts with the TCP ports
+string make_datagram(const string &src,
+                     const uint16_t sport,
+                     const string &dst,
+                     const uint16_t dport,
+                     const uint8_t proto = IPv4Header::PROTO_TCP,
+                     const uint16_t offset = 0) {
+    string tcp(20, '\0');
+    tcp[0] = char(sport >> 8);
+    tcp[1] = char(sport & 0xff);
+    tcp[2] = char(dport >> 8);
+    tcp[3] = char(dport & 0xff);
+
+    InternetDatagram dgram;
+    dgram.header().src = ip(src);
+    dgram.header().dst = ip(dst);
+    dgram.header().proto = proto;
+    dgram.header().offset = offset;
+    dgram.payload() = move(tcp);
+    dgram.header().len = dgram.header().hlen * 4 + dgram.payload().size();
+    return dgram.serialize().concatenate();
+}
+
+//! An Ethernet frame of `type` carrying `payload`
+string make_frame(const uint16_t type, const string &payload) {
+    EthernetFrame frame;
+    frame.header().src = {0x02, 0, 0, 0, 0, 0x01};
+    frame.header().dst = {0x02, 0, 0, 0, 0, 0x02};
+    frame.header().type = type;
+    frame.payload() = string(payload);
+    return frame.serialize().concatenate();
+}
+
+bool same_flow(const optional<FlowKey> &flow, const FlowKey &expected) {
+    return flow.has_value() and flow.value() == expected;
+}
+
+int main() {
+    try {
+        const FlowKey flow{ip("169.254.144.9"), ip("10.0.0.2"), 5000, 443};
+
+        // the flow of an inbound packet is seen from this host's side: its destination is the local end
+        {
+            const string datagram = make_datagram("10.0.0.2", 443, "169.254.144.9", 5000);
+            test_should_be(same_flow(FlowDispatchTable::inbound_flow(datagram, false), flow), true);
+            test_should_be(FlowDispatchTable::for_all(datagram, false), false);
+
+            const string frame = make_frame(EthernetHeader::TYPE_IPv4, datagram);
+            test_should_be(same_flow(FlowDispatchTable::inbound_flow(frame, true), flow), true);
+            test_should_be(FlowDispatchTable::inbound_flow(datagram, true).has_value(), false);
+            test_should_be(FlowDispatchTable::for_all(frame, true), false);
+
+            // too short to hold the ports
+            test_should_be(FlowDispatchTable::inbound_flow(datagram.substr(0, 22), false).has_value(), false);
+            test_should_be(FlowDispatchTable::inbound_flow(datagram.substr(0, 10), false).has_value(), false);
+            test_should_be(FlowDispatchTable::inbound_flow(frame.substr(0, 10), true).has_value(), false);
+            test_should_be(FlowDispatchTable::inbound_flow("", false).has_value(), false);
+        }
+
+        // packets without TCP ports have no flow: other protocols, and fragments after the first
+        {
+            const string udp = make_datagram("10.0.0.2", 443, "169.254.144.9", 5000, 17);
+            test_should_be(FlowDispatchTable::inbound_flow(udp, false).has_value(), false);
+            const string later = make_datagram("10.0.0.2", 443, "169.254.144.9", 5000, IPv4Header::PROTO_TCP, 8);
+            test_should_be(FlowDispatchTable::inbound_flow(later, false).has_value(), false);
+            const string first = make_datagram("10.0.0.2", 443, "169.254.144.9", 5000, IPv4Header::PROTO_TCP, 0x2000);
+            test_should_be(same_flow(FlowDispatchTable::inbound_flow(first, false), flow), true);
+        }
+
+        // ARP frames go to every endpoint of a TAP device
+        {
+            ARPMessage arp;
+            arp.opcode = ARPMessage::OPCODE_REQUEST;
+            const string frame = make_frame(EthernetHeader::TYPE_ARP, arp.serialize());
+            test_should_be(FlowDispatchTable::for_all(frame, true), true);
+            test_should_be(FlowDispatchTable::inbound_flow(frame, true).has_value(), false);
+        }
+
+        // an exact binding beats a listener on the local address, which beats a listener on any address
+        {
+            FlowDispatchTable table;
+            test_should_be(table.lookup(flow).has_value(), false);
+
+            table.bind(7, {0, 0, 5000, 0});
+            test_should_be(table.lookup(flow).value(), size_t(7));
+            test_should_be(table.lookup({ip("169.254.10.9"), ip("10.0.0.3"), 5000, 80}).value(), size_t(7));
+            test_should_be(table.lookup({flow.local_ip, flow.remote_ip, 5001, 443}).has_value(), false);
+
+            table.bind(8, {flow.local_ip, 0, 5000, 0});
+            test_should_be(table.lookup(flow).value(), size_t(8));
+            test_should_be(table.lookup({ip("169.254.10.9"), ip("10.0.0.3"), 5000, 80}).value(), size_t(7));
+
+            table.bind(9, flow);
+            test_should_be(table.lookup(flow).value(), size_t(9));
+            test_should_be(table.lookup({flow.local_ip, flow.remote_ip, 5000, 444}).value(), size_t(8));
+
+            // a key belongs to one endpoint at a time; binding it again to the same one is harmless
+            bool threw = false;
+            try {
+                table.bind(10, flow);
+            } catch (const runtime_error &) {
+                threw = true;
+            }
+            test_should_be(threw, true);
+            table.bind(9, flow);
+            test_should_be(table.lookup(flow).value(), size_t(9));
+
+            // binding again replaces the endpoint's old key, as when a listener accepts a connection
+            table.bind(8, {flow.local_ip, ip("10.0.0.3"), 5000, 80});
+            test_should_be(table.lookup({flow.local_ip, flow.remote_ip, 5000, 444}).value(), size_t(7));
+            test_should_be(table.lookup({flow.local_ip, ip("10.0.0.3"), 5000, 80}).value(), size_t(8));
+            table.bind(10, {flow.local_ip, 0, 5000, 0});
+            test_should_be(table.lookup({flow.local_ip, flow.remote_ip, 5000, 444}).value(), size_t(10));
+
+            table.unbind(9);
+            test_should_be(table.lookup(flow).value(), size_t(10));
+            table.unbind(10);
+            table.unbind(10);
+            test_should_be(table.lookup(flow).value(), size_t(7));
+            table.unbind(7);
+            test_should_be(table.lookup(flow).has_value(), false);
+            table.bind(11, flow);
+            test_should_be(table.lookup(flow).value(), size_t(11));
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}